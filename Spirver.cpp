@@ -1,8 +1,16 @@
 #include "Spirver.h"
+#include <SpirverAsync.h>
+#include <SpirverInclude.h>
+#include <SpirverInstrument.h>
+#include <SpirverProfileGuided.h>
+#include <SpirverUnroll.h>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <istream>
 #include <glslang/SPIRV/SpvTools.h>
+#include <spirv-tools/linker.hpp>
 #include <glslang/SPIRV/GlslangToSpv.h>
 #include <glslang/Public/ShaderLang.h>
 #include <string>
@@ -28,6 +36,9 @@ GlslShader& Spirver::GlslShader::operator=(GlslShader& o)
 	this->stage = o.stage;
 	this->errors = std::stringstream(o.errors.str());
 	this->uniformProperties = o.uniformProperties;
+	this->path = o.path;
+	this->includeDirectories = o.includeDirectories;
+	this->derived = o.derived;
 	return *this;
 }
 
@@ -37,12 +48,17 @@ GlslShader& Spirver::GlslShader::operator=(GlslShader&& o)
 	this->stage = o.stage;
 	this->errors = std::move(std::stringstream(o.errors.str()));
 	this->uniformProperties = std::move(o.uniformProperties);
+	this->path = std::move(o.path);
+	this->includeDirectories = std::move(o.includeDirectories);
+	this->derived = std::move(o.derived);
 	return *this;
 }
 
 GlslShader GlslShader::FromFile(const std::string& path, Spirver::Stage stage)
 {
-	return GlslShader(fileToString(path.c_str()), stage);
+	GlslShader shader(fileToString(path.c_str()), stage);
+	shader.path = path;
+	return shader;
 }
 
 GlslShader GlslShader::FromMemory(const std::string& code, Spirver::Stage stage)
@@ -50,6 +66,34 @@ GlslShader GlslShader::FromMemory(const std::string& code, Spirver::Stage stage)
 	return GlslShader(code, stage);
 }
 
+GlslShader GlslShader::WithCode(const std::string& code)
+{
+	GlslShader shader(code, stage);
+	shader.path = path;
+	shader.includeDirectories = includeDirectories;
+	return shader;
+}
+
+std::ostream& operator<<(std::ostream& os, const BestOfReport& r)
+{
+	const char* names[] = { "none", "glsl-optimizer", "spirv-opt" };
+	os << "winner: " << names[(int)r.winner] << std::endl;
+	os << "glsl-optimizer: ";
+	if (r.glslOptimizerValid) os << r.glslOptimizerCycles << " cycles, " << r.glslOptimizerBytes << " bytes" << std::endl;
+	else os << "failed" << std::endl;
+	os << "spirv-opt: ";
+	if (r.spirvOptValid) os << r.spirvOptCycles << " cycles, " << r.spirvOptBytes << " bytes" << std::endl;
+	else os << "failed" << std::endl;
+	return os;
+}
+
+bool ShaderCode::Collect(GLuint shader)
+{
+	bool success = printLog(shader, LogType::Shader);
+	if (!success) errors << Spirver::proc::GetErrors();
+	return success;
+}
+
 std::string ShaderCode::GetErrors()
 {	
 	std::string ret = errors.str();
@@ -59,27 +103,89 @@ std::string ShaderCode::GetErrors()
 
 bool GlslShader::Optimize()
 {
-	std::string codeLegacy, codeLegacyOpt;
-	modernGlslToLegacyGlsl(code, codeLegacy); // so that glsl-opt can handle it
-	bool success = optimizeGlsl(codeLegacy.c_str(), codeLegacyOpt, stage);
-	success &= legacyGlslToModernGlsl(codeLegacyOpt, code, uniformProperties); // and back to 4.6
+	derived = Derived();
+	bool success;
+	if (stage == Stage::Vertex || stage == Stage::Fragment)
+	{
+		std::string codeLegacy, codeLegacyOpt;
+		modernGlslToLegacyGlsl(code, codeLegacy); // so that glsl-opt can handle it
+		success = optimizeGlsl(codeLegacy.c_str(), codeLegacyOpt, stage);
+		success &= legacyGlslToModernGlsl(codeLegacyOpt, code, uniformProperties); // and back to 4.6
+	}
+	else
+	{
+		// glsl-opt only knows vertex and fragment shaders, the others take the way through SPIR-V
+		FileIncluder includer(path, includeDirectories);
+		std::string optimized;
+		success = optimizeGlslViaSpirv(code, optimized, stage, uniformProperties, &includer);
+		if (success) code = std::move(optimized);
+	}
 	if (!success) errors << Spirver::proc::GetErrors();
 	return success;
 }
 
 bool GlslShader::Compile(GLuint shader)
+{
+	Submit(shader);
+	return Collect(shader);
+}
+
+void GlslShader::Submit(GLuint shader)
 {
 	const char* source = code.c_str();
 	glShaderSource(shader, 1, &source, nullptr);
 	glCompileShader(shader);
-	bool success = printLog(shader, LogType::Shader);
-	if (!success) errors << Spirver::proc::GetErrors();
-	return success;
 }
 
 ShaderStat GlslShader::Analyze()
 {
-	return AnalyzeShader(code, stage);
+	if (!derived.stat)
+	{
+		FileIncluder includer(path, includeDirectories);
+		derived.stat = AnalyzeShader(code, stage, &includer);
+		// AnalyzeShader returns no status, a failed parse only leaves its log behind
+		std::string log = Spirver::proc::GetErrors();
+		if (!log.empty()) errors << log;
+	}
+	return *derived.stat;
+}
+
+ShaderCost GlslShader::EstimateCost(const CostModel& model)
+{
+	FileIncluder includer(path, includeDirectories);
+	return EstimateShaderCost(code, stage, model, &includer);
+}
+
+ShaderHotspots GlslShader::AnalyzeHotspots()
+{
+	if (!derived.hotspots)
+	{
+		FileIncluder includer(path, includeDirectories);
+		derived.hotspots = AnalyzeShaderHotspots(code, stage, &includer);
+	}
+	return *derived.hotspots;
+}
+
+ComputeStat GlslShader::AnalyzeCompute(const HardwareProfile& hw)
+{
+	if (stage != Stage::Compute)
+	{
+		errors << "Compute analysis error: not a compute shader" << std::endl;
+		return ComputeStat();
+	}
+	FileIncluder includer(path, includeDirectories);
+	return AnalyzeComputeShader(code, hw, &includer);
+}
+
+std::set<std::string> GlslShader::GetIncludes()
+{
+	if (!derived.includes)
+	{
+		FileIncluder includer(path, includeDirectories);
+		if (!glslIncludes(code, stage, &includer)) errors << Spirver::proc::GetErrors();
+		derived.includes = includer.GetIncludes();
+	}
+	return *derived.includes;
 }
 
 bool GlslShader::ToFile(std::string&& path)
@@ -88,14 +194,72 @@ bool GlslShader::ToFile(std::string&& path)
 }
 
 SpirvShader GlslShader::ToSpirv()
+{
+	if (!derived.spirv)
+	{
+		std::vector<GLuint> spirv;
+		FileIncluder includer(path, includeDirectories);
+		if (!glslToSpirv(code, stage, spirv, &includer)) derived.spirvErrors = Spirver::proc::GetErrors();
+		derived.spirv = std::move(spirv);
+	}
+	SpirvShader spirvShader = SpirvShader::FromMemory(*derived.spirv, stage);
+	spirvShader.errors << derived.spirvErrors;
+	return spirvShader;
+}
+
+SpirvShader GlslShader::ToSpirvModule()
 {
 	std::vector<GLuint> spirv;
-	bool success = glslToSpirv(code, stage, spirv);
+	FileIncluder includer(path, includeDirectories);
+	bool success = glslToSpirvModule(code, stage, spirv, &includer);
 	SpirvShader spirvShader = SpirvShader::FromMemory(spirv, stage);
 	if (!success) spirvShader.errors << Spirver::proc::GetErrors();
 	return spirvShader;
 }
 
+SpirvShader GlslShader::ToSpirvBestOf(BestOfReport* report, const CostModel& model)
+{
+	BestOfReport r;
+
+	// glsl-optimizer works on a copy in a second thread, SPIRV-Tools on this thread
+	GlslShader copy = *this;
+	SpirvShader fromGlslOptimizer(std::vector<GLuint>(), stage);
+	std::shared_ptr<DiagnosticSink> sink = diagnosticSink;
+	Stage sinkStage = diagnosticStage;
+	std::thread glslOptimizerPath([&]()
+		{
+			DiagnosticScope scope(sink, sinkStage);
+			if (copy.Optimize()) fromGlslOptimizer = copy.ToSpirv();
+			else fromGlslOptimizer.errors << copy.GetErrors();
+		});
+	SpirvShader fromSpirvOpt = ToSpirv();
+	if (!fromSpirvOpt.HasErrors()) fromSpirvOpt.Optimize();
+	glslOptimizerPath.join();
+
+	r.glslOptimizerValid = !fromGlslOptimizer.HasErrors() && !fromGlslOptimizer.spirv.empty();
+	r.spirvOptValid = !fromSpirvOpt.HasErrors() && !fromSpirvOpt.spirv.empty();
+	if (r.glslOptimizerValid)
+	{
+		r.glslOptimizerCycles = fromGlslOptimizer.EstimateCost(model).estimatedCycles;
+		r.glslOptimizerBytes = fromGlslOptimizer.spirv.size() * sizeof(GLuint);
+	}
+	if (r.spirvOptValid)
+	{
+		r.spirvOptCycles = fromSpirvOpt.EstimateCost(model).estimatedCycles;
+		r.spirvOptBytes = fromSpirvOpt.spirv.size() * sizeof(GLuint);
+	}
+
+	if (r.glslOptimizerValid && (!r.spirvOptValid || r.glslOptimizerCycles < r.spirvOptCycles
+		|| (r.glslOptimizerCycles == r.spirvOptCycles && r.glslOptimizerBytes < r.spirvOptBytes)))
+		r.winner = OptimizerPath::GlslOptimizer;
+	else if (r.spirvOptValid) r.winner = OptimizerPath::SpirvOpt;
+	if (report != nullptr) *report = r;
+
+	if (r.winner == OptimizerPath::GlslOptimizer) return fromGlslOptimizer;
+	if (r.winner == OptimizerPath::None) fromSpirvOpt.errors << fromGlslOptimizer.GetErrors();
+	return fromSpirvOpt;
+}
+
 Spirver::GlslShader::GlslShader(const std::string& code, Stage stage) : ShaderCode(stage)
 {
 	this->code = code;
@@ -119,6 +283,7 @@ SpirvShader& Spirver::SpirvShader::operator=(SpirvShader& o)
 	this->spirv = o.spirv;
 	this->stage = o.stage;
 	this->errors = std::stringstream(o.errors.str());
+	this->derived = o.derived;
 	return *this;
 }
 
@@ -127,6 +292,7 @@ SpirvShader& Spirver::SpirvShader::operator=(SpirvShader&& o)
 	this->spirv = std::move(o.spirv);
 	this->stage = o.stage;
 	this->errors = std::move(o.errors);
+	this->derived = std::move(o.derived);
 	return *this;
 }
 
@@ -145,25 +311,65 @@ SpirvShader SpirvShader::FromMemory(const std::vector<GLuint>& spirv, Spirver::S
 
 bool SpirvShader::Optimize()
 {
+	if (derived.optimized) return true;
+
 	bool success = optimizeSpirv(spirv);
+	derived = Derived();
+	derived.optimized = success;
 	if (!success) errors << Spirver::proc::GetErrors();
 	return success;
 }
 
-bool SpirvShader::Compile(GLuint id)
+bool SpirvShader::OptimizeSize(SizeReport* report, const SizeOptions& options)
 {
-	glShaderBinary(1, &id, GL_SHADER_BINARY_FORMAT_SPIR_V, spirv.data(), spirv.size() * sizeof(GLuint)); // load binary
-	bool success = printLog(id, LogType::PrespecShader);
+	derived = Derived();
+	bool success = optimizeSpirvSize(spirv, options, report);
 	if (!success) errors << Spirver::proc::GetErrors();
-	glSpecializeShader(id, "main", 0, nullptr, nullptr); // no constants to specialize
-	success = printLog(id, LogType::Shader);
+	return success;
+}
+
+bool SpirvShader::UnrollLoops(UnrollReport* report, const UnrollPolicy& policy)
+{
+	derived = Derived();
+	bool success = unrollSpirv(spirv, policy, report);
 	if (!success) errors << Spirver::proc::GetErrors();
 	return success;
 }
 
+bool SpirvShader::Compile(GLuint id)
+{
+	return Compile(id, {}); // no constants to specialize
+}
+
+bool SpirvShader::Compile(GLuint id, const std::vector<SpecializationConstant>& constants)
+{
+	bool success = spirvBinaryToShader(spirv.data(), spirv.size(), id, constants);
+	if (!success) errors << Spirver::proc::GetErrors();
+	return success;
+}
+
+void SpirvShader::Submit(GLuint id)
+{
+	// the status after loading the binary is not checked, it would wait for the driver
+	glShaderBinary(1, &id, GL_SHADER_BINARY_FORMAT_SPIR_V, spirv.data(), spirv.size() * sizeof(GLuint));
+	glSpecializeShader(id, "main", 0, nullptr, nullptr);
+}
+
 ShaderStat SpirvShader::Analyze()
 {
-	return AnalyzeShader(spirv, stage);
+	if (!derived.stat) derived.stat = AnalyzeShader(spirv, stage);
+	return *derived.stat;
+}
+
+ShaderCost SpirvShader::EstimateCost(const CostModel& model)
+{
+	return EstimateShaderCost(GetGlsl(), stage, model);
+}
+
+ShaderHotspots SpirvShader::AnalyzeHotspots()
+{
+	if (!derived.hotspots) derived.hotspots = AnalyzeShaderHotspots(GetGlsl(), stage);
+	return *derived.hotspots;
 }
 
 bool SpirvShader::ToFile(std::string&& path)
@@ -173,9 +379,113 @@ bool SpirvShader::ToFile(std::string&& path)
 
 GlslShader SpirvShader::ToGlsl()
 {
-	std::string code;
-	spirvToGlsl(spirv, code);
-	return GlslShader::FromMemory(code, stage);
+	return GlslShader::FromMemory(GetGlsl(), stage);
+}
+
+const std::string& SpirvShader::GetGlsl()
+{
+	if (!derived.glsl)
+	{
+		std::string code;
+		spirvToGlsl(spirv, code);
+		derived.glsl = std::move(code);
+	}
+	return *derived.glsl;
+}
+
+bool SpirvShader::Link(const std::vector<const SpirvShader*>& libraries)
+{
+	std::vector<std::vector<GLuint>> modules = { spirv };
+	for (const SpirvShader* library : libraries) modules.push_back(library->spirv);
+
+	// linking leaves calls across modules, the optimizer inlines them
+	std::vector<GLuint> linked;
+	bool success = linkSpirv(modules, linked) && optimizeSpirv(linked);
+	if (success)
+	{
+		spirv = std::move(linked);
+		derived = Derived();
+		derived.optimized = true;
+	}
+	else errors << Spirver::proc::GetErrors();
+	return success;
+}
+
+std::vector<ReflectedResource> SpirvShader::Reflect()
+{
+	if (!derived.reflection)
+	{
+		std::vector<ReflectedResource> resources;
+		reflectSpirv(spirv, resources);
+		derived.reflection = std::move(resources);
+	}
+	return *derived.reflection;
+}
+
+RegisterPressure SpirvShader::AnalyzeRegisterPressure()
+{
+	if (!derived.registerPressure) derived.registerPressure = Spirver::proc::AnalyzeRegisterPressure(spirv);
+	return *derived.registerPressure;
+}
+
+uint64_t SpirvShader::CanonicalHash()
+{
+	if (!derived.canonicalHash) derived.canonicalHash = canonicalHash(spirv);
+	return *derived.canonicalHash;
+}
+
+SpirvShader SpirvShader::Instrument(InstrumentationMap& map, uint32_t binding)
+{
+	std::vector<GLuint> instrumented;
+	if (!instrumentSpirv(spirv, instrumented, map, binding))
+	{
+		errors << Spirver::proc::GetErrors();
+		return SpirvShader();
+	}
+	return SpirvShader(instrumented, stage);
+}
+
+bool SpirvShader::OptimizeWithProfile(const ExecutionProfile& profile, PgoReport* report, const PgoOptions& options)
+{
+	std::vector<GLuint> optimized = spirv;
+	if (!optimizeSpirvWithProfile(optimized, profile, options, report))
+	{
+		errors << Spirver::proc::GetErrors();
+		return false;
+	}
+
+	if (report != nullptr)
+	{
+		SpirvShader baseline(spirv, stage);
+		if (baseline.Optimize()) report->cyclesBefore = baseline.EstimateCost().estimatedCycles;
+		report->bytesBefore = baseline.spirv.size() * sizeof(GLuint);
+	}
+
+	spirv = std::move(optimized);
+	derived = Derived();
+	derived.optimized = true;
+
+	if (report != nullptr)
+	{
+		report->cyclesAfter = EstimateCost().estimatedCycles;
+		report->bytesAfter = spirv.size() * sizeof(GLuint);
+	}
+	return true;
+}
+
+ComputeStat SpirvShader::AnalyzeCompute(const HardwareProfile& hw)
+{
+	if (stage != Stage::Compute)
+	{
+		errors << "Compute analysis error: not a compute shader" << std::endl;
+		return ComputeStat();
+	}
+	return AnalyzeComputeShader(GetGlsl(), hw);
+}
+
+float SpirvShader::EstimateOccupancy(const HardwareProfile& hw)
+{
+	return AnalyzeCompute(hw).EstimateOccupancy(hw, AnalyzeRegisterPressure().peakComponents);
 }
 
 inline Spirver::SpirvShader::SpirvShader(const std::vector<GLuint>& spirv, Stage stage) : ShaderCode(stage)
@@ -196,9 +506,12 @@ void Spirver::Init()
 
 void Spirver::Clean()
 {
+	if (!CleanTaskPool()) return; // called from a task, the other tasks still need the rest
 	CleanGlslOpt();
 	CleanGlslang();
 	CleanSpirvOpt();
+	CleanSpirvSizeOpt();
+	CleanSpirvUnrollOpt();
 }
 
 #pragma endregion
@@ -300,6 +613,48 @@ Spirver::Stage Spirver::StageToSpirver(const std::string& s)
 
 #pragma endregion
 
+#pragma region Diagnostics
+
+void DiagnosticList::Report(const Diagnostic& diagnostic)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	diagnostics.push_back(diagnostic);
+}
+
+bool DiagnosticList::HasErrors() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return std::any_of(diagnostics.begin(), diagnostics.end(), [](const Diagnostic& d) { return d.severity == Severity::Error; });
+}
+
+DiagnosticScope::DiagnosticScope(std::shared_ptr<DiagnosticSink> sink, Stage stage) : previousSink(diagnosticSink), previousStage(diagnosticStage)
+{
+	diagnosticSink = std::move(sink);
+	diagnosticStage = stage;
+}
+
+DiagnosticScope::~DiagnosticScope()
+{
+	diagnosticSink = std::move(previousSink);
+	diagnosticStage = previousStage;
+}
+
+std::ostream& operator<<(std::ostream& os, const Diagnostic& d)
+{
+	const char* severities[] = { "info", "warning", "error" };
+	if (!d.file.empty() || d.line > 0)
+	{
+		os << d.file << ":" << d.line << ":";
+		if (d.column > 0) os << d.column << ":";
+	}
+	else os << d.tool << ":";
+	os << " " << severities[(int)d.severity] << ": " << d.message;
+	if (d.stage != Stage::StageCount) os << " [" << stageNames[(int)d.stage] << "]";
+	return os;
+}
+
+#pragma endregion
+
 #pragma region Logging
 
 std::string Spirver::proc::GetErrors()
@@ -355,14 +710,13 @@ bool Spirver::proc::stringToFile(const std::string& str, const std::string& path
 
 #pragma region Compilation
 
-bool Spirver::proc::glslToSpirv(const std::string& glsl, Stage stage, int& uniformBase, std::vector<GLuint>& spirv)
+bool Spirver::proc::glslToSpirv(const std::string& glsl, Stage stage, int& uniformBase, std::vector<GLuint>& spirv, glslang::TShader::Includer* includer)
 {
 	InitGlslang();
 	
 	// to AST shader
 	glslang::TShader* astshader = new glslang::TShader(StageToGlslang(stage));
-	if (uniformBase >= 0) { if (!glslToAstShader(glsl, astshader, uniformBase)) return false; }
-	else { if (!glslToAstShader(glsl, astshader)) return false; }
+	if (!glslToAstShader(glsl, astshader, uniformBase, includer)) return false;
 
 	// to AST program
 	glslang::TProgram* astprogram = new glslang::TProgram();
@@ -374,6 +728,31 @@ bool Spirver::proc::glslToSpirv(const std::string& glsl, Stage stage, int& unifo
 	return ret;
 }
 
+bool Spirver::proc::glslToSpirvModule(const std::string& glsl, Stage stage, std::vector<GLuint>& spirv, glslang::TShader::Includer* includer)
+{
+	InitGlslang();
+
+	// without a program link, calls to functions without a body are left for the SPIR-V linker
+	glslang::TShader astshader(StageToGlslang(stage));
+	astshader.setCompileOnly();
+	if (!glslToAstShader(glsl, &astshader, -1, includer)) return false;
+
+	spv::SpvBuildLogger logger;
+	glslang::SpvOptions spvOptions;
+	spvOptions.disableOptimizer = true;
+	glslang::GlslangToSpv(*astshader.getIntermediate(), spirv, &logger, &spvOptions);
+	return printLog(logger);
+}
+
+bool Spirver::proc::linkSpirv(const std::vector<std::vector<GLuint>>& modules, std::vector<GLuint>& linked, bool library)
+{
+	spvtools::Context context(SPV_ENV_OPENGL_4_5);
+	context.SetMessageConsumer(printSpirvOptLog);
+	spvtools::LinkerOptions options;
+	options.SetCreateLibrary(library); // otherwise the linkage decorations and capability are removed
+	return spvtools::Link(context, modules, &linked, options) == SPV_SUCCESS;
+}
+
 bool Spirver::proc::legacyGlslToModernGlsl(const std::string& source, std::string& output, const std::map<std::string, UniformProperties>& uniformLocations)
 {
 	std::istringstream s(source);
@@ -398,7 +777,13 @@ bool Spirver::proc::legacyGlslToModernGlsl(const std::string& source, std::strin
 
 		// if no stored properties, continue
 		std::string name = matchNameNoLayout.str(1);
-		UniformProperties uprops = (*uniformLocations.find(name)).second;
+		auto stored = uniformLocations.find(name);
+		if (stored == uniformLocations.end())
+		{
+			output += line + "\n";
+			continue;
+		}
+		UniformProperties uprops = stored->second;
 		if (uprops.isEmpty())
 		{
 			output += line + "\n";
@@ -494,6 +879,7 @@ bool Spirver::proc::optimizeGlsl(const char* source, std::string& optimized, Sta
 
 	if (stage != Stage::Vertex && stage != Stage::Fragment) return false; // glsl-opt can't handle other stages
 
+	std::lock_guard<std::mutex> lock(glslOptMutex);
 	glslopt_shader* shader = glslopt_optimize(glslOptCtx, StageToGlslopt(stage), source, kGlslOptionNotFullShader);
 	if (glslopt_get_status(shader)) // if successful
 	{
@@ -503,22 +889,34 @@ bool Spirver::proc::optimizeGlsl(const char* source, std::string& optimized, Sta
 	}
 	else
 	{
+		bool success = printLog(shader); // the log belongs to the shader
 		glslopt_shader_delete(shader);
-		return printLog(shader);
+		return success;
 	}
 }
 
+bool Spirver::proc::optimizeGlslViaSpirv(const std::string& source, std::string& optimized, Stage stage,
+	const std::map<std::string, UniformProperties>& uniformLocations, glslang::TShader::Includer* includer)
+{
+	std::vector<GLuint> spirv;
+	std::string cross;
+	if (!glslToSpirv(source, stage, spirv, includer) || !optimizeSpirv(spirv) || !spirvToGlsl(spirv, cross)) return false;
+
+	// spirv-cross writes the decorations back, layouts it left out come from the source
+	return legacyGlslToModernGlsl(cross, optimized, uniformLocations);
+}
+
 #pragma endregion
 
 #pragma region Analysis
 
-ShaderStat Spirver::proc::AnalyzeShader(const std::string& glsl, Spirver::Stage stage)
+ShaderStat Spirver::proc::AnalyzeShader(const std::string& glsl, Spirver::Stage stage, glslang::TShader::Includer* includer)
 {
 	InitGlslang();
 	
 	// to AST
 	glslang::TShader* astshader = new glslang::TShader(StageToGlslang(stage));
-	glslToAstShader(glsl, astshader);
+	glslToAstShader(glsl, astshader, -1, includer);
 
 	// analysis
 	ShaderStat ret = AnalyzeAstShader(astshader);
@@ -528,6 +926,45 @@ ShaderStat Spirver::proc::AnalyzeShader(const std::string& glsl, Spirver::Stage
 	return ret;
 }
 
+ShaderCost Spirver::proc::EstimateShaderCost(const std::string& glsl, Spirver::Stage stage, const CostModel& model, glslang::TShader::Includer* includer)
+{
+	InitGlslang();
+
+	glslang::TShader* astshader = new glslang::TShader(StageToGlslang(stage));
+	glslToAstShader(glsl, astshader, -1, includer);
+
+	ShaderCost ret = EstimateAstShaderCost(astshader, model);
+
+	delete astshader;
+	return ret;
+}
+
+ShaderHotspots Spirver::proc::AnalyzeShaderHotspots(const std::string& glsl, Spirver::Stage stage, glslang::TShader::Includer* includer)
+{
+	InitGlslang();
+
+	glslang::TShader* astshader = new glslang::TShader(StageToGlslang(stage));
+	glslToAstShader(glsl, astshader, -1, includer);
+
+	ShaderHotspots ret = AnalyzeAstShaderHotspots(astshader);
+
+	delete astshader;
+	return ret;
+}
+
+ComputeStat Spirver::proc::AnalyzeComputeShader(const std::string& glsl, const HardwareProfile& hw, glslang::TShader::Includer* includer)
+{
+	InitGlslang();
+
+	glslang::TShader* astshader = new glslang::TShader(EShLanguage::EShLangCompute);
+	glslToAstShader(glsl, astshader, -1, includer);
+
+	ComputeStat ret = AnalyzeAstComputeShader(astshader, hw);
+
+	delete astshader;
+	return ret;
+}
+
 #pragma endregion
 
 
@@ -537,12 +974,17 @@ ShaderStat Spirver::proc::AnalyzeShader(const std::string& glsl, Spirver::Stage
 #pragma region Lifecycle
 
 glslopt_ctx* Spirver::detail::glslOptCtx = nullptr;
+std::mutex Spirver::detail::glslOptMutex;
 bool Spirver::detail::isGlslangInitialized = false;
-spvtools::Optimizer* Spirver::detail::spirvOpt = nullptr;
+std::mutex Spirver::detail::glslangMutex;
+thread_local std::unique_ptr<spvtools::Optimizer> Spirver::detail::spirvOpt;
+thread_local std::unique_ptr<spvtools::Optimizer> Spirver::detail::spirvSizeOpt;
+thread_local std::unique_ptr<spvtools::Optimizer> Spirver::detail::spirvUnrollOpt;
 spvtools::SpirvTools* Spirver::detail::spirvTools = nullptr;
 
 void Spirver::detail::InitGlslOpt()
 {
+	std::lock_guard<std::mutex> lock(glslOptMutex);
 	if (IsGlslOptInitialized()) return;
 	
 	glslOptCtx = glslopt_initialize(kGlslTargetOpenGL);
@@ -550,6 +992,7 @@ void Spirver::detail::InitGlslOpt()
 
 void Spirver::detail::CleanGlslOpt()
 {
+	std::lock_guard<std::mutex> lock(glslOptMutex);
 	if (!IsGlslOptInitialized()) return;
 
 	glslopt_cleanup(glslOptCtx);
@@ -558,6 +1001,7 @@ void Spirver::detail::CleanGlslOpt()
 
 void Spirver::detail::InitGlslang()
 {
+	std::lock_guard<std::mutex> lock(glslangMutex);
 	if (IsGlslangInitialized()) return;
 
 	glslang::InitializeProcess();
@@ -566,7 +1010,8 @@ void Spirver::detail::InitGlslang()
 
 void Spirver::detail::CleanGlslang()
 {
-	if (!IsGlslangInitialized()) return
+	std::lock_guard<std::mutex> lock(glslangMutex);
+	if (!IsGlslangInitialized()) return;
 	
 	glslang::FinalizeProcess();
 	isGlslangInitialized = false;
@@ -575,9 +1020,7 @@ void Spirver::detail::CleanGlslang()
 void Spirver::detail::InitSpirvOpt()
 {
 	// SpirvOpt needs to be reinitialized every time
-	if (spirvOpt != nullptr) delete spirvOpt;
-	
-	spirvOpt = new spvtools::Optimizer(SPV_ENV_OPENGL_4_5);
+	spirvOpt = std::make_unique<spvtools::Optimizer>(SPV_ENV_OPENGL_4_5);
 	spirvOpt->SetMessageConsumer(printSpirvOptLog);
 	//spirvOpt.RegisterPerformancePasses(); // assign passes automatically
 	spirvOpt->RegisterPass(spvtools::CreateWrapOpKillPass())
@@ -630,8 +1073,55 @@ void Spirver::detail::CleanSpirvOpt()
 {
 	if (!IsSpirvOptInitialized()) return;
 
-	delete spirvOpt;
-	spirvOpt = nullptr;
+	spirvOpt.reset();
+}
+
+void Spirver::detail::InitSpirvSizeOpt(const SizeOptions& options)
+{
+	// passes depend on the options, so it is rebuilt every time like spirvOpt
+	spirvSizeOpt = std::make_unique<spvtools::Optimizer>(SPV_ENV_OPENGL_4_5);
+	spirvSizeOpt->SetMessageConsumer(printSpirvOptLog);
+	if (options.stripDebugInfo)
+	{
+		spirvSizeOpt->RegisterPass(spvtools::CreateStripDebugInfoPass())
+			.RegisterPass(spvtools::CreateStripNonSemanticInfoPass());
+	}
+	spirvSizeOpt->RegisterPass(spvtools::CreateEliminateDeadFunctionsPass())
+		.RegisterPass(spvtools::CreateAggressiveDCEPass())
+		.RegisterPass(spvtools::CreateUnifyConstantPass())
+		.RegisterPass(spvtools::CreateEliminateDeadConstantPass());
+	// CompactIdsPass runs in optimizeSpirvSize() after the remapper
+}
+
+void Spirver::detail::CleanSpirvSizeOpt()
+{
+	if (!IsSpirvSizeOptInitialized()) return;
+
+	spirvSizeOpt.reset();
+}
+
+void Spirver::detail::InitSpirvUnrollOpt(unsigned int factor)
+{
+	// the factor differs between calls, so it is rebuilt every time like spirvOpt
+
+	// only loops carrying the unroll hint are touched, the cleanup follows spirvOpt
+	spirvUnrollOpt = std::make_unique<spvtools::Optimizer>(SPV_ENV_OPENGL_4_5);
+	spirvUnrollOpt->SetMessageConsumer(printSpirvOptLog);
+	spirvUnrollOpt->RegisterPass(spvtools::CreateLoopUnrollPass(false, (int)factor))
+		.RegisterPass(spvtools::CreateCCPPass())
+		.RegisterPass(spvtools::CreateSimplificationPass())
+		.RegisterPass(spvtools::CreateRedundancyEliminationPass())
+		.RegisterPass(spvtools::CreateAggressiveDCEPass())
+		.RegisterPass(spvtools::CreateDeadBranchElimPass())
+		.RegisterPass(spvtools::CreateBlockMergePass())
+		.RegisterPass(spvtools::CreateSimplificationPass());
+}
+
+void Spirver::detail::CleanSpirvUnrollOpt()
+{
+	if (!IsSpirvUnrollOptInitialized()) return;
+
+	spirvUnrollOpt.reset();
 }
 
 void Spirver::detail::InitSpirvTools()
@@ -653,9 +1143,83 @@ void Spirver::detail::CleanSpirvTools()
 
 #pragma region Logging
 
-std::stringstream Spirver::detail::errors = std::stringstream();
+thread_local std::stringstream Spirver::detail::errors = std::stringstream();
+thread_local std::shared_ptr<DiagnosticSink> Spirver::detail::diagnosticSink;
+thread_local Stage Spirver::detail::diagnosticStage = Stage::StageCount;
+thread_local bool Spirver::detail::remapFailed = false;
 const char* Spirver::detail::logTypeStr[] = { "Program", "Shader", "PrespecShader" };
 
+// glslang "0:12: msg", Mesa "0:12(3): msg" and NVIDIA "0(12) : msg", after the severity prefix
+static const std::regex regLogMesa(R"(^([^\s:()]+):(\d+)\((\d+)\):\s*(.*)$)");
+static const std::regex regLogNvidia(R"(^([^\s:()]+)\((\d+)\)\s*:\s*(.*)$)");
+static const std::regex regLogGlslang(R"(^(.+?):(\d+):\s*(.*)$)");
+static const std::regex regLogSeverity(R"(^(error|warning|info|note)\b[^:]*:\s*(.*)$)", std::regex::icase);
+
+void Spirver::detail::reportLog(const char* tool, Stage stage, Severity severity, const std::string& log)
+{
+	std::vector<Diagnostic> diagnostics;
+	std::istringstream s(log);
+	for (std::string line; std::getline(s, line); )
+	{
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (line.empty()) continue;
+
+		Diagnostic d;
+		d.severity = severity;
+		d.stage = stage != Stage::StageCount ? stage : diagnosticStage;
+		d.tool = tool;
+		bool prefixed = true;
+		if (line.compare(0, 7, "ERROR: ") == 0) line.erase(0, 7);
+		else if (line.compare(0, 9, "WARNING: ") == 0) { line.erase(0, 9); d.severity = Severity::Warning; }
+		else if (line.compare(0, 6, "INFO: ") == 0) { line.erase(0, 6); d.severity = Severity::Info; }
+		else prefixed = false;
+
+		std::smatch m;
+		std::string rest = line;
+		if (std::regex_match(line, m, regLogMesa))
+		{
+			d.file = m[1];
+			d.line = (uint32_t)std::stoul(m[2]);
+			d.column = (uint32_t)std::stoul(m[3]);
+			rest = m[4];
+		}
+		else if (std::regex_match(line, m, regLogNvidia) || std::regex_match(line, m, regLogGlslang))
+		{
+			d.file = m[1];
+			d.line = (uint32_t)std::stoul(m[2]);
+			rest = m[3];
+		}
+		else if (!prefixed && !diagnostics.empty())
+		{
+			// continuation of the previous message
+			diagnostics.back().message += "\n" + line;
+			continue;
+		}
+		// glslang closes with "ERROR: 1 compilation errors.  No code generated."
+		else if (line.find("compilation errors") != std::string::npos) continue;
+
+		if (std::regex_match(rest, m, regLogSeverity))
+		{
+			char c = (char)std::tolower(m.str(1)[0]);
+			d.severity = c == 'e' ? Severity::Error : c == 'w' ? Severity::Warning : Severity::Info;
+			rest = m[2];
+		}
+		d.message = rest;
+		diagnostics.push_back(std::move(d));
+	}
+
+	if (diagnostics.empty())
+	{
+		Diagnostic d;
+		d.severity = severity;
+		d.stage = stage != Stage::StageCount ? stage : diagnosticStage;
+		d.tool = tool;
+		d.message = log;
+		diagnostics.push_back(std::move(d));
+	}
+	for (const Diagnostic& d : diagnostics) diagnosticSink->Report(d);
+}
+
 bool Spirver::detail::printLog(GLuint object, LogType logType)
 {
 	GLint success = GL_FALSE;
@@ -679,7 +1243,23 @@ bool Spirver::detail::printLog(GLuint object, LogType logType)
 
 	if (!success)
 	{
-		if (logLength > 0)
+		if (diagnosticSink != nullptr)
+		{
+			Stage stage = Stage::StageCount;
+			if (logType != LogType::Program)
+			{
+				GLint type = 0;
+				glGetShaderiv(object, GL_SHADER_TYPE, &type);
+				stage = StageToSpirver((GLenum)type);
+			}
+			std::string log(logLength > 0 ? logLength : 0, '\0');
+			if (logLength > 0 && logType == LogType::Program) glGetProgramInfoLog(object, logLength, NULL, &log[0]);
+			else if (logLength > 0) glGetShaderInfoLog(object, logLength, NULL, &log[0]);
+			log.resize(std::strlen(log.c_str()));
+			reportLog(logTypeStr[(int)logType], stage, Severity::Error, log);
+			errors << logTypeStr[(int)logType] << " error!" << std::endl;
+		}
+		else if (logLength > 0)
 		{
 			char* strInfoLog = new char[logLength];
 			switch (logType)
@@ -714,6 +1294,12 @@ bool Spirver::detail::printLog(glslang::TShader* object)
 	std::string log(object->getInfoLog());
 	if (log.size() > 0)
 	{
+		if (diagnosticSink != nullptr)
+		{
+			reportLog("AST shader", StageToSpirver(object->getStage()), Severity::Error, log);
+			errors << "AST shader error!" << std::endl;
+			return false;
+		}
 		std::cout << "AST shader error: " << std::endl << log << std::endl;
 		errors << "AST shader error: " << std::endl << log << std::endl;
 		return false;
@@ -726,6 +1312,12 @@ bool Spirver::detail::printLog(glslang::TProgram* object)
 	std::string log(object->getInfoLog());
 	if (log.size() > 0)
 	{
+		if (diagnosticSink != nullptr)
+		{
+			reportLog("AST program", Stage::StageCount, Severity::Error, log);
+			errors << "AST program error!" << std::endl;
+			return false;
+		}
 		std::cout << "AST program error: " << std::endl << log << std::endl;
 		errors << "AST program error: " << std::endl << log << std::endl;
 		return false;
@@ -738,6 +1330,12 @@ bool Spirver::detail::printLog(spv::SpvBuildLogger& object)
 	std::string log = object.getAllMessages();
 	if (log.length() > 0)
 	{
+		if (diagnosticSink != nullptr)
+		{
+			reportLog("SPIR-V build", Stage::StageCount, Severity::Error, log);
+			errors << "SPIR-V build error!" << std::endl;
+			return false;
+		}
 		std::cout << "SPIR-V build error: " << std::endl << log;
 		errors << "SPIR-V build error: " << std::endl << log;
 		return false;
@@ -747,6 +1345,12 @@ bool Spirver::detail::printLog(spv::SpvBuildLogger& object)
 
 bool Spirver::detail::printLog(glslopt_shader* object)
 {
+	if (diagnosticSink != nullptr)
+	{
+		reportLog("GLSL-Optimizer", Stage::StageCount, Severity::Error, glslopt_get_log(object));
+		errors << "GLSL-Optimizer error!" << std::endl;
+		return false;
+	}
 	std::cout << "GLSL-Optimizer error: " << std::endl << glslopt_get_log(object);
 	errors << "GLSL-Optimizer error: " << std::endl << glslopt_get_log(object);
 	return false;
@@ -755,6 +1359,20 @@ bool Spirver::detail::printLog(glslopt_shader* object)
 void Spirver::detail::printSpirvOptLog(spv_message_level_t level, const char* source,
 	const spv_position_t& position, const char* msg)
 {
+	if (diagnosticSink != nullptr)
+	{
+		if (level > SPV_MSG_INFO) return;
+		Diagnostic d;
+		d.severity = level <= SPV_MSG_ERROR ? Severity::Error : level == SPV_MSG_WARNING ? Severity::Warning : Severity::Info;
+		d.stage = diagnosticStage;
+		d.tool = "Spir-V optimizer";
+		d.file = source != nullptr ? source : "";
+		d.line = (uint32_t)position.index;
+		d.message = msg;
+		diagnosticSink->Report(d);
+		return;
+	}
+
 	switch (level) {
 	case SPV_MSG_FATAL:
 	case SPV_MSG_INTERNAL_ERROR:
@@ -775,6 +1393,19 @@ void Spirver::detail::printSpirvOptLog(spv_message_level_t level, const char* so
 	}
 }
 
+void Spirver::detail::printSpirvRemapLog(const std::string& msg)
+{
+	remapFailed = true;
+	if (diagnosticSink != nullptr)
+	{
+		reportLog("Spir-V remapper", Stage::StageCount, Severity::Error, msg);
+		errors << "Spir-V remapper error!" << std::endl;
+		return;
+	}
+	std::cerr << "Spir-V remapper error: " << msg << std::endl;
+	errors << "Spir-V remapper error: " << msg << std::endl;
+}
+
 #pragma endregion
 
 #pragma region Analysis
@@ -788,14 +1419,42 @@ ShaderStat Spirver::detail::AnalyzeAstShader(glslang::TShader* shader)
 	return t.GetShaderStat();
 }
 
+ShaderCost Spirver::detail::EstimateAstShaderCost(glslang::TShader* shader, const CostModel& model)
+{
+	SpirverCostTraverser t(model);
+	glslang::TIntermNode* root = shader->getIntermediate()->getTreeRoot();
+	if (root != nullptr) root->traverse(&t);
+	return t.GetShaderCost();
+}
+
+ShaderHotspots Spirver::detail::AnalyzeAstShaderHotspots(glslang::TShader* shader)
+{
+	SpirverAstAnalyzerTraverser t;
+	glslang::TIntermNode* root = shader->getIntermediate()->getTreeRoot();
+	if (root != nullptr) root->traverse(&t);
+	return t.GetShaderHotspots();
+}
+
+ComputeStat Spirver::detail::AnalyzeAstComputeShader(glslang::TShader* shader, const HardwareProfile& hw)
+{
+	SpirverComputeTraverser t(hw);
+	glslang::TIntermediate* intermediate = shader->getIntermediate();
+	if (intermediate->getTreeRoot() != nullptr) intermediate->getTreeRoot()->traverse(&t);
+
+	ComputeStat ret = t.GetComputeStat();
+	for (int dim = 0; dim < 3; dim++) ret.localSize[dim] = intermediate->getLocalSize(dim);
+	return ret;
+}
+
 #pragma endregion
 
 #pragma region Compilation
 
-bool Spirver::detail::glslToAstShader(const std::string& source, glslang::TShader* shader, int uniformBase)
+bool Spirver::detail::glslToAstShader(const std::string& source, glslang::TShader* shader, int uniformBase, glslang::TShader::Includer* includer)
 {
 	const char* const s[] = { source.c_str() };
 	shader->setStrings(s, 1);
+	if (includer != nullptr) shader->setPreamble(includePreamble);
 	shader->setEnvInput(glslang::EShSource::EShSourceGlsl, shader->getStage(), glslang::EShClient::EShClientOpenGL, 460);
 	shader->setEnvClient(glslang::EShClient::EShClientOpenGL, glslang::EShTargetClientVersion::EShTargetOpenGL_450);
 	shader->setEnvTarget(glslang::EShTargetLanguage::EShTargetSpv, glslang::EShTargetLanguageVersion::EShTargetSpv_1_0);
@@ -805,10 +1464,27 @@ bool Spirver::detail::glslToAstShader(const std::string& source, glslang::TShade
 		shader->setAutoMapLocations(true);
 	}
 	
-	shader->parse(&DefaultTBuiltInResource, 110, false, EShMessages::EShMsgSpvRules);
+	if (includer != nullptr) shader->parse(&DefaultTBuiltInResource, 110, false, EShMessages::EShMsgSpvRules, *includer);
+	else shader->parse(&DefaultTBuiltInResource, 110, false, EShMessages::EShMsgSpvRules);
 	return printLog(shader);
 }
 
+bool Spirver::detail::glslIncludes(const std::string& source, Stage stage, glslang::TShader::Includer* includer)
+{
+	InitGlslang();
+
+	glslang::TShader shader(StageToGlslang(stage));
+	const char* const s[] = { source.c_str() };
+	shader.setStrings(s, 1);
+	shader.setPreamble(includePreamble);
+	shader.setEnvInput(glslang::EShSource::EShSourceGlsl, shader.getStage(), glslang::EShClient::EShClientOpenGL, 460);
+	shader.setEnvClient(glslang::EShClient::EShClientOpenGL, glslang::EShTargetClientVersion::EShTargetOpenGL_450);
+
+	std::string preprocessed;
+	shader.preprocess(&DefaultTBuiltInResource, 110, ENoProfile, false, false, EShMessages::EShMsgSpvRules, &preprocessed, *includer);
+	return printLog(&shader);
+}
+
 bool Spirver::detail::astShaderToAstProgram(glslang::TShader* shader, glslang::TProgram* program)
 {
 	program->addShader(shader);
@@ -825,6 +1501,37 @@ bool Spirver::detail::astProgramToSpirv(glslang::TProgram* program, std::vector<
 	return printLog(logger);
 }
 
+bool Spirver::detail::remapSpirv(std::vector<uint32_t>& spirv)
+{
+	// the error handler is a static of spirvbin_t shared by every thread
+	static std::once_flag registered;
+	std::call_once(registered, []() { spv::spirvbin_t::registerErrorHandler(printSpirvRemapLog); });
+
+	std::vector<uint32_t> original = spirv;
+	remapFailed = false;
+	spv::spirvbin_t remapper;
+	remapper.remap(spirv, spv::spirvbin_t::MAP_ALL);
+	if (!remapFailed) return true;
+
+	spirv = std::move(original);
+	return false;
+}
+
+bool Spirver::detail::spirvBinaryToShader(const GLuint* spirv, size_t size, GLuint id, const std::vector<SpecializationConstant>& constants)
+{
+	glShaderBinary(1, &id, GL_SHADER_BINARY_FORMAT_SPIR_V, spirv, (GLsizei)(size * sizeof(GLuint))); // load binary
+	if (!printLog(id, LogType::PrespecShader)) return false;
+
+	std::vector<GLuint> ids, values;
+	for (const SpecializationConstant& c : constants)
+	{
+		ids.push_back(c.id);
+		values.push_back(c.value);
+	}
+	glSpecializeShader(id, "main", (GLuint)constants.size(), ids.data(), values.data());
+	return printLog(id, LogType::Shader);
+}
+
 #pragma endregion
 
 const TBuiltInResource Spirver::detail::DefaultTBuiltInResource = {
@@ -8,10 +8,18 @@
 #include <glslang/Public/ShaderLang.h>
 #include <spirv-tools/optimizer.hpp>
 #include <glslang/SPIRV/SpvTools.h>
+#include <glslang/SPIRV/SPVRemapper.h>
 #include <glsl_optimizer.h>
 #include <sstream>
 #include <SpirverAstAnalyzer.h>
+#include <SpirverCostEstimator.h>
+#include <SpirverRegisterPressure.h>
+#include <SpirverComputeAnalyzer.h>
 #include <regex>
+#include <optional>
+#include <set>
+#include <memory>
+#include <mutex>
 
 
 /// Compile, convert and analyze shaders with static functions
@@ -22,7 +30,7 @@ namespace Spirver
 
 /// Initialize everything now instead of lazily
 void Init();
-/// Free up memory used by Spirver
+/// Free up memory used by Spirver, waits for the queued tasks and does nothing when called from one of them
 void Clean();
 
 #pragma endregion
@@ -60,6 +68,192 @@ struct UniformProperties
 
 #pragma endregion
 
+#pragma region Specialization
+
+/// Value for a constant_id layout qualifier, passed to glSpecializeShader
+struct SpecializationConstant
+{
+	GLuint id;
+	GLuint value; // bit pattern of the constant
+};
+
+#pragma endregion
+
+#pragma region SizeOptions
+
+/// Steps of the size oriented SPIR-V output mode
+struct SizeOptions
+{
+	bool stripDebugInfo = true; // OpName, OpLine, OpSource and non-semantic instructions
+	bool compactIds = true; // renumber ids densely to shrink the id bound, raised again by canonicalizeIds
+	bool canonicalizeIds = true; // number ids from their content, so similar modules compress well together, runs last
+};
+
+/// Binary size before and after OptimizeSize()
+struct SizeReport
+{
+	size_t bytesBefore = 0;
+	size_t bytesAfter = 0;
+};
+
+#pragma endregion
+
+#pragma region ProfileGuided
+
+/// Thresholds of the profile guided optimization mode
+struct PgoOptions
+{
+	double hotShare = 0.01; // loops and branches below this share of all block executions are cold
+	double unrollTrips = 16.0; // loops averaging up to this many iterations are unrolled fully
+	unsigned int unrollInstructions = 1024; // limit of the unrolled body, instructions times iterations
+	unsigned int partialFactor = 4; // hot loops with more iterations are unrolled by this factor, below 2 disables
+	double branchBias = 0.9; // branches taking one side this often keep the branch
+	unsigned int flattenInstructions = 32; // larger sides of balanced branches keep the branch
+};
+
+/// Control hint the profile put on a loop or branch
+struct ProfileDecision
+{
+	uint32_t block = 0; // label id of the loop header or selection header
+	bool loop = false;
+	uint32_t control = 0; // spv::LoopControlMask or spv::SelectionControlMask
+	unsigned int unrollFactor = 0; // 0 unrolls fully, only for loops with the unroll hint
+	double share = 0.0; // of all block executions
+	double bias = 0.0; // average iterations of a loop, share of the likelier side of a branch
+	bool applied = false; // false if the header was not found again, for example after the optimizer changed its label
+};
+
+/// Decisions and static cost of the plain Optimize() output against the profile guided one
+struct PgoReport
+{
+	std::vector<ProfileDecision> decisions;
+	double cyclesBefore = 0.0, cyclesAfter = 0.0; // CostModel estimate
+	size_t bytesBefore = 0, bytesAfter = 0;
+};
+
+#pragma endregion
+
+#pragma region BestOf
+
+enum class OptimizerPath { None = 0, GlslOptimizer = 1, SpirvOpt = 2 };
+
+/// Both optimizer paths of GlslShader::ToSpirvBestOf(), cycles and bytes are of the SPIR-V
+struct BestOfReport
+{
+	OptimizerPath winner = OptimizerPath::None;
+	bool glslOptimizerValid = false, spirvOptValid = false;
+	double glslOptimizerCycles = 0.0, spirvOptCycles = 0.0; // CostModel estimate
+	size_t glslOptimizerBytes = 0, spirvOptBytes = 0;
+};
+
+#pragma endregion
+
+#pragma region Unrolling
+
+/// Limits of partial loop unrolling
+struct UnrollLimits
+{
+	unsigned int maxFactor = 4; // copies of the body per iteration, below 2 disables
+	unsigned int maxBodyInstructions = 64; // larger loops are left alone
+	unsigned int maxUnrolledInstructions = 256; // body instructions times factor, remainder loop included
+};
+
+/// Partial unrolling of loops with constant trip counts, limits per shader with overrides per loop
+struct UnrollPolicy
+{
+	UnrollLimits limits;
+	std::map<unsigned int, UnrollLimits> loops; // by loop index in module order, see UnrollReport
+};
+
+/// Factor chosen for one loop
+struct LoopUnroll
+{
+	unsigned int index = 0; // in module order
+	uint32_t header = 0; // label id
+	unsigned int tripCount = 0; // 0 if the bounds are not constant
+	unsigned int bodyInstructions = 0;
+	unsigned int factor = 1; // 1 leaves the loop as is
+};
+
+/// Loops and binary size before and after UnrollLoops()
+struct UnrollReport
+{
+	std::vector<LoopUnroll> loops;
+	size_t bytesBefore = 0, bytesAfter = 0;
+};
+
+#pragma endregion
+
+#pragma region Reflection
+
+enum class ResourceKind { UniformBuffer = 0, StorageBuffer = 1, Input = 2, Output = 3, SampledImage = 4, StorageImage = 5, AtomicCounter = 6 };
+
+/// An interface variable of a SPIR-V shader and its layout() properties
+struct ReflectedResource
+{
+	std::string name;
+	ResourceKind kind = ResourceKind::UniformBuffer;
+	UniformProperties properties;
+};
+
+#pragma endregion
+
+#pragma region Diagnostics
+
+enum class Severity { Info = 0, Warning = 1, Error = 2 };
+
+/// A message of the driver, glslang, glsl-optimizer or SPIRV-Tools
+struct Diagnostic
+{
+	Severity severity = Severity::Error;
+	Stage stage = Stage::StageCount; // StageCount if neither the tool nor the DiagnosticScope tell
+	const char* tool = ""; // same names as in the error strings, e.g. "AST shader"
+	std::string file; // source string index or file name as the tool reports it
+	uint32_t line = 0, column = 0; // 0 if unknown, line is the instruction index for SPIRV-Tools
+	std::string message;
+};
+
+/// Receives the diagnostics of the calls made while attached with a DiagnosticScope
+class DiagnosticSink
+{
+public:
+	virtual ~DiagnosticSink() {}
+	/// Called on the thread that made the call, a sink attached to several jobs at once must be thread safe
+	virtual void Report(const Diagnostic& diagnostic) = 0;
+};
+
+/// Collects the diagnostics of one job, Report() is thread safe
+class DiagnosticList : public DiagnosticSink
+{
+public:
+	std::vector<Diagnostic> diagnostics; // read once the job is done
+
+	void Report(const Diagnostic& diagnostic) override;
+	bool HasErrors() const;
+
+private:
+	mutable std::mutex mutex;
+};
+
+/// Attaches a sink to the calling thread until destroyed, scopes nest and nullptr detaches.
+/// With a sink attached nothing is printed and the error strings only get one line per failed tool,
+/// so HasErrors() still works. Without one the messages go to the console and GetErrors() as before.
+/// Tasks of SpirverAsync run with the sink of the thread that submitted them and keep it alive until they finish.
+class DiagnosticScope
+{
+public:
+	explicit DiagnosticScope(std::shared_ptr<DiagnosticSink> sink, Stage stage = Stage::StageCount);
+	~DiagnosticScope();
+	DiagnosticScope(const DiagnosticScope&) = delete;
+	DiagnosticScope& operator=(const DiagnosticScope&) = delete;
+
+private:
+	std::shared_ptr<DiagnosticSink> previousSink;
+	Stage previousStage;
+};
+
+#pragma endregion
+
 #pragma region ShaderInterface
 
 /// Abstract class for shader source code
@@ -71,7 +265,13 @@ public:
 
 	virtual bool Optimize() = 0;
 	virtual bool Compile(GLuint shader) = 0;
+	/// Start the driver compile without waiting for it, Collect() waits and fetches the log
+	virtual void Submit(GLuint shader) = 0;
+	bool Collect(GLuint shader);
 	virtual ShaderStat Analyze() = 0;
+	virtual ShaderCost EstimateCost(const CostModel& model = CostModel()) = 0;
+	virtual ShaderHotspots AnalyzeHotspots() = 0;
+	virtual ComputeStat AnalyzeCompute(const HardwareProfile& hw = HardwareProfile()) = 0;
 	virtual bool ToFile(std::string&& path) = 0;
 
 	Stage GetStage() { return stage; }
@@ -86,6 +286,8 @@ protected:
 };
 
 class SpirvShader;
+struct InstrumentationMap;
+struct ExecutionProfile;
 
 /// GLSL shader source code
 class GlslShader : public ShaderCode
@@ -99,19 +301,52 @@ public:
 
 	static GlslShader FromFile(const std::string& path, Stage stage);
 	static GlslShader FromMemory(const std::string& code, Stage stage);
+	/// Shader of the same stage with other code, #include resolves as for this one
+	GlslShader WithCode(const std::string& code);
 
 	bool Optimize() override;
 	bool Compile(GLuint shader) override;
+	void Submit(GLuint shader) override;
 	ShaderStat Analyze() override;
+	ShaderCost EstimateCost(const CostModel& model = CostModel()) override;
+	ShaderHotspots AnalyzeHotspots() override;
+	ComputeStat AnalyzeCompute(const HardwareProfile& hw = HardwareProfile()) override;
 	bool ToFile(std::string&& path) override;
 
 	SpirvShader ToSpirv();
+	/// Compile without linking for SpirvShader::Link(), functions with a body are exported, the others imported
+	SpirvShader ToSpirvModule();
+	/// Optimize with glsl-optimizer and with SPIRV-Tools in parallel, convert both to SPIR-V and keep
+	/// the one the cost model rates cheaper, smaller on a tie
+	SpirvShader ToSpirvBestOf(BestOfReport* report = nullptr, const CostModel& model = CostModel());
+
+	const std::string& GetCode() const { return code; }
+	/// File the shader was loaded from, #include "file" is resolved relative to it
+	const std::string& GetPath() const { return path; }
+	/// Searched for #include <file>, and for #include "file" after the directory of the shader.
+	/// Compile() and Optimize() of vertex and fragment shaders pass the code on as is, so they do not support #include.
+	void SetIncludeDirectories(const std::vector<std::string>& directories) { includeDirectories = directories; derived = Derived(); }
+	/// Every file the shader includes, directly or through other includes
+	std::set<std::string> GetIncludes();
 
 private:
 	GlslShader(const std::string& code, Stage stage);
 
 	std::string code;
 	std::map<std::string, UniformProperties> uniformProperties;
+	std::string path;
+	std::vector<std::string> includeDirectories;
+
+	// computed on first use and reset when the code changes, changed include files are not noticed
+	struct Derived
+	{
+		std::optional<std::vector<GLuint>> spirv;
+		std::string spirvErrors;
+		std::optional<ShaderStat> stat;
+		std::optional<ShaderHotspots> hotspots;
+		std::optional<std::set<std::string>> includes;
+	};
+	Derived derived;
 
 	friend class SpirvShader;
 };
@@ -131,16 +366,65 @@ public:
 
 	bool Optimize() override;
 	bool Compile(GLuint shader) override;
+	void Submit(GLuint shader) override;
 	ShaderStat Analyze() override;
+	ShaderCost EstimateCost(const CostModel& model = CostModel()) override;
+	/// Lines refer to the GLSL produced by ToGlsl()
+	ShaderHotspots AnalyzeHotspots() override;
+	ComputeStat AnalyzeCompute(const HardwareProfile& hw = HardwareProfile()) override;
 	bool ToFile(std::string&& path) override;
 
 	GlslShader ToGlsl();
 
+	bool Compile(GLuint shader, const std::vector<SpecializationConstant>& constants);
+
+	/// Resolve the imports of a module from ToSpirvModule() with library modules of the same stage, then Optimize()
+	bool Link(const std::vector<const SpirvShader*>& libraries);
+
+	/// Shrink the binary for shipping, run after Optimize()
+	bool OptimizeSize(SizeReport* report = nullptr, const SizeOptions& options = SizeOptions());
+	/// Unroll loops with constant trip counts by the factors the policy allows, run after Optimize()
+	bool UnrollLoops(UnrollReport* report = nullptr, const UnrollPolicy& policy = UnrollPolicy());
+
+	/// Peak number of live scalar components, meant to be run after Optimize()
+	RegisterPressure AnalyzeRegisterPressure();
+	/// Occupancy of a compute shader limited by its workgroup, shared memory and register pressure
+	float EstimateOccupancy(const HardwareProfile& hw = HardwareProfile());
+
+	/// Inputs, outputs, buffers and images with their locations and bindings
+	std::vector<ReflectedResource> Reflect();
+
+	/// Equal for shaders that differ only in id numbering, debug info and declaration order, run after Optimize()
+	uint64_t CanonicalHash();
+
+	/// Copy that counts block executions in a storage buffer at binding, the map decodes the buffer
+	SpirvShader Instrument(InstrumentationMap& map, uint32_t binding = 0);
+	/// Optimize() steered by a profile of this exact binary: unroll hot loops, flatten balanced branches
+	/// and keep biased ones, the report compares the static cost with plain Optimize()
+	bool OptimizeWithProfile(const ExecutionProfile& profile, PgoReport* report = nullptr, const PgoOptions& options = PgoOptions());
+
+	const std::vector<GLuint>& GetSpirv() const { return spirv; }
+
 private:
 	SpirvShader(const std::vector<GLuint>& spirv, Stage stage);
 
 	std::vector<GLuint> spirv;
 
+	// computed on first use and reset when the binary changes
+	struct Derived
+	{
+		bool optimized = false; // Optimize() has nothing left to do
+		std::optional<std::string> glsl;
+		std::optional<ShaderStat> stat;
+		std::optional<ShaderHotspots> hotspots;
+		std::optional<std::vector<ReflectedResource>> reflection;
+		std::optional<RegisterPressure> registerPressure;
+		std::optional<uint64_t> canonicalHash;
+	};
+	Derived derived;
+
+	const std::string& GetGlsl();
+
 	friend class GlslShader;
 };
 
@@ -148,6 +432,10 @@ private:
 
 }; // Spirver
 
+std::ostream& operator<<(std::ostream& os, const Spirver::BestOfReport& r);
+/// file:line:column: severity: message [stage], the tool instead of the location if it has none
+std::ostream& operator<<(std::ostream& os, const Spirver::Diagnostic& d);
+
 
 
 
@@ -173,14 +461,18 @@ bool stringToFile(const std::string& str, const std::string& path);
 
 #pragma region Compilation
 
-/// Convert GLSL with automatic uniform locations to SPIR-V
-bool glslToSpirv(const std::string& glsl, Stage stage, int& uniformBase, std::vector<GLuint>& spirv);
+/// Convert GLSL with automatic uniform locations to SPIR-V, #include needs an includer
+bool glslToSpirv(const std::string& glsl, Stage stage, int& uniformBase, std::vector<GLuint>& spirv, glslang::TShader::Includer* includer = nullptr);
 /// Convert GLSL with explicit uniform locations to SPIR-V
-inline bool glslToSpirv(const std::string& glsl, Stage stage, std::vector<GLuint>& spirv)
+inline bool glslToSpirv(const std::string& glsl, Stage stage, std::vector<GLuint>& spirv, glslang::TShader::Includer* includer = nullptr)
 {
 	int temp = -1;
-	return glslToSpirv(glsl, stage, temp, spirv);
+	return glslToSpirv(glsl, stage, temp, spirv, includer);
 }
+/// Convert GLSL to a SPIR-V module with Linkage capability, it needs no main()
+bool glslToSpirvModule(const std::string& glsl, Stage stage, std::vector<GLuint>& spirv, glslang::TShader::Includer* includer = nullptr);
+/// Link SPIR-V modules with SPIRV-Tools, library keeps unresolved imports and exports
+bool linkSpirv(const std::vector<std::vector<GLuint>>& modules, std::vector<GLuint>& linked, bool library = false);
 
 template<typename T>
 static bool spirvToShader(const std::vector<T>& spirv, Stage stage, GLuint id);
@@ -188,6 +480,9 @@ static bool spirvToShader(const std::vector<T>& spirv, Stage stage, GLuint id);
 template<typename T>
 bool spirvToGlsl(const std::vector<T>& spirv, std::string& glsl);
 
+template<typename T>
+bool reflectSpirv(const std::vector<T>& spirv, std::vector<ReflectedResource>& resources);
+
 
 /// Store the contents of layout() qualifiers of uniform variables
 void getUniformLocations(const std::string& source, std::map<std::string, UniformProperties>& uniformLocations);
@@ -206,21 +501,51 @@ bool modernGlslToLegacyGlsl(const std::string& source, std::string& output);
 template<typename T>
 bool optimizeSpirv(std::vector<T>& spirv);
 
+/// Strip debug info, compact and canonicalize ids
+template<typename T>
+bool optimizeSpirvSize(std::vector<T>& spirv, const SizeOptions& options = SizeOptions(), SizeReport* report = nullptr);
+
 /// Optimize using GLSL-Optimizer
 bool optimizeGlsl(const char* source, std::string& optimized, Stage stage);
 inline bool optimizeGlslFile(const char* filename, std::string& optimized, Stage stage)
 {
 	return optimizeGlsl(fileToString(filename).c_str(), optimized, stage);
 };
+/// Optimize any stage through SPIR-V with glslang, SPIRV-Tools and spirv-cross, keeping the layouts of uniformLocations
+bool optimizeGlslViaSpirv(const std::string& source, std::string& optimized, Stage stage,
+	const std::map<std::string, UniformProperties>& uniformLocations, glslang::TShader::Includer* includer = nullptr);
 
 #pragma endregion
 
 #pragma region Analysis
 
-ShaderStat AnalyzeShader(const std::string& glsl, Spirver::Stage stage);
+ShaderStat AnalyzeShader(const std::string& glsl, Spirver::Stage stage, glslang::TShader::Includer* includer = nullptr);
 template<typename T>
 ShaderStat AnalyzeShader(const std::vector<T>& spirv, Spirver::Stage stage);
 
+/// Estimate the cycles of one invocation, weighted by loop trip counts and branch probabilities
+ShaderCost EstimateShaderCost(const std::string& glsl, Spirver::Stage stage, const CostModel& model = CostModel(),
+	glslang::TShader::Includer* includer = nullptr);
+template<typename T>
+ShaderCost EstimateShaderCost(const std::vector<T>& spirv, Spirver::Stage stage, const CostModel& model = CostModel());
+
+/// Attribute every counted operation to its function and source line
+ShaderHotspots AnalyzeShaderHotspots(const std::string& glsl, Spirver::Stage stage, glslang::TShader::Includer* includer = nullptr);
+
+/// Estimate register pressure from the liveness of function local values
+template<typename T>
+RegisterPressure AnalyzeRegisterPressure(const std::vector<T>& spirv);
+
+/// Hash ignoring id numbering, debug info and declaration order, 0 if the binary cannot be parsed
+template<typename T>
+uint64_t canonicalHash(const std::vector<T>& spirv);
+
+/// Workgroup size, shared memory, barriers and bank conflicts of a compute shader
+ComputeStat AnalyzeComputeShader(const std::string& glsl, const HardwareProfile& hw = HardwareProfile(),
+	glslang::TShader::Includer* includer = nullptr);
+template<typename T>
+ComputeStat AnalyzeComputeShader(const std::vector<T>& spirv, const HardwareProfile& hw = HardwareProfile());
+
 #pragma endregion
 
 } // Spirver::proc
@@ -234,12 +559,19 @@ extern const TBuiltInResource DefaultTBuiltInResource;
 #pragma region Lifecycle
 
 extern glslopt_ctx* glslOptCtx;
+extern std::mutex glslOptMutex; // glsl-optimizer contexts are not thread safe
 extern bool isGlslangInitialized;
-extern spvtools::Optimizer* spirvOpt;
+extern std::mutex glslangMutex;
+// the optimizers are rebuilt on every run, so each thread gets its own, freed when the thread exits
+extern thread_local std::unique_ptr<spvtools::Optimizer> spirvOpt;
+extern thread_local std::unique_ptr<spvtools::Optimizer> spirvSizeOpt;
+extern thread_local std::unique_ptr<spvtools::Optimizer> spirvUnrollOpt;
 extern spvtools::SpirvTools* spirvTools;
 inline bool IsGlslangInitialized() { return isGlslangInitialized; }
 inline bool IsGlslOptInitialized() { return glslOptCtx != nullptr; }
 inline bool IsSpirvOptInitialized() { return spirvOpt != nullptr; }
+inline bool IsSpirvSizeOptInitialized() { return spirvSizeOpt != nullptr; }
+inline bool IsSpirvUnrollOptInitialized() { return spirvUnrollOpt != nullptr; }
 inline bool IsSpirvToolsInitialized() { return spirvTools != nullptr; }
 
 void InitGlslOpt();
@@ -248,6 +580,10 @@ void InitGlslang();
 void CleanGlslang();
 void InitSpirvOpt();
 void CleanSpirvOpt();
+void InitSpirvSizeOpt(const SizeOptions& options);
+void CleanSpirvSizeOpt();
+void InitSpirvUnrollOpt(unsigned int factor);
+void CleanSpirvUnrollOpt();
 void InitSpirvTools();
 void CleanSpirvTools();
 
@@ -255,8 +591,8 @@ void CleanSpirvTools();
 
 #pragma region Logging
 
-// culmulative error messages
-extern std::stringstream errors;
+// culmulative error messages of the calling thread
+extern thread_local std::stringstream errors;
 enum class LogType { Program = 0, Shader = 1, PrespecShader = 2, LogTypeCount = 3 };
 extern const char* logTypeStr[(int)LogType::LogTypeCount];
 // returns false on error, true on no error
@@ -266,20 +602,59 @@ bool printLog(glslang::TProgram* object);
 bool printLog(spv::SpvBuildLogger& object);
 bool printLog(glslopt_shader* object);
 void printSpirvOptLog(spv_message_level_t level, const char* source, const spv_position_t& position, const char* msg);
+void printSpirvRemapLog(const std::string& msg);
+// set by printSpirvRemapLog, the remapper itself does not report failure
+extern thread_local bool remapFailed;
+
+// sink of the calling thread, set by DiagnosticScope, nullptr for the console and errors
+extern thread_local std::shared_ptr<DiagnosticSink> diagnosticSink;
+// stage of the diagnostics that do not tell their own
+extern thread_local Stage diagnosticStage;
+// split a tool log into diagnostics for diagnosticSink, lines without a severity get the given one
+void reportLog(const char* tool, Stage stage, Severity severity, const std::string& log);
 
 #pragma endregion
 
 #pragma region Analysis
 
 ShaderStat AnalyzeAstShader(glslang::TShader* shader);
+ShaderCost EstimateAstShaderCost(glslang::TShader* shader, const CostModel& model);
+ShaderHotspots AnalyzeAstShaderHotspots(glslang::TShader* shader);
+ComputeStat AnalyzeAstComputeShader(glslang::TShader* shader, const HardwareProfile& hw);
 
 #pragma endregion
 
 #pragma region Compilation
 
-bool glslToAstShader(const std::string& source, glslang::TShader* shader, int uniformBase = -1);
+// set as preamble when an includer is given, glslang only accepts #include with this extension
+inline const char* const includePreamble = "#extension GL_GOOGLE_include_directive : enable\n";
+
+bool glslToAstShader(const std::string& source, glslang::TShader* shader, int uniformBase = -1, glslang::TShader::Includer* includer = nullptr);
+/// Files reached through #include, without compiling
+bool glslIncludes(const std::string& source, Stage stage, glslang::TShader::Includer* includer);
 bool astShaderToAstProgram(glslang::TShader* shader, glslang::TProgram* program);
 bool astProgramToSpirv(glslang::TProgram* program, std::vector<GLuint>& spirv, Stage stage);
+/// Number ids from their content with spirvbin_t, spirv is unchanged on failure
+bool remapSpirv(std::vector<uint32_t>& spirv);
+/// Load a binary into the shader object and specialize main, errors go to errors
+bool spirvBinaryToShader(const GLuint* spirv, size_t size, GLuint id, const std::vector<SpecializationConstant>& constants);
+
+#pragma endregion
+
+#pragma region Hashing
+
+/// 64 bit FNV-1a, pass a previous result as hash to continue it
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+inline uint64_t hashString(const std::string& s) { return hashBytes(s.data(), s.size()); }
 
 #pragma endregion
 
@@ -292,6 +667,7 @@ inline const std::regex regBinding = std::regex(R"(.*binding\s*=\s*(\d*).*)"); /
 inline const std::regex regStd140 = std::regex(R"(layout *.*(std140))");
 inline const std::regex regNameNoLayout = std::regex(R"(\s*(?:in|out|uniform)\s+\w+\s+(\w+)[\[\]\d ]*;.*)"); // wl, s1: name
 inline const std::regex regVersion = std::regex(R"(\s*#version\s+\d+\s*(?:core|compatibility)?\s*)"); // wl
+inline const std::regex regLocalSize = std::regex(R"(\s*layout\s*\(.*local_size_[xyz].*\)\s*in\s*;.*)"); // wl
 
 #pragma endregion
 
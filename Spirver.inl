@@ -45,6 +45,34 @@ bool spirvToGlsl(const std::vector<T>& spirv, std::string& glsl)
     return true;
 }
 
+template<typename T>
+bool reflectSpirv(const std::vector<T>& spirv, std::vector<ReflectedResource>& resources)
+{
+    spirv_cross::Compiler comp(spirv);
+    spirv_cross::ShaderResources res = comp.get_shader_resources();
+
+    auto add = [&](const auto& list, ResourceKind kind)
+    {
+        for (const spirv_cross::Resource& r : list)
+        {
+            ReflectedResource rr;
+            rr.name = r.name;
+            rr.kind = kind;
+            if (comp.has_decoration(r.id, spv::DecorationLocation)) rr.properties.location = comp.get_decoration(r.id, spv::DecorationLocation);
+            if (comp.has_decoration(r.id, spv::DecorationBinding)) rr.properties.binding = comp.get_decoration(r.id, spv::DecorationBinding);
+            resources.push_back(rr);
+        }
+    };
+    add(res.uniform_buffers, ResourceKind::UniformBuffer);
+    add(res.storage_buffers, ResourceKind::StorageBuffer);
+    add(res.stage_inputs, ResourceKind::Input);
+    add(res.stage_outputs, ResourceKind::Output);
+    add(res.sampled_images, ResourceKind::SampledImage);
+    add(res.storage_images, ResourceKind::StorageImage);
+    add(res.atomic_counters, ResourceKind::AtomicCounter);
+    return true;
+}
+
 #pragma endregion
 
 #pragma region Optimization
@@ -56,6 +84,33 @@ bool optimizeSpirv(std::vector<T>& spirv)
     return spirvOpt->Run(spirv.data(), spirv.size(), &spirv);
 }
 
+template<typename T>
+bool optimizeSpirvSize(std::vector<T>& spirv, const SizeOptions& options, SizeReport* report)
+{
+    size_t bytesBefore = spirv.size() * sizeof(T);
+
+    InitSpirvSizeOpt(options);
+    if (!spirvSizeOpt->Run(spirv.data(), spirv.size(), &spirv)) return false;
+
+    // compaction renumbers ids in order of appearance, so it has to come before the remapper,
+    // whose content derived ids are what lets similar modules compress well together
+    if (options.compactIds)
+    {
+        spvtools::Optimizer compact(SPV_ENV_OPENGL_4_5);
+        compact.SetMessageConsumer(printSpirvOptLog);
+        compact.RegisterPass(spvtools::CreateCompactIdsPass());
+        if (!compact.Run(spirv.data(), spirv.size(), &spirv)) return false;
+    }
+    if (options.canonicalizeIds && !remapSpirv(spirv)) return false;
+
+    if (report != nullptr)
+    {
+        report->bytesBefore = bytesBefore;
+        report->bytesAfter = spirv.size() * sizeof(T);
+    }
+    return true;
+}
+
 #pragma endregion
 
 #pragma region Analysis
@@ -74,6 +129,46 @@ ShaderStat AnalyzeShader(const std::vector<T>& spirv, Spirver::Stage stage)
     return stat;
 }
 
+template<typename T>
+ShaderCost EstimateShaderCost(const std::vector<T>& spirv, Spirver::Stage stage, const CostModel& model)
+{
+    std::string glsl;
+    spirvToGlsl(spirv, glsl);
+    return EstimateShaderCost(glsl, stage, model);
+}
+
+template<typename T>
+RegisterPressure AnalyzeRegisterPressure(const std::vector<T>& spirv)
+{
+    SpirvModule module;
+    if (!module.Parse((const uint32_t*)spirv.data(), spirv.size() * sizeof(T) / sizeof(uint32_t)))
+    {
+        errors << "SPIR-V parse error!" << std::endl;
+        return RegisterPressure();
+    }
+    return detail::AnalyzeRegisterPressure(module);
+}
+
+template<typename T>
+uint64_t canonicalHash(const std::vector<T>& spirv)
+{
+    SpirvModule module;
+    if (!module.Parse((const uint32_t*)spirv.data(), spirv.size() * sizeof(T) / sizeof(uint32_t)))
+    {
+        errors << "SPIR-V parse error!" << std::endl;
+        return 0;
+    }
+    return module.GetCanonicalHash();
+}
+
+template<typename T>
+ComputeStat AnalyzeComputeShader(const std::vector<T>& spirv, const HardwareProfile& hw)
+{
+    std::string glsl;
+    spirvToGlsl(spirv, glsl);
+    return AnalyzeComputeShader(glsl, hw);
+}
+
 #pragma endregion
 
 } //Spirver
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 #include <glslang/Include/intermediate.h>
 #include <glslang/Include/Types.h>
+#include <map>
+#include <set>
+#include <string>
 
 namespace Spirver {
 
@@ -36,6 +39,37 @@ struct ShaderStat
 	}
 };
 
+/// Operation counts attributed to the functions and source lines they appear in
+struct ShaderHotspots
+{
+	struct Counts
+	{
+		unsigned int stats[shaderStatTypesCount] = { 0 };
+		/// Number of counted operations, line statistics excluded
+		unsigned int Total() const;
+	};
+
+	/// Source string number, or the name of an included file, and the line in it
+	using SourceLine = std::pair<std::string, int>;
+	/// Source string of the analyzed code, included files go by their name
+	static inline const std::string mainSource = "0";
+
+	std::map<std::string, Counts> functions; // mangled name -> own operations, "" for globals
+	std::map<std::string, std::map<SourceLine, Counts>> functionLines; // mangled name -> source line -> operations
+	std::map<std::string, std::map<std::string, unsigned int>> calls; // caller -> callee -> call sites
+
+	/// Operations per source line over all functions
+	std::map<SourceLine, Counts> GetLines() const;
+
+	/// Source with the number of operations in front of every line, source is the analyzed code and included files are left out
+	std::string ToAnnotatedListing(const std::string& source) const;
+	/// "main;foo;line 12 count" lines for flame graph tools, one stack per call path, "inc.glsl:line 3" in included files
+	std::string ToFoldedStacks() const;
+
+private:
+	void WriteFoldedStacks(std::ostream& os, const std::string& function, const std::string& stack, unsigned int weight, std::set<std::string>& visiting) const;
+};
+
 extern const char* glslangOperatorNames[791];
 
 }
@@ -59,14 +93,19 @@ public:
 
 	/// Get the result of the analysis
 	ShaderStat GetShaderStat() { return stat; }
+	/// Get the result of the analysis per function and source line
+	ShaderHotspots GetShaderHotspots() { return hotspots; }
 
 	/// Get operators that were not recognised during basic stat creation
 	std::set<glslang::TOperator> GetUnknownOperators() { return unknownOperators; }
 private:
 	ShaderStat stat;
+	ShaderHotspots hotspots;
+	std::string currentFunction;
 	std::set<glslang::TOperator> unknownOperators;
 
 	void AddToOpCounts(glslang::TOperator op);
+	void Count(ShaderStatTypes type, glslang::TIntermNode* node);
 };
 
 }
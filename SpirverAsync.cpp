@@ -0,0 +1,167 @@
+#include <SpirverAsync.h>
+#include <algorithm>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+using namespace Spirver::proc;
+
+#pragma region TaskPool
+
+// pool of the worker running on this thread
+static thread_local const TaskPool* currentTaskPool = nullptr;
+
+Spirver::TaskPool::TaskPool(unsigned int threadCount)
+{
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int i = 0; i < threadCount; i++) threads.emplace_back(&TaskPool::Work, this);
+}
+
+Spirver::TaskPool::~TaskPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	available.notify_all();
+	for (std::thread& t : threads) t.join();
+}
+
+void Spirver::TaskPool::Submit(std::function<void()> task, TaskPriority priority)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push(Task{ priority, nextSequence++, std::move(task) });
+	}
+	available.notify_one();
+}
+
+bool Spirver::TaskPool::IsWorkerThread() const
+{
+	return currentTaskPool == this;
+}
+
+size_t Spirver::TaskPool::GetQueuedCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return queue.size();
+}
+
+void Spirver::TaskPool::Work()
+{
+	currentTaskPool = this;
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			available.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (queue.empty()) return; // stopping and drained
+			task = queue.top().function;
+			queue.pop();
+		}
+		task();
+	}
+}
+
+#pragma endregion
+
+#pragma region Lifecycle
+
+TaskPool* Spirver::detail::taskPool = nullptr;
+std::mutex Spirver::detail::taskPoolMutex;
+bool Spirver::detail::taskPoolStopping = false;
+
+void Spirver::detail::InitTaskPool(unsigned int threadCount)
+{
+	std::lock_guard<std::mutex> lock(taskPoolMutex);
+	if (IsTaskPoolInitialized() || taskPoolStopping) return;
+
+	taskPool = new TaskPool(threadCount);
+}
+
+bool Spirver::detail::CleanTaskPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(taskPoolMutex);
+		if (!IsTaskPoolInitialized()) return true;
+		if (taskPool->IsWorkerThread() || taskPoolStopping)
+		{
+			errors << "Task pool error: cannot clean the task pool from one of its tasks" << std::endl;
+			return false;
+		}
+		taskPoolStopping = true;
+	}
+
+	// joined outside the lock, a queued task that submits more work must not deadlock on it
+	delete taskPool;
+
+	std::lock_guard<std::mutex> lock(taskPoolMutex);
+	taskPool = nullptr;
+	taskPoolStopping = false;
+	return true;
+}
+
+void Spirver::detail::SubmitToTaskPool(std::function<void()> task, TaskPriority priority)
+{
+	{
+		std::lock_guard<std::mutex> lock(taskPoolMutex);
+		if (!taskPoolStopping)
+		{
+			if (!IsTaskPoolInitialized()) taskPool = new TaskPool();
+			taskPool->Submit(std::move(task), priority);
+			return;
+		}
+	}
+	// a new pool would outlive Clean() and run after the compilers are gone
+	task();
+}
+
+#pragma endregion
+
+#pragma region Async
+
+AsyncTask<SpirvShader> Spirver::proc::ToSpirvAsync(GlslShader& shader, TaskPriority priority, const CancellationToken& token)
+{
+	std::shared_ptr<GlslShader> copy = std::make_shared<GlslShader>(shader);
+	return SubmitTask<SpirvShader>([copy]() { return copy->ToSpirv(); }, priority, token);
+}
+
+AsyncTask<GlslShader> Spirver::proc::ToGlslAsync(SpirvShader& shader, TaskPriority priority, const CancellationToken& token)
+{
+	std::shared_ptr<SpirvShader> copy = std::make_shared<SpirvShader>(shader);
+	return SubmitTask<GlslShader>([copy]() { return copy->ToGlsl(); }, priority, token);
+}
+
+AsyncTask<GlslShader> Spirver::proc::OptimizeAsync(GlslShader& shader, TaskPriority priority, const CancellationToken& token)
+{
+	std::shared_ptr<GlslShader> copy = std::make_shared<GlslShader>(shader);
+	return SubmitTask<GlslShader>([copy]()
+		{
+			copy->Optimize();
+			return std::move(*copy);
+		}, priority, token);
+}
+
+AsyncTask<SpirvShader> Spirver::proc::OptimizeAsync(SpirvShader& shader, TaskPriority priority, const CancellationToken& token)
+{
+	std::shared_ptr<SpirvShader> copy = std::make_shared<SpirvShader>(shader);
+	return SubmitTask<SpirvShader>([copy]()
+		{
+			copy->Optimize();
+			return std::move(*copy);
+		}, priority, token);
+}
+
+AsyncTask<ShaderStat> Spirver::proc::AnalyzeAsync(GlslShader& shader, TaskPriority priority, const CancellationToken& token)
+{
+	std::shared_ptr<GlslShader> copy = std::make_shared<GlslShader>(shader);
+	return SubmitTask<ShaderStat>([copy]() { return copy->Analyze(); }, priority, token);
+}
+
+AsyncTask<ShaderStat> Spirver::proc::AnalyzeAsync(SpirvShader& shader, TaskPriority priority, const CancellationToken& token)
+{
+	std::shared_ptr<SpirvShader> copy = std::make_shared<SpirvShader>(shader);
+	return SubmitTask<ShaderStat>([copy]() { return copy->Analyze(); }, priority, token);
+}
+
+#pragma endregion
@@ -0,0 +1,228 @@
+#pragma once
+#include <Spirver.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <thread>
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#include <coroutine>
+#define SPIRVER_COROUTINES
+#endif
+
+/// Conversions and analyses on a background thread pool
+namespace Spirver {
+
+#pragma region Tasks
+
+/// Queued tasks with a higher priority run first, running tasks are never interrupted
+enum class TaskPriority { Background = 0, Normal = 1, Interactive = 2 };
+
+/// Shared between copies, cancelling skips every task with this token that has not started yet
+class CancellationToken
+{
+public:
+	CancellationToken() : cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+	void Cancel() { *cancelled = true; }
+	bool IsCancelled() const { return *cancelled; }
+
+private:
+	std::shared_ptr<std::atomic<bool>> cancelled;
+};
+
+/// Fixed number of worker threads taking tasks by priority, then in submission order
+class TaskPool
+{
+public:
+	/// 0 threads uses every hardware thread
+	explicit TaskPool(unsigned int threadCount = 0);
+	/// Runs the tasks still queued, then joins the workers
+	~TaskPool();
+	TaskPool(const TaskPool&) = delete;
+	TaskPool& operator=(const TaskPool&) = delete;
+
+	void Submit(std::function<void()> task, TaskPriority priority = TaskPriority::Normal);
+
+	size_t GetThreadCount() const { return threads.size(); }
+	/// True on one of this pool's worker threads, which must not destroy the pool
+	bool IsWorkerThread() const;
+	size_t GetQueuedCount();
+
+private:
+	struct Task
+	{
+		TaskPriority priority;
+		uint64_t sequence;
+		std::function<void()> function;
+
+		bool operator<(const Task& o) const { return priority != o.priority ? priority < o.priority : sequence > o.sequence; }
+	};
+
+	std::priority_queue<Task> queue;
+	std::mutex mutex;
+	std::condition_variable available;
+	uint64_t nextSequence = 0;
+	bool stopping = false;
+	std::vector<std::thread> threads;
+
+	void Work();
+};
+
+#pragma endregion
+
+}
+
+namespace Spirver::detail {
+
+#pragma region Lifecycle
+
+extern TaskPool* taskPool;
+extern std::mutex taskPoolMutex;
+extern bool taskPoolStopping; // set by CleanTaskPool() while it drains the pool
+inline bool IsTaskPoolInitialized() { return taskPool != nullptr; }
+
+void InitTaskPool(unsigned int threadCount = 0);
+/// Finish the queued tasks and join the workers, fails on a worker thread, which cannot join itself
+bool CleanTaskPool();
+/// Queue on the pool, created if needed, under the lock so a concurrent CleanTaskPool() cannot free it meanwhile.
+/// While CleanTaskPool() drains the pool the task runs right away on the calling thread instead.
+void SubmitToTaskPool(std::function<void()> task, TaskPriority priority);
+
+#pragma endregion
+
+template<typename T>
+struct AsyncState
+{
+	std::mutex mutex;
+	std::condition_variable done;
+	bool ready = false;
+	T value = T();
+	std::exception_ptr exception; // thrown by the task
+	std::function<void()> continuation; // resumes an awaiting coroutine
+	CancellationToken token;
+};
+
+}
+
+namespace Spirver {
+
+#pragma region AsyncTask
+
+/// Result of a task on the pool, awaitable in C++20 coroutines, which then resume on the worker thread.
+/// A task cancelled before it started completes with a default constructed value,
+/// an exception thrown by the task is rethrown by Get().
+template<typename T>
+class AsyncTask
+{
+public:
+	AsyncTask() {}
+	explicit AsyncTask(std::shared_ptr<detail::AsyncState<T>> state) : state(state) {}
+
+	bool IsValid() const { return state != nullptr; }
+	bool IsReady() const
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		return state->ready;
+	}
+	void Wait() const
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->done.wait(lock, [this] { return state->ready; });
+	}
+	/// False on timeout
+	bool WaitFor(std::chrono::milliseconds timeout) const
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		return state->done.wait_for(lock, timeout, [this] { return state->ready; });
+	}
+	/// Wait for the result
+	T& Get()
+	{
+		Wait();
+		if (state->exception) std::rethrow_exception(state->exception);
+		return state->value;
+	}
+
+	void Cancel() { state->token.Cancel(); }
+	bool IsCancelled() const { return state->token.IsCancelled(); }
+
+#ifdef SPIRVER_COROUTINES
+	bool await_ready() const { return IsReady(); }
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		if (state->ready) return false; // finished meanwhile, continue right away
+		state->continuation = [handle]() { handle.resume(); };
+		return true;
+	}
+	T& await_resume()
+	{
+		if (state->exception) std::rethrow_exception(state->exception);
+		return state->value;
+	}
+#endif
+
+private:
+	std::shared_ptr<detail::AsyncState<T>> state;
+};
+
+#pragma endregion
+
+}
+
+namespace Spirver::detail {
+
+/// Run function on the task pool unless the token is cancelled first, with the diagnostic sink of the calling thread.
+/// The task holds a reference to the sink, so it may outlive the scope that attached it.
+template<typename T, typename F>
+AsyncTask<T> SubmitTask(F function, TaskPriority priority, const CancellationToken& token)
+{
+	std::shared_ptr<AsyncState<T>> state = std::make_shared<AsyncState<T>>();
+	state->token = token;
+	std::shared_ptr<DiagnosticSink> sink = diagnosticSink;
+	Stage stage = diagnosticStage;
+
+	SubmitToTaskPool([state, function, sink, stage]() mutable
+		{
+			if (!state->token.IsCancelled())
+			{
+				// an exception leaving a worker would terminate the process
+				DiagnosticScope scope(sink, stage);
+				try { state->value = function(); }
+				catch (...) { state->exception = std::current_exception(); }
+			}
+
+			std::function<void()> continuation;
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->ready = true;
+				continuation = std::move(state->continuation);
+			}
+			state->done.notify_all();
+			if (continuation) continuation();
+		}, priority);
+
+	return AsyncTask<T>(state);
+}
+
+}
+
+namespace Spirver::proc {
+
+// The shaders are copied, so they can be changed or destroyed while the tasks run.
+
+AsyncTask<SpirvShader> ToSpirvAsync(GlslShader& shader, TaskPriority priority = TaskPriority::Normal, const CancellationToken& token = CancellationToken());
+AsyncTask<GlslShader> ToGlslAsync(SpirvShader& shader, TaskPriority priority = TaskPriority::Normal, const CancellationToken& token = CancellationToken());
+
+/// Optimized copy of the shader
+AsyncTask<GlslShader> OptimizeAsync(GlslShader& shader, TaskPriority priority = TaskPriority::Normal, const CancellationToken& token = CancellationToken());
+AsyncTask<SpirvShader> OptimizeAsync(SpirvShader& shader, TaskPriority priority = TaskPriority::Normal, const CancellationToken& token = CancellationToken());
+
+AsyncTask<ShaderStat> AnalyzeAsync(GlslShader& shader, TaskPriority priority = TaskPriority::Normal, const CancellationToken& token = CancellationToken());
+AsyncTask<ShaderStat> AnalyzeAsync(SpirvShader& shader, TaskPriority priority = TaskPriority::Normal, const CancellationToken& token = CancellationToken());
+
+}
@@ -0,0 +1,74 @@
+#include <SpirverCompileBatch.h>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+using namespace Spirver::proc;
+
+bool Spirver::proc::isCompileComplete(GLuint shader)
+{
+	if (!ShaderCompileBatch::IsParallelCompileSupported()) return true;
+
+	GLint complete = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+bool Spirver::proc::isLinkComplete(GLuint program)
+{
+	if (!ShaderCompileBatch::IsParallelCompileSupported()) return true;
+
+	GLint complete = GL_FALSE;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+bool ShaderCompileBatch::IsParallelCompileSupported()
+{
+	return GLEW_KHR_parallel_shader_compile;
+}
+
+ShaderCompileBatch::ShaderCompileBatch(GLuint driverThreads)
+{
+	if (IsParallelCompileSupported()) glMaxShaderCompilerThreadsKHR(driverThreads);
+}
+
+size_t ShaderCompileBatch::Add(ShaderCode& shader)
+{
+	DriverCompileResult result;
+	result.shader = glCreateShader(StageToGlsl(shader.GetStage()));
+	shader.Submit(result.shader);
+
+	results.push_back(std::move(result));
+	pending++;
+	return results.size() - 1;
+}
+
+std::vector<size_t> ShaderCompileBatch::Poll()
+{
+	std::vector<size_t> collected;
+	bool parallel = IsParallelCompileSupported();
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		if (results[i].done || !isCompileComplete(results[i].shader)) continue;
+
+		Collect(results[i]);
+		collected.push_back(i);
+		if (!parallel) break; // the next one would block as well
+	}
+	return collected;
+}
+
+void ShaderCompileBatch::Wait()
+{
+	for (DriverCompileResult& result : results)
+		if (!result.done) Collect(result);
+}
+
+void ShaderCompileBatch::Collect(DriverCompileResult& result)
+{
+	// the status is ready, so the usual log query does not wait anymore
+	result.success = printLog(result.shader, LogType::Shader);
+	if (!result.success) result.log = Spirver::proc::GetErrors();
+	result.done = true;
+	pending--;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <Spirver.h>
+
+namespace Spirver {
+
+/// Outcome of one driver compile in a ShaderCompileBatch
+struct DriverCompileResult
+{
+	GLuint shader = 0; // shader object, owned by the caller
+	bool done = false;
+	bool success = false;
+	std::string log;
+};
+
+/// Issues every driver compile before waiting on any of them.
+/// With GL_KHR_parallel_shader_compile the driver compiles on its own threads and Poll() never blocks.
+class ShaderCompileBatch
+{
+public:
+	/// driverThreads is passed to glMaxShaderCompilerThreadsKHR, 0xFFFFFFFF lets the driver choose
+	ShaderCompileBatch(GLuint driverThreads = 0xFFFFFFFF);
+
+	/// Create a shader object and start compiling into it, returns the index of its result
+	size_t Add(ShaderCode& shader);
+	/// Collect finished compiles, returns the indices collected by this call.
+	/// Without the extension every query waits, so only one compile is collected per call.
+	std::vector<size_t> Poll();
+	/// Collect everything
+	void Wait();
+
+	bool IsDone() const { return pending == 0; }
+	size_t Size() const { return results.size(); }
+	const DriverCompileResult& GetResult(size_t i) const { return results[i]; }
+
+	static bool IsParallelCompileSupported();
+
+private:
+	std::vector<DriverCompileResult> results;
+	size_t pending = 0;
+
+	void Collect(DriverCompileResult& result);
+};
+
+}
+
+namespace Spirver::proc {
+
+/// True once the driver finished compiling, always true without GL_KHR_parallel_shader_compile
+bool isCompileComplete(GLuint shader);
+/// True once the driver finished linking, always true without GL_KHR_parallel_shader_compile
+bool isLinkComplete(GLuint program);
+
+}
@@ -0,0 +1,204 @@
+#include <SpirverComputeAnalyzer.h>
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+
+#pragma region ComputeStat
+
+float ComputeStat::EstimateOccupancy(const HardwareProfile& hw, unsigned int registersPerThread) const
+{
+	if (hw.warpSize == 0) return 0.0f;
+	unsigned int maxWarps = hw.maxThreadsPerUnit / hw.warpSize;
+	unsigned int warpsPerGroup = (GetWorkgroupSize() + hw.warpSize - 1) / hw.warpSize;
+	if (maxWarps == 0 || warpsPerGroup == 0) return 0.0f;
+
+	// resident workgroups are limited by threads, workgroup slots, shared memory and registers
+	unsigned int groups = std::min(maxWarps / warpsPerGroup, hw.maxWorkgroupsPerUnit);
+	if (sharedBytes > 0) groups = std::min(groups, hw.sharedMemoryPerUnit / sharedBytes);
+	if (registersPerThread > 0) groups = std::min(groups, hw.registersPerUnit / (registersPerThread * warpsPerGroup * hw.warpSize));
+
+	return (float)(groups * warpsPerGroup) / maxWarps;
+}
+
+#pragma endregion
+
+std::ostream& operator<<(std::ostream& os, const ComputeStat& s)
+{
+	os << "localSize: " << s.localSize[0] << " " << s.localSize[1] << " " << s.localSize[2] << std::endl;
+	os << "sharedBytes: " << s.sharedBytes << std::endl;
+	for (const auto& v : s.sharedVariables)
+		os << "  " << v.first << ": " << v.second << std::endl;
+	os << "barriers: " << s.barriers << std::endl;
+	os << "barriersInLoops: " << s.barriersInLoops << std::endl;
+	os << "maxConflictWays: " << s.maxConflictWays << std::endl;
+	for (const SharedAccess& a : s.sharedAccesses)
+		if (a.conflictWays > 1)
+			os << "  " << a.name << " line " << a.line << ": stride " << a.strideWords << ", " << a.conflictWays << "-way conflict" << std::endl;
+	return os;
+}
+
+#pragma region SpirverComputeTraverser
+
+// size of a variable without any layout padding
+static unsigned int typeSize(const glslang::TType& type)
+{
+	unsigned int size = 0;
+	if (type.isStruct())
+	{
+		for (const glslang::TTypeLoc& member : *type.getStruct()) size += typeSize(*member.type);
+	}
+	else
+	{
+		glslang::TBasicType b = type.getBasicType();
+		unsigned int scalar = (b == glslang::EbtDouble || b == glslang::EbtInt64 || b == glslang::EbtUint64) ? 8 : 4;
+		unsigned int components = type.isMatrix() ? type.getMatrixCols() * type.getMatrixRows() : type.getVectorSize();
+		size = scalar * components;
+	}
+	if (type.isArray()) size *= type.getCumulativeArraySize();
+	return size;
+}
+
+// how far the index moves between neighbouring invocations, assuming unknown terms move by 1
+static unsigned int indexStride(glslang::TIntermTyped* index)
+{
+	if (index->getAsConstantUnion() != nullptr) return 0;
+
+	glslang::TIntermBinary* b = index->getAsBinaryNode();
+	if (b == nullptr) return 1;
+
+	glslang::TIntermConstantUnion* left = b->getLeft()->getAsConstantUnion();
+	glslang::TIntermConstantUnion* right = b->getRight()->getAsConstantUnion();
+	glslang::TIntermConstantUnion* c = right != nullptr ? right : left;
+	glslang::TIntermTyped* other = right != nullptr ? b->getLeft() : b->getRight();
+	if (c == nullptr || c->getConstArray().size() < 1) return 1;
+
+	unsigned int value;
+	switch (c->getConstArray()[0].getType())
+	{
+	case glslang::EbtInt: value = (unsigned int)std::abs(c->getConstArray()[0].getIConst()); break;
+	case glslang::EbtUint: value = c->getConstArray()[0].getUConst(); break;
+	default: return 1;
+	}
+
+	switch (b->getOp())
+	{
+	case glslang::EOpMul: return value * indexStride(other);
+	case glslang::EOpLeftShift: return right != nullptr ? (1u << value) * indexStride(other) : 1;
+	case glslang::EOpAdd:
+	case glslang::EOpSub: return indexStride(other);
+	default: return 1;
+	}
+}
+
+void SpirverComputeTraverser::visitSymbol(glslang::TIntermSymbol* node)
+{
+	if (node->getQualifier().storage != glslang::EvqShared) return;
+
+	std::string name = node->getName().c_str();
+	if (stat.sharedVariables.count(name)) return;
+
+	unsigned int size = typeSize(node->getType());
+	stat.sharedVariables[name] = size;
+	stat.sharedBytes += size;
+}
+
+bool SpirverComputeTraverser::visitBinary(glslang::TVisit, glslang::TIntermBinary* node)
+{
+	if (node->getOp() != glslang::EOpIndexIndirect) return true;
+
+	glslang::TIntermSymbol* array = node->getLeft()->getAsSymbolNode();
+	if (array == nullptr || array->getQualifier().storage != glslang::EvqShared) return true;
+
+	// element size in 4 byte words
+	glslang::TType element(array->getType(), 0);
+	unsigned int elementWords = std::max(typeSize(element) / 4, 1u);
+
+	SharedAccess access;
+	access.name = array->getName().c_str();
+	access.line = node->getLoc().line;
+	access.strideWords = indexStride(node->getRight()) * elementWords;
+	access.conflictWays = access.strideWords == 0 ? 1 : std::gcd(access.strideWords, hw.sharedMemoryBanks);
+	stat.maxConflictWays = std::max(stat.maxConflictWays, access.conflictWays);
+	stat.sharedAccesses.push_back(access);
+	return true;
+}
+
+void SpirverComputeTraverser::CountBarrier(glslang::TOperator op)
+{
+	switch (op)
+	{
+	case glslang::EOpBarrier:
+	case glslang::EOpMemoryBarrier:
+	case glslang::EOpMemoryBarrierShared:
+	case glslang::EOpGroupMemoryBarrier:
+		stat.barriers++;
+		barriers[currentFunction]++;
+		if (loopDepth > 0) barriersInLoops[currentFunction]++;
+		break;
+	default:
+		break;
+	}
+}
+
+bool SpirverComputeTraverser::visitUnary(glslang::TVisit, glslang::TIntermUnary* node)
+{
+	CountBarrier(node->getOp());
+	return true;
+}
+
+bool SpirverComputeTraverser::visitAggregate(glslang::TVisit, glslang::TIntermAggregate* node)
+{
+	switch (node->getOp())
+	{
+	case glslang::EOpFunction:
+	{
+		std::string previous = currentFunction;
+		currentFunction = node->getName().c_str();
+		for (glslang::TIntermNode* child : node->getSequence()) child->traverse(this);
+		currentFunction = previous;
+		return false;
+	}
+	case glslang::EOpFunctionCall:
+		if (node->isUserDefined()) (loopDepth > 0 ? callsInLoops : calls)[currentFunction].insert(node->getName().c_str());
+		return true;
+	default:
+		CountBarrier(node->getOp());
+		return true;
+	}
+}
+
+bool SpirverComputeTraverser::visitLoop(glslang::TVisit, glslang::TIntermLoop* node)
+{
+	loopDepth++;
+	if (node->getTest() != nullptr) node->getTest()->traverse(this);
+	if (node->getBody() != nullptr) node->getBody()->traverse(this);
+	if (node->getTerminal() != nullptr) node->getTerminal()->traverse(this);
+	loopDepth--;
+	return false;
+}
+
+// everything a function called from a loop calls runs in that loop too
+void SpirverComputeTraverser::MarkInLoop(const std::string& name, std::set<std::string>& inLoop)
+{
+	if (!inLoop.insert(name).second) return;
+	for (const std::string& callee : calls[name]) MarkInLoop(callee, inLoop);
+	for (const std::string& callee : callsInLoops[name]) MarkInLoop(callee, inLoop);
+}
+
+ComputeStat SpirverComputeTraverser::GetComputeStat()
+{
+	std::set<std::string> inLoop;
+	for (const auto& caller : callsInLoops)
+		for (const std::string& callee : caller.second) MarkInLoop(callee, inLoop);
+
+	ComputeStat ret = stat;
+	ret.barriersInLoops = 0;
+	for (const auto& f : barriers)
+		ret.barriersInLoops += inLoop.count(f.first) ? f.second : barriersInLoops[f.first];
+	return ret;
+}
+
+#pragma endregion
@@ -0,0 +1,80 @@
+#pragma once
+#include <glslang/Include/intermediate.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace Spirver {
+
+/// Limits of one GPU compute unit, used for occupancy estimates
+struct HardwareProfile
+{
+	unsigned int warpSize = 32; // invocations executed in lockstep
+	unsigned int maxThreadsPerUnit = 2048;
+	unsigned int maxWorkgroupsPerUnit = 32;
+	unsigned int sharedMemoryPerUnit = 65536; // bytes
+	unsigned int registersPerUnit = 65536; // 32 bit registers
+	unsigned int sharedMemoryBanks = 32; // 4 byte wide banks
+};
+
+/// Indexing of a shared array
+struct SharedAccess
+{
+	std::string name;
+	int line = 0;
+	unsigned int strideWords = 1; // words between the elements of neighbouring invocations, 0 if uniform
+	unsigned int conflictWays = 1; // invocations of a warp hitting the same bank
+};
+
+/// Workgroup, shared memory and barrier statistics of a compute shader
+struct ComputeStat
+{
+	unsigned int localSize[3] = { 1, 1, 1 };
+	unsigned int sharedBytes = 0; // shared memory per workgroup
+	std::map<std::string, unsigned int> sharedVariables; // name -> bytes
+	unsigned int barriers = 0;
+	unsigned int barriersInLoops = 0; // also in functions called from a loop
+	std::vector<SharedAccess> sharedAccesses;
+	unsigned int maxConflictWays = 1;
+
+	unsigned int GetWorkgroupSize() const { return localSize[0] * localSize[1] * localSize[2]; }
+	/// Resident warps over the maximum, registersPerThread 0 ignores the register file
+	float EstimateOccupancy(const HardwareProfile& hw, unsigned int registersPerThread = 0) const;
+};
+
+}
+
+std::ostream& operator<<(std::ostream& os, const Spirver::ComputeStat& s);
+
+namespace Spirver::detail
+{
+
+class SpirverComputeTraverser : public glslang::TIntermTraverser
+{
+public:
+	SpirverComputeTraverser(const HardwareProfile& hw) : hw(hw) {}
+
+	void visitSymbol(glslang::TIntermSymbol* node) override;
+	bool visitBinary(glslang::TVisit, glslang::TIntermBinary* node) override;
+	bool visitUnary(glslang::TVisit, glslang::TIntermUnary* node) override;
+	bool visitAggregate(glslang::TVisit, glslang::TIntermAggregate* node) override;
+	bool visitLoop(glslang::TVisit, glslang::TIntermLoop* node) override;
+
+	/// Resolve calls and get the result of the analysis, local size is filled in by the caller
+	ComputeStat GetComputeStat();
+
+private:
+	const HardwareProfile& hw;
+	ComputeStat stat;
+	int loopDepth = 0;
+	std::string currentFunction;
+	std::map<std::string, unsigned int> barriers, barriersInLoops; // per function, excluding calls
+	std::map<std::string, std::set<std::string>> calls, callsInLoops; // caller -> callees
+
+	void CountBarrier(glslang::TOperator op);
+	void MarkInLoop(const std::string& name, std::set<std::string>& inLoop);
+};
+
+}
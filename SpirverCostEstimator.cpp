@@ -0,0 +1,366 @@
+#include <SpirverCostEstimator.h>
+#include <SpirverAstAnalyzer.h>
+#include <Spirver.h>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+
+#pragma region CostModel
+
+CostModel::CostModel()
+{
+	opWeights = std::vector<float>(791, 1.0f);
+
+	// bookkeeping nodes, no instructions of their own
+	for (glslang::TOperator op : { glslang::EOpNull, glslang::EOpSequence, glslang::EOpLinkerObjects,
+		glslang::EOpFunction, glslang::EOpParameters, glslang::EOpFunctionCall, glslang::EOpComma,
+		glslang::EOpIndexDirect, glslang::EOpIndexDirectStruct, glslang::EOpVectorSwizzle,
+		glslang::EOpCase, glslang::EOpDefault, glslang::EOpBreak, glslang::EOpContinue, glslang::EOpReturn })
+		opWeights[op] = 0.0f;
+	for (int op = glslang::EOpConstructGuardStart; op <= glslang::EOpConstructGuardEnd; op++)
+		opWeights[op] = 0.0f;
+
+	for (glslang::TOperator op : { glslang::EOpDiv, glslang::EOpMod, glslang::EOpSqrt, glslang::EOpInverseSqrt,
+		glslang::EOpLength, glslang::EOpDistance, glslang::EOpNormalize, glslang::EOpReflect, glslang::EOpDivAssign,
+		glslang::EOpModAssign, glslang::EOpMatrixTimesVector, glslang::EOpVectorTimesMatrix })
+		opWeights[op] = 4.0f;
+
+	for (glslang::TOperator op : { glslang::EOpSin, glslang::EOpCos, glslang::EOpTan, glslang::EOpAsin,
+		glslang::EOpAcos, glslang::EOpAtan, glslang::EOpSinh, glslang::EOpCosh, glslang::EOpTanh,
+		glslang::EOpAsinh, glslang::EOpAcosh, glslang::EOpAtanh, glslang::EOpPow, glslang::EOpExp,
+		glslang::EOpLog, glslang::EOpExp2, glslang::EOpLog2, glslang::EOpRefract,
+		glslang::EOpMatrixTimesMatrix, glslang::EOpMatrixTimesMatrixAssign })
+		opWeights[op] = 8.0f;
+
+	for (glslang::TOperator op : { glslang::EOpDeterminant, glslang::EOpMatrixInverse })
+		opWeights[op] = 32.0f;
+
+	for (int op = glslang::EOpSamplingGuardBegin; op <= glslang::EOpSamplingGuardEnd; op++)
+		opWeights[op] = 16.0f;
+
+	for (glslang::TOperator op : { glslang::EOpBarrier, glslang::EOpMemoryBarrier, glslang::EOpMemoryBarrierShared,
+		glslang::EOpGroupMemoryBarrier })
+		opWeights[op] = 8.0f;
+}
+
+bool CostModel::LoadFromFile(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		errors << "Cost model error: cannot open " << path << std::endl;
+		return false;
+	}
+
+	std::stringstream s;
+	s << file.rdbuf();
+	return LoadFromMemory(s.str());
+}
+
+bool CostModel::LoadFromMemory(const std::string& table)
+{
+	static const std::map<std::string, int> opIndices = []()
+		{
+			std::map<std::string, int> indices;
+			for (int i = 0; i < 791; i++) indices[glslangOperatorNames[i]] = i;
+			return indices;
+		}();
+
+	// a typo in a weight table must not go unnoticed, every line is checked
+	bool success = true;
+	std::istringstream s(table);
+	int lineNumber = 0;
+	for (std::string line; std::getline(s, line); )
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream ls(line);
+		std::string key;
+		if (!(ls >> key)) continue; // empty or comment
+
+		if (key == "switchProbabilities")
+		{
+			switchProbabilities.clear();
+			for (float p; ls >> p; ) switchProbabilities.push_back(p);
+			continue;
+		}
+
+		double value;
+		if (!(ls >> value))
+		{
+			errors << "Cost model error: line " << lineNumber << ": " << key << " has no value" << std::endl;
+			success = false;
+			continue;
+		}
+
+		if (key == "loopOverhead") loopOverhead = (float)value;
+		else if (key == "branchOverhead") branchOverhead = (float)value;
+		else if (key == "ifProbability") ifProbability = (float)value;
+		else if (key == "defaultTripCount") defaultTripCount = (unsigned int)value;
+		else if (key == "maxTripCount") maxTripCount = (unsigned int)value;
+		else if (key == "defaultWeight") defaultWeight = (float)value;
+		else
+		{
+			auto it = opIndices.find(key);
+			if (it == opIndices.end())
+			{
+				errors << "Cost model error: line " << lineNumber << ": unknown operator or setting " << key << std::endl;
+				success = false;
+				continue;
+			}
+			if ((size_t)it->second >= opWeights.size()) opWeights.resize(it->second + 1, defaultWeight);
+			opWeights[it->second] = (float)value;
+		}
+	}
+
+	return success;
+}
+
+#pragma endregion
+
+std::ostream& operator<<(std::ostream& os, const ShaderCost& c)
+{
+	os << "estimatedCycles: " << c.estimatedCycles << std::endl;
+	for (const auto& f : c.functionCycles)
+		os << "  " << f.first << ": " << f.second << std::endl;
+	return os;
+}
+
+#pragma region SpirverCostTraverser
+
+// value of a scalar constant node
+static bool getConstantScalar(glslang::TIntermTyped* node, double& value)
+{
+	glslang::TIntermConstantUnion* c = node != nullptr ? node->getAsConstantUnion() : nullptr;
+	if (c == nullptr || c->getConstArray().size() < 1) return false;
+
+	const glslang::TConstUnion& u = c->getConstArray()[0];
+	switch (u.getType())
+	{
+	case glslang::EbtInt: value = u.getIConst(); return true;
+	case glslang::EbtUint: value = u.getUConst(); return true;
+	case glslang::EbtFloat:
+	case glslang::EbtDouble: value = u.getDConst(); return true;
+	default: return false;
+	}
+}
+
+void SpirverCostTraverser::AddCost(glslang::TOperator op)
+{
+	float weight = (size_t)op < model.opWeights.size() ? model.opWeights[op] : model.defaultWeight;
+	selfCycles[currentFunction] += weight * multiplier;
+}
+
+unsigned int SpirverCostTraverser::DeriveTripCount(glslang::TIntermLoop* node)
+{
+	// test: i < N, i <= N, i > N, i >= N or i != N
+	glslang::TIntermBinary* test = node->getTest() != nullptr ? node->getTest()->getAsBinaryNode() : nullptr;
+	if (test == nullptr) return 0;
+	glslang::TIntermSymbol* index = test->getLeft()->getAsSymbolNode();
+	double bound;
+	if (index == nullptr || !getConstantScalar(test->getRight(), bound)) return 0;
+
+	// init: the last constant assigned to the index before the loop
+	auto init = constantInits.find(index->getId());
+	if (init == constantInits.end()) return 0;
+
+	// terminal: i++, i--, i += c or i -= c
+	glslang::TIntermTyped* terminal = node->getTerminal();
+	if (terminal == nullptr) return 0;
+	double step = 0.0;
+	if (glslang::TIntermUnary* u = terminal->getAsUnaryNode())
+	{
+		glslang::TIntermSymbol* s = u->getOperand()->getAsSymbolNode();
+		if (s == nullptr || s->getId() != index->getId()) return 0;
+		switch (u->getOp())
+		{
+		case glslang::EOpPostIncrement:
+		case glslang::EOpPreIncrement: step = 1.0; break;
+		case glslang::EOpPostDecrement:
+		case glslang::EOpPreDecrement: step = -1.0; break;
+		default: return 0;
+		}
+	}
+	else if (glslang::TIntermBinary* b = terminal->getAsBinaryNode())
+	{
+		glslang::TIntermSymbol* s = b->getLeft()->getAsSymbolNode();
+		if (s == nullptr || s->getId() != index->getId() || !getConstantScalar(b->getRight(), step)) return 0;
+		if (b->getOp() == glslang::EOpSubAssign) step = -step;
+		else if (b->getOp() != glslang::EOpAddAssign) return 0;
+	}
+	if (step == 0.0) return 0;
+
+	double start = init->second, trips = 0.0;
+	switch (test->getOp())
+	{
+	case glslang::EOpLessThan: trips = std::ceil((bound - start) / step); break;
+	case glslang::EOpLessThanEqual: trips = std::floor((bound - start) / step) + 1.0; break;
+	case glslang::EOpGreaterThan: trips = std::ceil((bound - start) / step); break;
+	case glslang::EOpGreaterThanEqual: trips = std::floor((bound - start) / step) + 1.0; break;
+	case glslang::EOpNotEqual: trips = (bound - start) / step; if (trips != std::floor(trips)) return 0; break;
+	default: return 0;
+	}
+
+	if (trips < 1.0) return 1; // a loop that never runs still evaluates its test
+	return (unsigned int)std::min(trips, (double)model.maxTripCount);
+}
+
+bool SpirverCostTraverser::visitBinary(glslang::TVisit, glslang::TIntermBinary* node)
+{
+	glslang::TOperator op = node->getOp();
+	AddCost(op);
+
+	// remember constant initializers to derive trip counts later
+	if (op == glslang::EOpAssign)
+	{
+		glslang::TIntermSymbol* s = node->getLeft()->getAsSymbolNode();
+		double value;
+		if (s != nullptr)
+		{
+			if (getConstantScalar(node->getRight(), value)) constantInits[s->getId()] = value;
+			else constantInits.erase(s->getId());
+		}
+	}
+	return true;
+}
+
+bool SpirverCostTraverser::visitUnary(glslang::TVisit, glslang::TIntermUnary* node)
+{
+	AddCost(node->getOp());
+	return true;
+}
+
+bool SpirverCostTraverser::visitSelection(glslang::TVisit, glslang::TIntermSelection* node)
+{
+	selfCycles[currentFunction] += model.branchOverhead * multiplier;
+	node->getCondition()->traverse(this);
+
+	double base = multiplier;
+	if (node->getTrueBlock() != nullptr)
+	{
+		multiplier = base * model.ifProbability;
+		node->getTrueBlock()->traverse(this);
+	}
+	if (node->getFalseBlock() != nullptr)
+	{
+		multiplier = base * (1.0 - model.ifProbability);
+		node->getFalseBlock()->traverse(this);
+	}
+	multiplier = base;
+	return false;
+}
+
+bool SpirverCostTraverser::visitAggregate(glslang::TVisit, glslang::TIntermAggregate* node)
+{
+	glslang::TOperator op = node->getOp();
+	AddCost(op);
+
+	switch (op)
+	{
+	case glslang::EOpLinkerObjects:
+		return false; // declarations only
+	case glslang::EOpFunction:
+	{
+		std::string previous = currentFunction;
+		currentFunction = node->getName().c_str();
+		selfCycles[currentFunction];
+		for (glslang::TIntermNode* child : node->getSequence()) child->traverse(this);
+		currentFunction = previous;
+		return false;
+	}
+	case glslang::EOpFunctionCall:
+		if (!node->isUserDefined()) return true;
+		calls[currentFunction][node->getName().c_str()] += multiplier;
+		return true;
+	default:
+		return true;
+	}
+}
+
+bool SpirverCostTraverser::visitLoop(glslang::TVisit, glslang::TIntermLoop* node)
+{
+	unsigned int trips = DeriveTripCount(node);
+	if (trips == 0) trips = model.defaultTripCount;
+
+	double base = multiplier;
+	multiplier = base * trips;
+	selfCycles[currentFunction] += model.loopOverhead * multiplier;
+	if (node->getTest() != nullptr) node->getTest()->traverse(this);
+	if (node->getBody() != nullptr) node->getBody()->traverse(this);
+	if (node->getTerminal() != nullptr) node->getTerminal()->traverse(this);
+	multiplier = base;
+	return false;
+}
+
+bool SpirverCostTraverser::visitBranch(glslang::TVisit, glslang::TIntermBranch* node)
+{
+	AddCost(node->getFlowOp());
+	return true;
+}
+
+bool SpirverCostTraverser::visitSwitch(glslang::TVisit, glslang::TIntermSwitch* node)
+{
+	selfCycles[currentFunction] += model.branchOverhead * multiplier;
+	node->getCondition()->traverse(this);
+
+	glslang::TIntermSequence& body = node->getBody()->getSequence();
+	int armCount = 0;
+	for (glslang::TIntermNode* child : body)
+	{
+		glslang::TIntermBranch* b = child->getAsBranchNode();
+		if (b != nullptr && (b->getFlowOp() == glslang::EOpCase || b->getFlowOp() == glslang::EOpDefault)) armCount++;
+	}
+
+	// statements after a label run with the probability of that arm
+	double base = multiplier;
+	int arm = -1;
+	for (glslang::TIntermNode* child : body)
+	{
+		glslang::TIntermBranch* b = child->getAsBranchNode();
+		if (b != nullptr && (b->getFlowOp() == glslang::EOpCase || b->getFlowOp() == glslang::EOpDefault))
+		{
+			arm++;
+			double p = arm < (int)model.switchProbabilities.size() ? model.switchProbabilities[arm] : 1.0 / armCount;
+			multiplier = base * p;
+			continue;
+		}
+		child->traverse(this);
+	}
+	multiplier = base;
+	return false;
+}
+
+double SpirverCostTraverser::ResolveFunction(const std::string& name, std::map<std::string, double>& resolved, std::set<std::string>& visiting)
+{
+	auto it = resolved.find(name);
+	if (it != resolved.end()) return it->second;
+	if (!visiting.insert(name).second) return 0.0; // recursion is not allowed in GLSL, but don't hang on it
+
+	double cycles = selfCycles[name];
+	for (const auto& callee : calls[name])
+		cycles += callee.second * ResolveFunction(callee.first, resolved, visiting);
+
+	visiting.erase(name);
+	resolved[name] = cycles;
+	return cycles;
+}
+
+ShaderCost SpirverCostTraverser::GetShaderCost()
+{
+	ShaderCost cost;
+	std::set<std::string> visiting;
+	for (const auto& f : selfCycles)
+		if (!f.first.empty()) ResolveFunction(f.first, cost.functionCycles, visiting);
+
+	// global initializers run once per invocation as well
+	cost.estimatedCycles = selfCycles[""];
+	auto main = cost.functionCycles.find("main(");
+	if (main != cost.functionCycles.end()) cost.estimatedCycles += main->second;
+	return cost;
+}
+
+#pragma endregion
@@ -0,0 +1,80 @@
+#pragma once
+#include <glslang/Include/intermediate.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace Spirver {
+
+/// Cycle weights and branch probabilities used by the static cost estimate
+struct CostModel
+{
+	std::vector<float> opWeights; // cycles per glslang operator, 791 entries
+	float defaultWeight = 1.0f; // cycles of operators past the end of opWeights
+	float loopOverhead = 1.0f; // cycles per loop iteration (test + back edge)
+	float branchOverhead = 1.0f; // cycles per if or switch
+	float ifProbability = 0.5f; // probability of taking the true arm of an if
+	std::vector<float> switchProbabilities; // probability of each switch arm in order, uniform if empty
+	unsigned int defaultTripCount = 8; // iterations assumed when the bounds are not constant
+	unsigned int maxTripCount = 4096; // clamp for trip counts derived from constants
+
+	CostModel();
+
+	/// Load a table of "EOpName cycles" or "setting value" lines, '#' starts a comment.
+	/// Unknown names and malformed lines are reported to the errors of the thread and fail the load.
+	bool LoadFromFile(const std::string& path);
+	bool LoadFromMemory(const std::string& table);
+};
+
+/// Estimated cycles of a single shader invocation
+struct ShaderCost
+{
+	double estimatedCycles = 0.0; // main() including everything it calls
+	std::map<std::string, double> functionCycles; // inclusive cost of one call, by mangled name
+
+	bool operator<(const ShaderCost& o) const { return estimatedCycles < o.estimatedCycles; }
+};
+
+}
+
+std::ostream& operator<<(std::ostream& os, const Spirver::ShaderCost& c);
+
+namespace Spirver::detail
+{
+
+/// Walks the AST once, weighting every operation with the trip counts and
+/// branch probabilities of the control flow around it
+class SpirverCostTraverser : public glslang::TIntermTraverser
+{
+public:
+	SpirverCostTraverser(const CostModel& model) : model(model) {}
+
+	bool visitBinary(glslang::TVisit, glslang::TIntermBinary* node) override;
+	bool visitUnary(glslang::TVisit, glslang::TIntermUnary* node) override;
+	bool visitSelection(glslang::TVisit, glslang::TIntermSelection* node) override;
+	bool visitAggregate(glslang::TVisit, glslang::TIntermAggregate* node) override;
+	bool visitLoop(glslang::TVisit, glslang::TIntermLoop* node) override;
+	bool visitBranch(glslang::TVisit, glslang::TIntermBranch* node) override;
+	bool visitSwitch(glslang::TVisit, glslang::TIntermSwitch* node) override;
+
+	/// Resolve calls and get the result of the analysis
+	ShaderCost GetShaderCost();
+
+	/// Iterations of a loop, or 0 if its bounds are not constant
+	unsigned int DeriveTripCount(glslang::TIntermLoop* node);
+
+private:
+	const CostModel& model;
+	double multiplier = 1.0; // how many times the current node runs per invocation
+	std::string currentFunction;
+	std::map<std::string, double> selfCycles; // per function, excluding calls
+	std::map<std::string, std::map<std::string, double>> calls; // caller -> callee -> times called
+	std::map<long long, double> constantInits; // symbol id -> last constant assigned to it
+
+	void AddCost(glslang::TOperator op);
+	double ResolveFunction(const std::string& name, std::map<std::string, double>& resolved, std::set<std::string>& visiting);
+};
+
+}
@@ -0,0 +1,539 @@
+#include <SpirverDaemon.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+using namespace Spirver::proc;
+
+static bool readAll(int fd, void* data, size_t size)
+{
+	char* p = (char*)data;
+	while (size > 0)
+	{
+		ssize_t n = recv(fd, p, size, 0);
+		if (n <= 0) return false;
+		p += n;
+		size -= (size_t)n;
+	}
+	return true;
+}
+
+static bool writeAll(int fd, const void* data, size_t size)
+{
+	const char* p = (const char*)data;
+	while (size > 0)
+	{
+		ssize_t n = send(fd, p, size, MSG_NOSIGNAL); // a client that went away must not kill the daemon
+		if (n <= 0) return false;
+		p += n;
+		size -= (size_t)n;
+	}
+	return true;
+}
+
+static bool writeMessage(int fd, uint32_t code, uint32_t stage, const void* data, size_t size)
+{
+	DaemonMessage header = { (uint32_t)size, code, stage, 0 };
+	return writeAll(fd, &header, sizeof(header)) && writeAll(fd, data, size);
+}
+
+static bool readMessage(int fd, DaemonMessage& header, std::vector<char>& payload)
+{
+	if (!readAll(fd, &header, sizeof(header)) || header.size > maxDaemonPayload) return false;
+	payload.resize(header.size);
+	return readAll(fd, payload.data(), payload.size());
+}
+
+// the daemon cannot see the client's files, and cached results would not notice them change
+static bool hasInclude(const std::string& glsl)
+{
+	std::istringstream s(glsl);
+	for (std::string line; std::getline(s, line); )
+	{
+		size_t i = line.find_first_not_of(" \t");
+		if (i == std::string::npos || line[i] != '#') continue;
+		i = line.find_first_not_of(" \t", i + 1);
+		if (i != std::string::npos && line.compare(i, 7, "include") == 0) return true;
+	}
+	return false;
+}
+
+static bool socketAddress(const std::string& path, sockaddr_un& address)
+{
+	if (path.size() >= sizeof(address.sun_path)) return false;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+	return true;
+}
+
+// only processes of the user running the daemon may submit work or shut it down
+static bool sameUser(int fd)
+{
+#ifdef __linux__
+	ucred credentials;
+	socklen_t size = sizeof(credentials);
+	return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0 && credentials.uid == geteuid();
+#else
+	uid_t uid;
+	gid_t gid;
+	return getpeereid(fd, &uid, &gid) == 0 && uid == geteuid();
+#endif
+}
+
+std::string Spirver::DefaultDaemonSocket()
+{
+	const char* runtimeDir = std::getenv("XDG_RUNTIME_DIR");
+	if (runtimeDir != nullptr && runtimeDir[0] != '\0') return std::string(runtimeDir) + "/spirverd.sock";
+	return "/tmp/spirverd-" + std::to_string(geteuid()) + ".sock";
+}
+
+static bool setNonBlocking(int fd, bool nonBlocking)
+{
+	int flags = fcntl(fd, F_GETFL);
+	return flags >= 0 && fcntl(fd, F_SETFL, nonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK) == 0;
+}
+
+// a client that stalls in the middle of a message gives up its worker instead of holding it
+static bool setTimeouts(int fd)
+{
+	timeval timeout = { daemonIoTimeout, 0 };
+	return setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0
+		&& setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0;
+}
+
+#pragma region DaemonClient
+
+bool DaemonClient::Connect(const std::string& socketPath)
+{
+	Disconnect();
+
+	sockaddr_un address;
+	if (!socketAddress(socketPath, address))
+	{
+		errors << "Daemon error: socket path too long " << socketPath << std::endl;
+		return false;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (const sockaddr*)&address, sizeof(address)) != 0)
+	{
+		errors << "Daemon error: cannot connect to " << socketPath << std::endl;
+		Disconnect();
+		return false;
+	}
+	return true;
+}
+
+void DaemonClient::Disconnect()
+{
+	if (fd >= 0) close(fd);
+	fd = -1;
+}
+
+bool DaemonClient::Request(DaemonCommand command, Stage stage, const void* data, size_t size, std::vector<char>& response)
+{
+	if (!IsConnected())
+	{
+		errors << "Daemon error: not connected" << std::endl;
+		return false;
+	}
+	if (size > maxDaemonPayload)
+	{
+		errors << "Daemon error: request too large" << std::endl;
+		return false;
+	}
+
+	DaemonMessage header;
+	if (!writeMessage(fd, (uint32_t)command, (uint32_t)StageToInt(stage), data, size) || !readMessage(fd, header, response))
+	{
+		errors << "Daemon error: connection lost" << std::endl;
+		Disconnect();
+		return false;
+	}
+	if ((DaemonStatus)header.code != DaemonStatus::Ok)
+	{
+		errors << std::string(response.begin(), response.end());
+		return false;
+	}
+	return true;
+}
+
+bool DaemonClient::Compile(const std::string& glsl, Stage stage, std::vector<GLuint>& spirv, bool optimize)
+{
+	std::vector<char> response;
+	if (!Request(optimize ? DaemonCommand::CompileOptimized : DaemonCommand::Compile, stage, glsl.data(), glsl.size(), response)) return false;
+	spirv.resize(response.size() / sizeof(GLuint));
+	std::memcpy(spirv.data(), response.data(), spirv.size() * sizeof(GLuint));
+	return true;
+}
+
+bool DaemonClient::Optimize(std::vector<GLuint>& spirv, Stage stage)
+{
+	std::vector<char> response;
+	if (!Request(DaemonCommand::Optimize, stage, spirv.data(), spirv.size() * sizeof(GLuint), response)) return false;
+	spirv.resize(response.size() / sizeof(GLuint));
+	std::memcpy(spirv.data(), response.data(), spirv.size() * sizeof(GLuint));
+	return true;
+}
+
+bool DaemonClient::Analyze(const std::string& glsl, Stage stage, ShaderStat& stat)
+{
+	std::vector<char> response;
+	if (!Request(DaemonCommand::Analyze, stage, glsl.data(), glsl.size(), response)) return false;
+	if (response.size() != (shaderStatTypesCount + 791) * sizeof(unsigned int))
+	{
+		errors << "Daemon error: malformed ShaderStat" << std::endl;
+		return false;
+	}
+	std::memcpy(stat.stats, response.data(), shaderStatTypesCount * sizeof(unsigned int));
+	std::memcpy(stat.opCounts, response.data() + shaderStatTypesCount * sizeof(unsigned int), 791 * sizeof(unsigned int));
+	return true;
+}
+
+bool DaemonClient::Shutdown()
+{
+	std::vector<char> response;
+	return Request(DaemonCommand::Shutdown, Stage::Vertex, nullptr, 0, response);
+}
+
+std::string DaemonClient::GetErrors()
+{
+	std::string ret = errors.str();
+	errors = std::stringstream();
+	return ret;
+}
+
+#pragma endregion
+
+#pragma region ShaderDaemon
+
+bool ShaderDaemon::Run(const std::string& socketPath)
+{
+	sockaddr_un address;
+	if (!socketAddress(socketPath, address))
+	{
+		errors << "Daemon error: socket path too long " << socketPath << std::endl;
+		return false;
+	}
+
+	// only a socket left over by a daemon that did not exit cleanly is removed
+	struct stat st;
+	if (lstat(socketPath.c_str(), &st) == 0)
+	{
+		if (!S_ISSOCK(st.st_mode))
+		{
+			errors << "Daemon error: " << socketPath << " exists and is not a socket" << std::endl;
+			return false;
+		}
+		int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		bool answered = probe >= 0 && connect(probe, (const sockaddr*)&address, sizeof(address)) == 0;
+		if (probe >= 0) close(probe);
+		if (answered)
+		{
+			errors << "Daemon error: another daemon is listening on " << socketPath << std::endl;
+			return false;
+		}
+		unlink(socketPath.c_str());
+	}
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0 || bind(listenFd, (const sockaddr*)&address, sizeof(address)) != 0 || chmod(socketPath.c_str(), 0600) != 0
+		|| listen(listenFd, SOMAXCONN) != 0 || !setNonBlocking(listenFd, true) || pipe(wakeFds) != 0
+		|| !setNonBlocking(wakeFds[0], true) || !setNonBlocking(wakeFds[1], true))
+	{
+		errors << "Daemon error: cannot listen on " << socketPath << std::endl;
+		if (listenFd >= 0) close(listenFd);
+		listenFd = -1;
+		CloseWakePipe();
+		return false;
+	}
+
+	// pay for initialization once, not per request
+	Init();
+
+	running = true;
+	unsigned int count = threadCount != 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int i = 0; i < count; i++) workers.emplace_back(&ShaderDaemon::Work, this);
+
+	// idle connections are watched here, a worker only holds a connection for one request
+	std::vector<pollfd> fds;
+	while (running)
+	{
+		fds.assign({ { listenFd, POLLIN, 0 }, { wakeFds[0], POLLIN, 0 } });
+		{
+			std::lock_guard<std::mutex> lock(connectionMutex);
+			for (int fd : idle) fds.push_back({ fd, POLLIN, 0 });
+		}
+
+		if (poll(fds.data(), (nfds_t)fds.size(), -1) < 0)
+		{
+			if (errno == EINTR) continue;
+			break;
+		}
+		if (fds[1].revents != 0)
+		{
+			char buffer[64];
+			while (read(wakeFds[0], buffer, sizeof(buffer)) > 0) {}
+		}
+		if (!running || (fds[0].revents & (POLLERR | POLLNVAL)) != 0) break;
+
+		size_t ready = 0;
+		{
+			std::lock_guard<std::mutex> lock(connectionMutex);
+			// a closed connection is readable as well, its worker finds out and closes it
+			for (size_t i = 2; i < fds.size(); i++)
+			{
+				if (fds[i].revents == 0) continue;
+				idle.erase(fds[i].fd);
+				pending.push_back(fds[i].fd);
+				ready++;
+			}
+
+			if ((fds[0].revents & POLLIN) != 0)
+				for (int fd; (fd = accept(listenFd, nullptr, nullptr)) >= 0; )
+				{
+					if (!sameUser(fd) || !setNonBlocking(fd, false) || !setTimeouts(fd))
+					{
+						close(fd);
+						continue;
+					}
+					idle.insert(fd);
+				}
+		}
+		if (ready == 1) connectionReady.notify_one();
+		else if (ready > 1) connectionReady.notify_all();
+	}
+	running = false;
+
+	{
+		std::lock_guard<std::mutex> lock(connectionMutex);
+		for (int fd : connections) shutdown(fd, SHUT_RDWR);
+		for (int fd : pending) close(fd);
+		for (int fd : idle) close(fd);
+		pending.clear();
+		idle.clear();
+	}
+	connectionReady.notify_all();
+	JoinWorkers();
+
+	close(listenFd);
+	listenFd = -1;
+	CloseWakePipe();
+	unlink(socketPath.c_str());
+	return true;
+}
+
+void ShaderDaemon::Stop()
+{
+	running = false;
+	Wake();
+}
+
+void ShaderDaemon::Wake()
+{
+	// only async signal safe calls, Stop() is called from signal handlers
+	if (wakeFds[1] < 0) return;
+	char c = 0;
+	ssize_t written = write(wakeFds[1], &c, 1); // a full pipe already wakes the poll
+	(void)written;
+}
+
+void ShaderDaemon::CloseWakePipe()
+{
+	for (int& fd : wakeFds)
+	{
+		if (fd >= 0) close(fd);
+		fd = -1;
+	}
+}
+
+ShaderDaemon::~ShaderDaemon()
+{
+	Stop();
+	JoinWorkers();
+}
+
+void ShaderDaemon::JoinWorkers()
+{
+	// the optimizers of a worker are freed with its thread
+	for (std::thread& worker : workers)
+		if (worker.joinable()) worker.join();
+	workers.clear();
+}
+
+void ShaderDaemon::Work()
+{
+	while (true)
+	{
+		int fd;
+		{
+			std::unique_lock<std::mutex> lock(connectionMutex);
+			connectionReady.wait(lock, [this] { return !pending.empty() || !running; });
+			if (!running) return;
+			fd = pending.front();
+			pending.pop_front();
+			connections.insert(fd);
+		}
+
+		bool keep = Serve(fd);
+
+		{
+			std::lock_guard<std::mutex> lock(connectionMutex);
+			connections.erase(fd);
+			if (keep && running) idle.insert(fd);
+			else
+			{
+				close(fd);
+				keep = false;
+			}
+		}
+		if (keep) Wake(); // the poll has to watch it again
+	}
+}
+
+bool ShaderDaemon::Serve(int fd)
+{
+	DaemonMessage header;
+	std::vector<char> payload;
+	if (!readMessage(fd, header, payload)) return false;
+
+	DaemonCommand command = (DaemonCommand)header.code;
+	if (command == DaemonCommand::Shutdown)
+	{
+		writeMessage(fd, (uint32_t)DaemonStatus::Ok, header.stage, nullptr, 0);
+		Stop();
+		return false;
+	}
+
+	// identical requests from different build steps are answered from the cache
+	std::vector<char> request(sizeof(header.code) + sizeof(header.stage) + payload.size());
+	std::memcpy(request.data(), &header.code, sizeof(header.code));
+	std::memcpy(request.data() + sizeof(header.code), &header.stage, sizeof(header.stage));
+	if (!payload.empty()) std::memcpy(request.data() + sizeof(header.code) + sizeof(header.stage), payload.data(), payload.size());
+	uint64_t hash = hashBytes(request.data(), request.size());
+
+	Result result;
+	if (FindCached(hash, request, result)) cacheHits++;
+	else
+	{
+		cacheMisses++;
+		Spirver::proc::GetErrors(); // left over by an earlier request on this thread
+		result = Execute(command, StageToSpirver((int)header.stage), payload);
+		Spirver::proc::GetErrors();
+		if (result.status == DaemonStatus::Ok) AddCached(hash, std::move(request), result);
+	}
+
+	return writeMessage(fd, (uint32_t)result.status, header.stage, result.payload.data(), result.payload.size());
+}
+
+ShaderDaemon::Result ShaderDaemon::Execute(DaemonCommand command, Stage stage, const std::vector<char>& payload)
+{
+	Result result = { DaemonStatus::Ok, {} };
+	auto setSpirv = [&](SpirvShader& shader)
+	{
+		const std::vector<GLuint>& spirv = shader.GetSpirv();
+		result.payload.assign((const char*)spirv.data(), (const char*)(spirv.data() + spirv.size()));
+	};
+	auto setError = [&](const std::string& message)
+	{
+		result.status = DaemonStatus::Error;
+		result.payload.assign(message.begin(), message.end());
+	};
+
+	bool isGlsl = command == DaemonCommand::Compile || command == DaemonCommand::CompileOptimized || command == DaemonCommand::Analyze;
+	if (isGlsl && hasInclude(std::string(payload.begin(), payload.end())))
+	{
+		setError("Daemon error: #include is not supported, send preprocessed source\n");
+		return result;
+	}
+
+	switch (command)
+	{
+	case DaemonCommand::Compile:
+	case DaemonCommand::CompileOptimized:
+	{
+		SpirvShader shader = GlslShader::FromMemory(std::string(payload.begin(), payload.end()), stage).ToSpirv();
+		if (!shader.HasErrors() && command == DaemonCommand::CompileOptimized) shader.Optimize();
+		if (shader.HasErrors()) setError(shader.GetErrors());
+		else setSpirv(shader);
+		break;
+	}
+	case DaemonCommand::Optimize:
+	{
+		std::vector<GLuint> spirv(payload.size() / sizeof(GLuint));
+		std::memcpy(spirv.data(), payload.data(), spirv.size() * sizeof(GLuint));
+		SpirvShader shader = SpirvShader::FromMemory(spirv, stage);
+		if (!shader.Optimize()) setError(shader.GetErrors());
+		else setSpirv(shader);
+		break;
+	}
+	case DaemonCommand::Analyze:
+	{
+		GlslShader shader = GlslShader::FromMemory(std::string(payload.begin(), payload.end()), stage);
+		ShaderStat stat = shader.Analyze();
+		if (shader.HasErrors())
+		{
+			setError(shader.GetErrors());
+			break;
+		}
+		result.payload.resize((shaderStatTypesCount + 791) * sizeof(unsigned int));
+		std::memcpy(result.payload.data(), stat.stats, shaderStatTypesCount * sizeof(unsigned int));
+		std::memcpy(result.payload.data() + shaderStatTypesCount * sizeof(unsigned int), stat.opCounts, 791 * sizeof(unsigned int));
+		break;
+	}
+	default:
+		setError("Daemon error: unknown command " + std::to_string((uint32_t)command) + "\n");
+		break;
+	}
+	return result;
+}
+
+bool ShaderDaemon::FindCached(uint64_t hash, const std::vector<char>& request, Result& result)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	auto it = cacheIndex.find(hash);
+	if (it == cacheIndex.end() || it->second->request != request) return false; // a colliding hash is a miss
+	cache.splice(cache.begin(), cache, it->second);
+	result = it->second->result;
+	return true;
+}
+
+void ShaderDaemon::AddCached(uint64_t hash, std::vector<char>&& request, const Result& result)
+{
+	size_t bytes = request.size() + result.payload.size();
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	if (cacheIndex.count(hash) != 0 || bytes > cacheBytes) return;
+
+	cache.push_front({ hash, std::move(request), result });
+	cacheIndex[hash] = cache.begin();
+	cachedBytes += bytes;
+
+	// least recently used results go first
+	while (cachedBytes > cacheBytes)
+	{
+		cachedBytes -= cache.back().request.size() + cache.back().result.payload.size();
+		cacheIndex.erase(cache.back().hash);
+		cache.pop_back();
+	}
+}
+
+std::string ShaderDaemon::GetErrors()
+{
+	std::string ret = errors.str();
+	errors = std::stringstream();
+	return ret;
+}
+
+#pragma endregion
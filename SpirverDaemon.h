@@ -0,0 +1,137 @@
+#pragma once
+#include <Spirver.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+/// Compile server that keeps initialized engines and a result cache alive between build steps, POSIX only
+namespace Spirver {
+
+#pragma region Protocol
+
+// Every message is a DaemonMessage header followed by size bytes of payload, over a Unix socket.
+// Requests carry GLSL source or SPIR-V words, responses carry SPIR-V words, ShaderStat counters or an error string.
+
+enum class DaemonCommand : uint32_t { Compile = 0, CompileOptimized = 1, Optimize = 2, Analyze = 3, Shutdown = 4 };
+enum class DaemonStatus : uint32_t { Ok = 0, Error = 1 };
+
+struct DaemonMessage
+{
+	uint32_t size; // payload bytes
+	uint32_t code; // DaemonCommand in requests, DaemonStatus in responses
+	uint32_t stage; // StageToInt
+	uint32_t reserved;
+};
+
+/// $XDG_RUNTIME_DIR/spirverd.sock, /tmp/spirverd-<uid>.sock when it is not set
+std::string DefaultDaemonSocket();
+inline const uint32_t maxDaemonPayload = 64 << 20;
+/// Seconds the daemon waits for the rest of a started message or for a client to take its response
+inline const int daemonIoTimeout = 30;
+
+#pragma endregion
+
+#pragma region DaemonClient
+
+/// Connection to spirverd, requests are answered in order
+class DaemonClient
+{
+public:
+	DaemonClient() {}
+	DaemonClient(const DaemonClient&) = delete;
+	DaemonClient& operator=(const DaemonClient&) = delete;
+	~DaemonClient() { Disconnect(); }
+
+	bool Connect(const std::string& socketPath = DefaultDaemonSocket());
+	void Disconnect();
+	bool IsConnected() const { return fd >= 0; }
+
+	bool Compile(const std::string& glsl, Stage stage, std::vector<GLuint>& spirv, bool optimize = true);
+	bool Optimize(std::vector<GLuint>& spirv, Stage stage);
+	bool Analyze(const std::string& glsl, Stage stage, ShaderStat& stat);
+	/// Ask the daemon to exit once its connections are closed
+	bool Shutdown();
+
+	std::string GetErrors();
+
+private:
+	int fd = -1;
+	std::stringstream errors;
+
+	bool Request(DaemonCommand command, Stage stage, const void* data, size_t size, std::vector<char>& response);
+};
+
+#pragma endregion
+
+#pragma region ShaderDaemon
+
+/// Server side of spirverd, a poll loop hands every ready request to one of a fixed set of worker threads
+class ShaderDaemon
+{
+public:
+	/// cacheBytes limits the requests and results kept in the cache, threadCount 0 uses one worker per core
+	ShaderDaemon(size_t cacheBytes = 256 << 20, unsigned int threadCount = 0) : cacheBytes(cacheBytes), threadCount(threadCount) {}
+	ShaderDaemon(const ShaderDaemon&) = delete;
+	ShaderDaemon& operator=(const ShaderDaemon&) = delete;
+	~ShaderDaemon();
+
+	/// Listen on the socket and serve requests until Stop() or a Shutdown request.
+	/// The socket is only accessible to the user running the daemon, other peers are refused.
+	bool Run(const std::string& socketPath = DefaultDaemonSocket());
+	void Stop();
+
+	size_t GetCacheHits() const { return cacheHits; }
+	size_t GetCacheMisses() const { return cacheMisses; }
+	std::string GetErrors();
+
+private:
+	struct Result
+	{
+		DaemonStatus status;
+		std::vector<char> payload;
+	};
+
+	struct CacheEntry
+	{
+		uint64_t hash;
+		std::vector<char> request; // command, stage and payload, compared on a hit
+		Result result;
+	};
+
+	size_t cacheBytes;
+	size_t cachedBytes = 0;
+	std::list<CacheEntry> cache; // most recently used first
+	std::unordered_map<uint64_t, std::list<CacheEntry>::iterator> cacheIndex;
+	std::mutex cacheMutex;
+	std::atomic<size_t> cacheHits{ 0 }, cacheMisses{ 0 };
+
+	unsigned int threadCount;
+	int listenFd = -1;
+	std::atomic<bool> running{ false };
+	std::vector<std::thread> workers;
+	int wakeFds[2] = { -1, -1 }; // pipe that interrupts the poll
+	std::set<int> idle; // waiting for a request, watched by the poll
+	std::deque<int> pending; // a request arrived, waiting for a worker
+	std::set<int> connections; // being served
+	std::mutex connectionMutex;
+	std::condition_variable connectionReady;
+	std::stringstream errors;
+
+	void Work();
+	/// Answer one request, false when the connection is done
+	bool Serve(int fd);
+	void Wake();
+	void CloseWakePipe();
+	void JoinWorkers();
+	Result Execute(DaemonCommand command, Stage stage, const std::vector<char>& payload);
+	bool FindCached(uint64_t hash, const std::vector<char>& request, Result& result);
+	void AddCached(uint64_t hash, std::vector<char>&& request, const Result& result);
+};
+
+#pragma endregion
+
+}
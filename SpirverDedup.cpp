@@ -0,0 +1,76 @@
+#include <SpirverDedup.h>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+using namespace Spirver::proc;
+
+// the hash only narrows the search, shaders are folded when these words are equal.
+// The remapper numbers unnamed declarations in order, so shaders that differ in declaration order stay apart.
+static bool canonicalWords(const std::vector<GLuint>& spirv, std::vector<uint32_t>& words)
+{
+	spvtools::Optimizer strip(SPV_ENV_OPENGL_4_5);
+	strip.SetMessageConsumer(printSpirvOptLog);
+	strip.RegisterPass(spvtools::CreateStripDebugInfoPass());
+	words.assign(spirv.begin(), spirv.end());
+	return strip.Run(words.data(), words.size(), &words) && remapSpirv(words);
+}
+
+size_t ShaderDeduplicator::Add(const std::string& name, SpirvShader& shader, bool optimize)
+{
+	if (byName.count(name) != 0)
+	{
+		errors << "Deduplication error: duplicate name " << name << std::endl;
+		return npos;
+	}
+	if (shader.HasErrors() || (optimize && !shader.Optimize()))
+	{
+		errors << "Deduplication error: " << name << " failed to optimize" << std::endl;
+		return npos;
+	}
+
+	uint64_t hash = shader.CanonicalHash();
+	if (hash == 0)
+	{
+		errors << "Deduplication error: " << name << " is not valid SPIR-V" << std::endl;
+		return npos;
+	}
+
+	// same code in different stages is not interchangeable
+	int stage = StageToInt(shader.GetStage());
+	uint64_t key = hashBytes(&stage, sizeof(stage), hash);
+
+	std::vector<uint32_t> words;
+	if (!canonicalWords(shader.GetSpirv(), words))
+	{
+		errors << "Deduplication error: " << name << " could not be canonicalized" << std::endl << Spirver::proc::GetErrors();
+		return npos;
+	}
+
+	size_t index = npos;
+	auto range = byHash.equal_range(key);
+	for (auto it = range.first; it != range.second && index == npos; ++it)
+		if (canonical[it->second].words == words) index = it->second;
+	if (index == npos)
+	{
+		index = canonical.size();
+		canonical.push_back(Entry{ SpirvShader::FromMemory(shader.GetSpirv(), shader.GetStage()), hash, std::move(words), {} });
+		byHash.emplace(key, index);
+	}
+
+	canonical[index].names.push_back(name);
+	byName[name] = index;
+	return index;
+}
+
+size_t ShaderDeduplicator::Find(const std::string& name) const
+{
+	auto it = byName.find(name);
+	return it != byName.end() ? it->second : npos;
+}
+
+std::string ShaderDeduplicator::GetErrors()
+{
+	std::string ret = errors.str();
+	errors = std::stringstream();
+	return ret;
+}
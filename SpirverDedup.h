@@ -0,0 +1,45 @@
+#pragma once
+#include <Spirver.h>
+#include <unordered_map>
+
+namespace Spirver {
+
+/// Maps many shaders to one canonical binary per group of equivalent shaders.
+/// Shaders are equivalent when they differ only in id numbering and debug info,
+/// ones that also differ in declaration order hash the same but are kept apart.
+class ShaderDeduplicator
+{
+public:
+	static const size_t npos = (size_t)-1;
+
+	/// Optimize the shader if requested and return the index of its canonical shader, npos on failure.
+	/// The first shader of a group becomes the canonical one.
+	size_t Add(const std::string& name, SpirvShader& shader, bool optimize = true);
+	/// Canonical index of a previously added name, npos if unknown
+	size_t Find(const std::string& name) const;
+
+	SpirvShader& GetCanonical(size_t index) { return canonical[index].shader; }
+	uint64_t GetHash(size_t index) const { return canonical[index].hash; }
+	/// Names of the shaders that share the canonical shader
+	const std::vector<std::string>& GetNames(size_t index) const { return canonical[index].names; }
+
+	size_t UniqueCount() const { return canonical.size(); }
+	size_t InputCount() const { return byName.size(); }
+
+	std::string GetErrors();
+
+private:
+	struct Entry
+	{
+		SpirvShader shader;
+		uint64_t hash;
+		std::vector<uint32_t> words; // debug info stripped, ids remapped
+		std::vector<std::string> names;
+	};
+	std::vector<Entry> canonical;
+	std::unordered_multimap<uint64_t, size_t> byHash; // canonical hash mixed with the stage
+	std::unordered_map<std::string, size_t> byName;
+	std::stringstream errors;
+};
+
+}
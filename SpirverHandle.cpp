@@ -0,0 +1,238 @@
+#include <SpirverHandle.h>
+#include <unordered_map>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+
+#pragma region Store
+
+namespace {
+
+/// Interned entries by hash, an entry stays until its last handle is released
+struct ShaderStore
+{
+	std::mutex mutex;
+	std::unordered_multimap<uint64_t, InternedShader*> entries;
+	size_t bytes = 0;
+};
+
+ShaderStore& getStore()
+{
+	static ShaderStore store;
+	return store;
+}
+
+}
+
+static size_t entryBytes(const InternedShader& e)
+{
+	return e.code.size() + e.spirv.size() * sizeof(GLuint);
+}
+
+static bool sameContents(const InternedShader& a, const InternedShader& b)
+{
+	return a.stage == b.stage && a.isSpirv == b.isSpirv && a.code == b.code && a.spirv == b.spirv;
+}
+
+// a count that reached 0 is never raised again, its entry is about to be deleted
+static bool tryAddReference(InternedShader& e)
+{
+	uint32_t references = e.references.load();
+	while (references != 0)
+		if (e.references.compare_exchange_weak(references, references + 1)) return true;
+	return false;
+}
+
+ShaderHandle ShaderHandle::Intern(std::unique_ptr<InternedShader> candidate)
+{
+	int stage = StageToInt(candidate->stage);
+	uint64_t hash = hashBytes(&stage, sizeof(stage));
+	hash = candidate->isSpirv ? hashBytes(candidate->spirv.data(), candidate->spirv.size() * sizeof(GLuint), hash) : hashBytes(candidate->code.data(), candidate->code.size(), hash);
+	candidate->hash = hash;
+
+	// failures keep their errors to themselves
+	if (candidate->errors != nullptr) return ShaderHandle(candidate.release());
+
+	ShaderStore& store = getStore();
+	std::lock_guard<std::mutex> lock(store.mutex);
+	auto range = store.entries.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+		if (sameContents(*it->second, *candidate) && tryAddReference(*it->second)) return ShaderHandle(it->second);
+
+	candidate->interned = true;
+	store.bytes += entryBytes(*candidate);
+	store.entries.emplace(hash, candidate.get());
+	return ShaderHandle(candidate.release());
+}
+
+void ShaderHandle::Release()
+{
+	if (entry == nullptr) return;
+	InternedShader* e = entry;
+	entry = nullptr;
+	if (e->references.fetch_sub(1) != 1) return;
+
+	if (e->interned)
+	{
+		ShaderStore& store = getStore();
+		std::lock_guard<std::mutex> lock(store.mutex);
+		auto range = store.entries.equal_range(e->hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second != e) continue;
+			store.entries.erase(it);
+			store.bytes -= entryBytes(*e);
+			break;
+		}
+	}
+	delete e;
+}
+
+size_t ShaderHandle::GetStoreCount()
+{
+	ShaderStore& store = getStore();
+	std::lock_guard<std::mutex> lock(store.mutex);
+	return store.entries.size();
+}
+
+size_t ShaderHandle::GetStoreBytes()
+{
+	ShaderStore& store = getStore();
+	std::lock_guard<std::mutex> lock(store.mutex);
+	return store.bytes;
+}
+
+#pragma endregion
+
+#pragma region ShaderHandle
+
+ShaderHandle::ShaderHandle(const ShaderHandle& o) : entry(o.entry)
+{
+	if (entry != nullptr) entry->references++;
+}
+
+ShaderHandle& ShaderHandle::operator=(const ShaderHandle& o)
+{
+	if (o.entry != nullptr) o.entry->references++;
+	Release();
+	entry = o.entry;
+	return *this;
+}
+
+ShaderHandle& ShaderHandle::operator=(ShaderHandle&& o) noexcept
+{
+	if (this == &o) return *this;
+	Release();
+	entry = o.entry;
+	o.entry = nullptr;
+	return *this;
+}
+
+ShaderHandle ShaderHandle::FromGlsl(const std::string& code, Stage stage)
+{
+	std::unique_ptr<InternedShader> e = std::make_unique<InternedShader>();
+	e->stage = stage;
+	e->code = code;
+	return Intern(std::move(e));
+}
+
+ShaderHandle ShaderHandle::FromSpirv(const std::vector<GLuint>& spirv, Stage stage)
+{
+	std::unique_ptr<InternedShader> e = std::make_unique<InternedShader>();
+	e->stage = stage;
+	e->isSpirv = true;
+	e->spirv = spirv;
+	return Intern(std::move(e));
+}
+
+ShaderHandle ShaderHandle::FromFile(const std::string& path, Stage stage)
+{
+	if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".spv") == 0)
+	{
+		SpirvShader shader = SpirvShader::FromFile(path, stage);
+		return FromShader(shader);
+	}
+	GlslShader shader = GlslShader::FromFile(path, stage);
+	return FromShader(shader);
+}
+
+ShaderHandle ShaderHandle::FromResult(ShaderCode& shader, std::string&& code, std::vector<GLuint>&& spirv, bool isSpirv)
+{
+	std::unique_ptr<InternedShader> e = std::make_unique<InternedShader>();
+	e->stage = shader.GetStage();
+	e->isSpirv = isSpirv;
+	e->code = std::move(code);
+	e->spirv = std::move(spirv);
+	if (shader.HasErrors()) e->errors = std::make_unique<std::string>(shader.GetErrors());
+	return Intern(std::move(e));
+}
+
+ShaderHandle ShaderHandle::FromShader(GlslShader& shader)
+{
+	return FromResult(shader, std::string(shader.GetCode()), std::vector<GLuint>(), false);
+}
+
+ShaderHandle ShaderHandle::FromShader(SpirvShader& shader)
+{
+	return FromResult(shader, std::string(), std::vector<GLuint>(shader.GetSpirv()), true);
+}
+
+const std::string& ShaderHandle::GetCode() const
+{
+	static const std::string empty;
+	return entry != nullptr ? entry->code : empty;
+}
+
+const std::vector<GLuint>& ShaderHandle::GetSpirv() const
+{
+	static const std::vector<GLuint> empty;
+	return entry != nullptr ? entry->spirv : empty;
+}
+
+const std::string& ShaderHandle::GetErrors() const
+{
+	static const std::string empty;
+	return HasErrors() ? *entry->errors : empty;
+}
+
+GlslShader ShaderHandle::ToGlslShader() const
+{
+	return GlslShader::FromMemory(GetCode(), GetStage());
+}
+
+SpirvShader ShaderHandle::ToSpirvShader() const
+{
+	return SpirvShader::FromMemory(GetSpirv(), GetStage());
+}
+
+ShaderHandle ShaderHandle::ToSpirv() const
+{
+	if (entry == nullptr || entry->isSpirv) return *this;
+	GlslShader glsl = ToGlslShader();
+	SpirvShader spirv = glsl.ToSpirv();
+	return FromShader(spirv);
+}
+
+ShaderHandle ShaderHandle::ToGlsl() const
+{
+	if (entry == nullptr || !entry->isSpirv) return *this;
+	SpirvShader spirv = ToSpirvShader();
+	GlslShader glsl = spirv.ToGlsl();
+	return FromShader(glsl);
+}
+
+ShaderHandle ShaderHandle::Optimize() const
+{
+	if (entry == nullptr) return *this;
+	if (entry->isSpirv)
+	{
+		SpirvShader spirv = ToSpirvShader();
+		spirv.Optimize();
+		return FromShader(spirv);
+	}
+	GlslShader glsl = ToGlslShader();
+	glsl.Optimize();
+	return FromShader(glsl);
+}
+
+#pragma endregion
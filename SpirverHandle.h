@@ -0,0 +1,84 @@
+#pragma once
+#include <Spirver.h>
+#include <atomic>
+#include <memory>
+
+namespace Spirver::detail {
+
+/// Immutable GLSL or SPIR-V of a ShaderHandle, equal sources share one while they are referenced
+struct InternedShader
+{
+	std::atomic<uint32_t> references{ 1 };
+	Stage stage = Stage::Vertex;
+	bool isSpirv = false;
+	bool interned = false; // in the store, entries with errors never are
+	uint64_t hash = 0; // of the stage and the contents
+	std::string code;
+	std::vector<GLuint> spirv;
+	std::unique_ptr<std::string> errors; // only allocated on failure
+};
+
+}
+
+namespace Spirver {
+
+/// Pointer sized reference to an immutable shader, copies only touch a reference count.
+/// Equal code of the same stage is stored once while any handle refers to it.
+/// Conversions build a GlslShader or SpirvShader for the duration of the call and intern the result.
+class ShaderHandle
+{
+public:
+	ShaderHandle() {}
+	ShaderHandle(const ShaderHandle& o);
+	ShaderHandle(ShaderHandle&& o) noexcept : entry(o.entry) { o.entry = nullptr; }
+	ShaderHandle& operator=(const ShaderHandle& o);
+	ShaderHandle& operator=(ShaderHandle&& o) noexcept;
+	~ShaderHandle() { Release(); }
+
+	static ShaderHandle FromGlsl(const std::string& code, Stage stage);
+	static ShaderHandle FromSpirv(const std::vector<GLuint>& spirv, Stage stage);
+	/// GLSL file, or SPIR-V if the extension is .spv
+	static ShaderHandle FromFile(const std::string& path, Stage stage);
+	/// Errors of the shader carry over, include directories do not
+	static ShaderHandle FromShader(GlslShader& shader);
+	static ShaderHandle FromShader(SpirvShader& shader);
+
+	bool IsValid() const { return entry != nullptr; }
+	bool IsSpirv() const { return entry != nullptr && entry->isSpirv; }
+	Stage GetStage() const { return entry != nullptr ? entry->stage : Stage::Vertex; }
+	/// Empty for SPIR-V
+	const std::string& GetCode() const;
+	/// Empty for GLSL
+	const std::vector<GLuint>& GetSpirv() const;
+	uint64_t GetHash() const { return entry != nullptr ? entry->hash : 0; }
+
+	bool HasErrors() const { return entry != nullptr && entry->errors != nullptr; }
+	const std::string& GetErrors() const;
+
+	/// New handles, the same one if nothing changed
+	ShaderHandle ToSpirv() const;
+	ShaderHandle ToGlsl() const;
+	ShaderHandle Optimize() const;
+
+	/// Full shader objects for everything else
+	GlslShader ToGlslShader() const;
+	SpirvShader ToSpirvShader() const;
+
+	/// Interned entries make equal contents the same pointer
+	bool operator==(const ShaderHandle& o) const { return entry == o.entry; }
+	bool operator!=(const ShaderHandle& o) const { return entry != o.entry; }
+
+	/// Distinct entries alive and the bytes of code and SPIR-V they hold
+	static size_t GetStoreCount();
+	static size_t GetStoreBytes();
+
+private:
+	detail::InternedShader* entry = nullptr;
+
+	explicit ShaderHandle(detail::InternedShader* entry) : entry(entry) {}
+	void Release();
+	static ShaderHandle Intern(std::unique_ptr<detail::InternedShader> candidate);
+	static ShaderHandle FromResult(ShaderCode& shader, std::string&& code, std::vector<GLuint>&& spirv, bool isSpirv);
+};
+
+}
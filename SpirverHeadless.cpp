@@ -0,0 +1,82 @@
+#include <SpirverHeadless.h>
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+using namespace Spirver;
+
+bool HeadlessContext::Create(int major, int minor)
+{
+	Destroy();
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay eglDisplay = getPlatformDisplay != nullptr ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) : EGL_NO_DISPLAY;
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, nullptr, nullptr))
+	{
+		errors += "Headless context error: no surfaceless EGL display\n";
+		return false;
+	}
+	display = eglDisplay;
+
+	const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount) || configCount == 0)
+	{
+		errors += "Headless context error: no OpenGL config\n";
+		Destroy();
+		return false;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, major,
+		EGL_CONTEXT_MINOR_VERSION, minor,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE };
+	context = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT)
+	{
+		context = nullptr;
+		errors += "Headless context error: cannot create an OpenGL " + std::to_string(major) + "." + std::to_string(minor) + " context\n";
+		Destroy();
+		return false;
+	}
+
+	if (!MakeCurrent())
+	{
+		Destroy();
+		return false;
+	}
+
+	glewExperimental = GL_TRUE;
+	GLenum glewError = glewInit();
+	if (glewError != GLEW_OK)
+	{
+		errors += std::string("Headless context error: ") + (const char*)glewGetErrorString(glewError) + "\n";
+		Destroy();
+		return false;
+	}
+	return true;
+}
+
+bool HeadlessContext::MakeCurrent()
+{
+	// surfaceless, EGL_KHR_surfaceless_context is part of the Mesa platform
+	if (!eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext)context))
+	{
+		errors += "Headless context error: cannot make the context current\n";
+		return false;
+	}
+	return true;
+}
+
+void HeadlessContext::Destroy()
+{
+	if (display == nullptr) return;
+
+	eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (context != nullptr) eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+	eglTerminate((EGLDisplay)display);
+	context = nullptr;
+	display = nullptr;
+}
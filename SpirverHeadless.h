@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+
+namespace Spirver {
+
+/// OpenGL 4.6 core context without a window through EGL_MESA_platform_surfaceless, for example on llvmpipe.
+/// Needs GLEW built with EGL support. Built when SPIRVER_HEADLESS_EGL is enabled.
+class HeadlessContext
+{
+public:
+	HeadlessContext() {}
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+	~HeadlessContext() { Destroy(); }
+
+	/// Create the context, make it current on this thread and initialize GLEW
+	bool Create(int major = 4, int minor = 6);
+	void Destroy();
+	/// Make the context current on the calling thread
+	bool MakeCurrent();
+	bool IsValid() const { return context != nullptr; }
+
+	std::string GetErrors() const { return errors; }
+
+private:
+	void* display = nullptr;
+	void* context = nullptr;
+	std::string errors;
+};
+
+}
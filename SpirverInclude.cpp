@@ -0,0 +1,360 @@
+#include <SpirverInclude.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace Spirver;
+using namespace Spirver::detail;
+using namespace Spirver::proc;
+
+namespace fs = std::filesystem;
+
+IncludeCache Spirver::detail::includeCache;
+
+int64_t Spirver::detail::fileStamp(const std::string& path)
+{
+	std::error_code ec;
+	fs::file_time_type time = fs::last_write_time(path, ec);
+	return ec ? -1 : (int64_t)time.time_since_epoch().count();
+}
+
+// one spelling per file, so the cache and the graph do not see it twice
+static std::string normalPath(const fs::path& path)
+{
+	return path.lexically_normal().generic_string();
+}
+
+#pragma region IncludeCache
+
+std::shared_ptr<const std::string> IncludeCache::Load(const std::string& path)
+{
+	int64_t stamp = fileStamp(path);
+	std::lock_guard<std::mutex> lock(mutex);
+	if (stamp < 0)
+	{
+		entries.erase(path);
+		return nullptr;
+	}
+
+	auto it = entries.find(path);
+	if (it != entries.end() && it->second.stamp == stamp) return it->second.content;
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return nullptr;
+	std::stringstream content;
+	content << file.rdbuf();
+
+	Entry& entry = entries[path];
+	entry.content = std::make_shared<const std::string>(content.str());
+	entry.stamp = stamp;
+	return entry.content;
+}
+
+void IncludeCache::Invalidate(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.erase(path);
+}
+
+void IncludeCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.clear();
+}
+
+#pragma endregion
+
+#pragma region FileIncluder
+
+Spirver::FileIncluder::FileIncluder(const std::string& sourcePath, const std::vector<std::string>& includeDirectories)
+	: FileIncluder(sourcePath, includeDirectories, includeCache)
+{
+}
+
+Spirver::FileIncluder::FileIncluder(const std::string& sourcePath, const std::vector<std::string>& includeDirectories, IncludeCache& cache)
+	: sourcePath(sourcePath), includeDirectories(includeDirectories), cache(cache)
+{
+}
+
+glslang::TShader::Includer::IncludeResult* Spirver::FileIncluder::includeLocal(const char* headerName, const char* includerName, size_t inclusionDepth)
+{
+	// the shader itself has no name in glslang, nested includes are named by their resolved path
+	std::string includer = includerName != nullptr && *includerName != '\0' ? includerName : sourcePath;
+	fs::path directory = includer.empty() ? fs::path(".") : fs::path(includer).parent_path();
+
+	IncludeResult* result = Open(normalPath(directory / headerName));
+	return result != nullptr ? result : includeSystem(headerName, includerName, inclusionDepth);
+}
+
+glslang::TShader::Includer::IncludeResult* Spirver::FileIncluder::includeSystem(const char* headerName, const char*, size_t)
+{
+	for (const std::string& directory : includeDirectories)
+	{
+		IncludeResult* result = Open(normalPath(fs::path(directory) / headerName));
+		if (result != nullptr) return result;
+	}
+	return nullptr; // glslang reports the missing file
+}
+
+void Spirver::FileIncluder::releaseInclude(IncludeResult* result)
+{
+	if (result == nullptr) return;
+	delete (std::shared_ptr<const std::string>*)result->userData;
+	delete result;
+}
+
+glslang::TShader::Includer::IncludeResult* Spirver::FileIncluder::Open(const std::string& path)
+{
+	std::shared_ptr<const std::string> content = cache.Load(path);
+	if (content == nullptr) return nullptr;
+
+	includes.insert(path);
+	// userData keeps the content alive even if the cache reloads the file meanwhile
+	return new IncludeResult(path, content->data(), content->size(), new std::shared_ptr<const std::string>(content));
+}
+
+#pragma endregion
+
+#pragma region DependencyGraph
+
+void DependencyGraph::SetBuilt(const std::string& shader, int64_t stamp, const std::map<std::string, int64_t>& includes, bool success)
+{
+	Remove(shader);
+
+	Node& node = shaders[shader];
+	node.stamp = success ? stamp : -1;
+	node.includes = includes;
+	for (const auto& include : includes) dependents[include.first].insert(shader);
+}
+
+void DependencyGraph::Remove(const std::string& shader)
+{
+	auto it = shaders.find(shader);
+	if (it == shaders.end()) return;
+
+	for (const auto& include : it->second.includes)
+	{
+		auto d = dependents.find(include.first);
+		if (d == dependents.end()) continue;
+		d->second.erase(shader);
+		if (d->second.empty()) dependents.erase(d);
+	}
+	shaders.erase(it);
+}
+
+std::set<std::string> DependencyGraph::GetDependencies(const std::string& shader) const
+{
+	std::set<std::string> ret;
+	auto it = shaders.find(shader);
+	if (it == shaders.end()) return ret;
+
+	ret.insert(shader);
+	for (const auto& include : it->second.includes) ret.insert(include.first);
+	return ret;
+}
+
+std::set<std::string> DependencyGraph::GetDependents(const std::string& file) const
+{
+	auto it = dependents.find(file);
+	return it != dependents.end() ? it->second : std::set<std::string>();
+}
+
+bool DependencyGraph::IsDirty(const std::string& shader) const
+{
+	auto it = shaders.find(shader);
+	if (it == shaders.end() || it->second.stamp < 0 || fileStamp(shader) != it->second.stamp) return true;
+
+	// includes are recorded transitively, so one level is enough
+	for (const auto& include : it->second.includes)
+		if (fileStamp(include.first) != include.second) return true;
+	return false;
+}
+
+std::vector<std::string> DependencyGraph::GetShaders() const
+{
+	std::vector<std::string> ret;
+	for (const auto& shader : shaders) ret.push_back(shader.first);
+	return ret;
+}
+
+// shader <stamp> <path>, followed by its include <stamp> <path> lines
+bool DependencyGraph::Save(const std::string& path) const
+{
+	std::stringstream s;
+	for (const auto& shader : shaders)
+	{
+		s << "shader " << shader.second.stamp << " " << shader.first << "\n";
+		for (const auto& include : shader.second.includes)
+			s << "include " << include.second << " " << include.first << "\n";
+	}
+	return stringToFile(s.str(), path);
+}
+
+bool DependencyGraph::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) return false;
+
+	shaders.clear();
+	dependents.clear();
+	std::string current;
+	for (std::string line; std::getline(file, line); )
+	{
+		std::istringstream s(line);
+		std::string kind, name;
+		int64_t stamp;
+		if (!(s >> kind >> stamp)) continue;
+		std::getline(s >> std::ws, name);
+		if (name.empty()) continue;
+
+		if (kind == "shader")
+		{
+			current = name;
+			shaders[current].stamp = stamp;
+		}
+		else if (kind == "include" && !current.empty())
+		{
+			shaders[current].includes[name] = stamp;
+			dependents[name].insert(current);
+		}
+	}
+	return true;
+}
+
+#pragma endregion
+
+#pragma region IncrementalBuilder
+
+IncrementalBuilder::IncrementalBuilder(const std::string& graphPath, const std::vector<std::string>& includeDirectories)
+	: graphPath(graphPath), includeDirectories(includeDirectories)
+{
+	if (!graphPath.empty()) graph.Load(graphPath); // a missing graph rebuilds everything
+}
+
+IncrementalBuilder::~IncrementalBuilder()
+{
+#ifdef __linux__
+	if (watchFd >= 0) close(watchFd);
+#endif
+}
+
+void IncrementalBuilder::AddShader(const std::string& path)
+{
+	tracked.insert(normalPath(path));
+}
+
+void IncrementalBuilder::RemoveShader(const std::string& path)
+{
+	tracked.erase(normalPath(path));
+	graph.Remove(normalPath(path));
+}
+
+size_t IncrementalBuilder::Build(const BuildCallback& callback)
+{
+	size_t failures = 0;
+	for (const std::string& path : tracked)
+	{
+		if (!graph.IsDirty(path)) continue;
+
+		// stamped before compiling, an edit made meanwhile must not count as built
+		int64_t stamp = fileStamp(path);
+		includeCache.Invalidate(path);
+		GlslShader glsl = GlslShader::FromFile(path, StageToSpirver(fs::path(path).extension().string()));
+		glsl.SetIncludeDirectories(includeDirectories);
+		std::map<std::string, int64_t> includes;
+		for (const std::string& include : glsl.GetIncludes()) includes[include] = fileStamp(include);
+		SpirvShader spirv = glsl.ToSpirv();
+
+		bool success = !spirv.HasErrors();
+		if (!success)
+		{
+			failures++;
+			errors << path << ":" << std::endl << glsl.GetErrors();
+		}
+		graph.SetBuilt(path, stamp, includes, success);
+		callback(path, spirv);
+	}
+
+	if (!graphPath.empty() && !graph.Save(graphPath)) errors << "Incremental build error: cannot write " << graphPath << std::endl;
+	UpdateWatches();
+	return failures;
+}
+
+bool IncrementalBuilder::Watch()
+{
+#ifdef __linux__
+	if (watchFd < 0) watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watchFd < 0)
+	{
+		errors << "Incremental build error: inotify is not available" << std::endl;
+		return false;
+	}
+	UpdateWatches();
+	return true;
+#else
+	errors << "Incremental build error: watching files is only supported on Linux" << std::endl;
+	return false;
+#endif
+}
+
+void IncrementalBuilder::UpdateWatches()
+{
+#ifdef __linux__
+	if (watchFd < 0) return;
+
+	// directories, not files, since editors often save by replacing the file
+	std::set<std::string> directories;
+	for (const std::string& shader : tracked)
+	{
+		directories.insert(normalPath(fs::path(shader).parent_path()));
+		for (const std::string& file : graph.GetDependencies(shader)) directories.insert(normalPath(fs::path(file).parent_path()));
+	}
+
+	for (const auto& watch : watches) directories.erase(watch.second);
+	for (const std::string& directory : directories)
+	{
+		int wd = inotify_add_watch(watchFd, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+		if (wd >= 0) watches[wd] = directory;
+	}
+#endif
+}
+
+size_t IncrementalBuilder::WaitAndBuild(int timeoutMs, const BuildCallback& callback)
+{
+#ifdef __linux__
+	if (watchFd >= 0)
+	{
+		pollfd p = { watchFd, POLLIN, 0 };
+		if (poll(&p, 1, timeoutMs) <= 0) return 0;
+
+		alignas(inotify_event) char buffer[4096];
+		for (ssize_t n; (n = read(watchFd, buffer, sizeof(buffer))) > 0; )
+		{
+			for (char* e = buffer; e < buffer + n; e += sizeof(inotify_event) + ((inotify_event*)e)->len)
+			{
+				inotify_event* event = (inotify_event*)e;
+				auto watch = watches.find(event->wd);
+				if (watch != watches.end() && event->len > 0) includeCache.Invalidate(normalPath(fs::path(watch->second) / event->name));
+			}
+		}
+		return Build(callback);
+	}
+#endif
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+	return Build(callback);
+}
+
+std::string IncrementalBuilder::GetErrors()
+{
+	std::string ret = errors.str();
+	errors = std::stringstream();
+	return ret;
+}
+
+#pragma endregion
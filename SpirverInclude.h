@@ -0,0 +1,146 @@
+#pragma once
+#include <Spirver.h>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+namespace Spirver {
+
+#pragma region IncludeCache
+
+/// Contents of included files shared by every includer, reloaded when a file changes on disk
+class IncludeCache
+{
+public:
+	/// nullptr if the file cannot be read
+	std::shared_ptr<const std::string> Load(const std::string& path);
+	void Invalidate(const std::string& path);
+	void Clear();
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<const std::string> content;
+		int64_t stamp;
+	};
+	std::unordered_map<std::string, Entry> entries;
+	std::mutex mutex;
+};
+
+#pragma endregion
+
+#pragma region FileIncluder
+
+/// Resolves #include "file" relative to the including file, then like #include <file> in the include directories
+class FileIncluder : public glslang::TShader::Includer
+{
+public:
+	FileIncluder(const std::string& sourcePath, const std::vector<std::string>& includeDirectories);
+	FileIncluder(const std::string& sourcePath, const std::vector<std::string>& includeDirectories, IncludeCache& cache);
+
+	IncludeResult* includeLocal(const char* headerName, const char* includerName, size_t inclusionDepth) override;
+	IncludeResult* includeSystem(const char* headerName, const char* includerName, size_t inclusionDepth) override;
+	void releaseInclude(IncludeResult* result) override;
+
+	/// Every file resolved so far
+	const std::set<std::string>& GetIncludes() const { return includes; }
+
+private:
+	std::string sourcePath;
+	std::vector<std::string> includeDirectories;
+	IncludeCache& cache;
+	std::set<std::string> includes;
+
+	IncludeResult* Open(const std::string& path);
+};
+
+#pragma endregion
+
+#pragma region DependencyGraph
+
+/// Files every shader was built from and their modification times, saved between runs
+class DependencyGraph
+{
+public:
+	/// Record a build of the shader, a failed build stays dirty.
+	/// The stamps are the ones taken before compiling, so an edit during the build leaves the shader dirty.
+	void SetBuilt(const std::string& shader, int64_t stamp, const std::map<std::string, int64_t>& includes, bool success);
+	void Remove(const std::string& shader);
+
+	/// Shader source and includes of the last build
+	std::set<std::string> GetDependencies(const std::string& shader) const;
+	/// Shaders that include the file
+	std::set<std::string> GetDependents(const std::string& file) const;
+	/// True if the shader was never built or one of its inputs changed since
+	bool IsDirty(const std::string& shader) const;
+	std::vector<std::string> GetShaders() const;
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+private:
+	struct Node
+	{
+		int64_t stamp = -1; // of the shader source, -1 after a failed build
+		std::map<std::string, int64_t> includes;
+	};
+	std::map<std::string, Node> shaders;
+	std::map<std::string, std::set<std::string>> dependents;
+};
+
+#pragma endregion
+
+#pragma region IncrementalBuilder
+
+/// Recompiles only the shaders whose source or includes changed, optionally on file change notifications
+class IncrementalBuilder
+{
+public:
+	/// Receives every shader compiled by Build(), shader has errors if compilation failed
+	using BuildCallback = std::function<void(const std::string& path, SpirvShader& shader)>;
+
+	/// graphPath stores the dependency graph between runs, empty keeps it in memory only
+	IncrementalBuilder(const std::string& graphPath, const std::vector<std::string>& includeDirectories = {});
+	~IncrementalBuilder();
+	IncrementalBuilder(const IncrementalBuilder&) = delete;
+	IncrementalBuilder& operator=(const IncrementalBuilder&) = delete;
+
+	/// Track a shader, the stage comes from the extension
+	void AddShader(const std::string& path);
+	void RemoveShader(const std::string& path);
+
+	/// Compile the dirty shaders and save the graph, returns the number of failures
+	size_t Build(const BuildCallback& callback);
+
+	/// Start watching the directories of every input, Linux only
+	bool Watch();
+	/// Wait up to timeoutMs for a change, then Build(). Polls modification times if not watching.
+	size_t WaitAndBuild(int timeoutMs, const BuildCallback& callback);
+
+	const DependencyGraph& GetGraph() const { return graph; }
+	std::string GetErrors();
+
+private:
+	std::string graphPath;
+	std::vector<std::string> includeDirectories;
+	std::set<std::string> tracked;
+	DependencyGraph graph;
+	std::stringstream errors;
+	int watchFd = -1;
+	std::map<int, std::string> watches; // watch descriptor -> directory
+
+	void UpdateWatches();
+};
+
+#pragma endregion
+
+}
+
+namespace Spirver::detail {
+
+/// Shared by the includers of GlslShader
+extern IncludeCache includeCache;
+/// Modification time, -1 if the file does not exist
+int64_t fileStamp(const std::string& path);
+
+}
@@ -0,0 +1,338 @@
+#include <SpirverInstrument.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+
+std::ostream& operator<<(std::ostream& os, const HotnessReport& r)
+{
+	os << "invocations: " << r.invocations << std::endl;
+	os << "blockExecutions: " << r.blockExecutions << std::endl;
+	for (const BlockHotness& b : r.blocks)
+	{
+		os << "  " << b.count << " (" << b.share * 100.0 << "%) " << b.site.functionName << " %" << b.site.block;
+		if (b.site.line > 0) os << " " << b.site.file << ":" << b.site.line;
+		os << std::endl;
+	}
+	return os;
+}
+
+#pragma region InstrumentationMap
+
+// low word, then the high word
+static uint64_t counterValue(const std::vector<uint32_t>& counters, size_t i)
+{
+	return 2 * i + 1 < counters.size() ? counters[2 * i] | (uint64_t)counters[2 * i + 1] << 32 : 0;
+}
+
+ExecutionProfile InstrumentationMap::Decode(const std::vector<uint32_t>& counters) const
+{
+	ExecutionProfile p;
+	p.moduleHash = moduleHash;
+	p.invocations = counterValue(counters, entryCounter);
+
+	std::map<uint32_t, std::set<uint32_t>> predecessors;
+	for (size_t i = 0; i < sites.size(); i++)
+	{
+		const CounterSite& site = sites[i];
+		uint64_t count = counterValue(counters, i);
+		p.blockCounts[site.block] += count;
+		p.instructions += count * site.instructions;
+		for (const auto& op : site.opcodes) p.opcodeCounts[op.first] += count * op.second;
+		for (uint32_t s : site.successors) predecessors[s].insert(site.block);
+	}
+
+	// an edge is known if it is the only way out of its source or the only way into its target,
+	// a single unknown edge out of a block gets what is left of the block count
+	for (const CounterSite& site : sites)
+	{
+		std::set<uint32_t> successors(site.successors.begin(), site.successors.end());
+		uint64_t count = p.blockCounts[site.block], known = 0;
+		std::vector<uint32_t> unknown;
+		for (uint32_t s : successors)
+		{
+			if (successors.size() == 1) p.edgeCounts[{ site.block, s }] = count;
+			else if (predecessors[s].size() == 1)
+			{
+				p.edgeCounts[{ site.block, s }] = p.blockCounts[s];
+				known += p.blockCounts[s];
+			}
+			else unknown.push_back(s);
+		}
+		if (successors.size() > 1 && unknown.size() == 1) p.edgeCounts[{ site.block, unknown[0] }] = count > known ? count - known : 0;
+	}
+	return p;
+}
+
+HotnessReport InstrumentationMap::Report(const ExecutionProfile& profile) const
+{
+	HotnessReport r;
+	r.invocations = profile.invocations;
+	for (const CounterSite& site : sites)
+	{
+		BlockHotness b;
+		b.site = site;
+		auto it = profile.blockCounts.find(site.block);
+		b.count = it != profile.blockCounts.end() ? it->second : 0;
+		r.blockExecutions += b.count;
+		r.blocks.push_back(std::move(b));
+	}
+	for (BlockHotness& b : r.blocks)
+		b.share = r.blockExecutions > 0 ? (double)b.count / r.blockExecutions : 0.0;
+	std::stable_sort(r.blocks.begin(), r.blocks.end(), [](const BlockHotness& a, const BlockHotness& b) { return a.count > b.count; });
+	return r;
+}
+
+bool InstrumentationMap::Save(const std::string& path) const
+{
+	std::stringstream s;
+	s << "map " << moduleHash << " " << binding << " " << entryCounter << "\n";
+	for (const CounterSite& site : sites)
+	{
+		s << "site " << site.function << " " << site.block << " " << site.line << " " << site.instructions << " " << std::quoted(site.functionName) << " " << site.file << "\n"; // names may be empty or stripped
+		s << "ops";
+		for (const auto& op : site.opcodes) s << " " << op.first << " " << op.second;
+		s << "\nsuccessors";
+		for (uint32_t successor : site.successors) s << " " << successor;
+		s << "\n";
+	}
+	return proc::stringToFile(s.str(), path);
+}
+
+bool InstrumentationMap::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) return false;
+
+	*this = InstrumentationMap();
+	bool header = false;
+	bool valid = true;
+	for (std::string line; valid && std::getline(file, line); )
+	{
+		std::istringstream s(line);
+		std::string kind;
+		if (!(s >> kind)) continue;
+
+		if (kind == "map")
+		{
+			valid = !header && (bool)(s >> moduleHash >> binding >> entryCounter) && (s >> std::ws).eof();
+			header = true;
+		}
+		else if (kind == "site" && header)
+		{
+			CounterSite site;
+			valid = (bool)(s >> site.function >> site.block >> site.line >> site.instructions >> std::quoted(site.functionName));
+			std::getline(s >> std::ws, site.file);
+			sites.push_back(std::move(site));
+		}
+		else if (kind == "ops" && !sites.empty())
+		{
+			uint32_t op, count;
+			while (valid && s >> op)
+			{
+				valid = (bool)(s >> count);
+				sites.back().opcodes[op] = count;
+			}
+			valid = valid && s.eof();
+		}
+		else if (kind == "successors" && !sites.empty())
+		{
+			for (uint32_t successor; s >> successor; ) sites.back().successors.push_back(successor);
+			valid = s.eof();
+		}
+		else valid = false;
+	}
+
+	// counters are indexed by site, a partial map would attribute them to the wrong blocks
+	if (!valid || !header)
+	{
+		*this = InstrumentationMap();
+		return false;
+	}
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Instrumentation
+
+bool Spirver::detail::InstrumentBlocks(SpirvModule& module, uint32_t binding, InstrumentationMap& map)
+{
+	map = InstrumentationMap();
+	std::vector<uint32_t> original = module.Serialize();
+	map.moduleHash = hashBytes(original.data(), original.size() * sizeof(uint32_t));
+	map.binding = binding;
+
+	// SPIR-V for OpenGL is usually 1.0, which has storage buffers as BufferBlock in the Uniform class
+	bool storageBufferClass = module.header[1] >= 0x10300;
+	bool fullInterface = module.header[1] >= 0x10400; // entry points list every global they use
+	spv::StorageClass storageClass = storageBufferClass ? spv::StorageClassStorageBuffer : spv::StorageClassUniform;
+
+	uint32_t uintType = 0, boolType = 0, entryFunction = 0;
+	size_t firstDeclaration = SIZE_MAX, firstFunction = module.instructions.size();
+	std::unordered_map<uint32_t, std::string> strings;
+	for (size_t i = 0; i < module.instructions.size(); i++)
+	{
+		const SpirvInstruction& inst = module.instructions[i];
+		if (inst.opcode == spv::OpString) strings[inst.resultId] = inst.GetString(1);
+		else if (inst.opcode == spv::OpEntryPoint && entryFunction == 0) entryFunction = inst.words[2];
+		else if (inst.opcode == spv::OpTypeInt && inst.words[2] == 32 && inst.words[3] == 0 && uintType == 0) uintType = inst.resultId;
+		else if (inst.opcode == spv::OpTypeBool && boolType == 0) boolType = inst.resultId;
+		else if (inst.opcode == spv::OpFunction) firstFunction = std::min(firstFunction, i);
+		if (IsDeclaration(inst.opcode)) firstDeclaration = std::min(firstDeclaration, i);
+	}
+	if (firstDeclaration == SIZE_MAX) firstDeclaration = firstFunction;
+
+	// one counter per block, inserted after the phis and the variables of the block
+	std::unordered_map<size_t, uint32_t> counterAt; // instruction index -> counter
+	for (const SpirvFunction& f : module.functions)
+	{
+		std::string file;
+		int line = 0;
+		for (const SpirvBlock& b : f.blocks)
+		{
+			CounterSite site;
+			site.function = f.resultId;
+			site.block = b.labelId;
+			site.functionName = module.GetName(f.resultId);
+			site.file = file;
+			site.line = line;
+			site.successors = b.successors;
+
+			bool hasLine = false;
+			size_t insert = b.end - 1;
+			for (size_t i = b.begin + 1; i < b.end; i++)
+			{
+				const SpirvInstruction& inst = module.instructions[i];
+				switch (inst.opcode)
+				{
+				case spv::OpLine:
+					file = strings[inst.words[1]];
+					line = (int)inst.words[2];
+					if (!hasLine)
+					{
+						site.file = file;
+						site.line = line;
+						hasLine = true;
+					}
+					break;
+				case spv::OpNoLine:
+				case spv::OpSelectionMerge:
+				case spv::OpLoopMerge:
+					break;
+				default:
+					site.instructions++;
+					site.opcodes[inst.opcode]++;
+					break;
+				}
+				if (insert == b.end - 1 && inst.opcode != spv::OpPhi && inst.opcode != spv::OpVariable
+					&& inst.opcode != spv::OpLine && inst.opcode != spv::OpNoLine) insert = i;
+			}
+
+			if (f.resultId == entryFunction && &b == &f.blocks[0]) map.entryCounter = (uint32_t)map.sites.size();
+			counterAt[insert] = (uint32_t)map.sites.size();
+			map.sites.push_back(std::move(site));
+		}
+	}
+	if (map.sites.empty())
+	{
+		errors << "Instrumentation error: the shader has no blocks" << std::endl;
+		return false;
+	}
+
+	bool newUint = uintType == 0;
+	if (newUint) uintType = module.NewId();
+	bool newBool = boolType == 0;
+	if (newBool) boolType = module.NewId();
+	uint32_t runtimeArray = module.NewId(), block = module.NewId(), blockPointer = module.NewId(), uintPointer = module.NewId();
+	uint32_t variable = module.NewId();
+
+	std::map<uint32_t, uint32_t> constants; // value -> id
+	auto constant = [&](uint32_t value)
+	{
+		uint32_t& id = constants[value];
+		if (id == 0) id = module.NewId();
+		return id;
+	};
+	uint32_t scope = constant(spv::ScopeDevice), semantics = constant(spv::MemorySemanticsMaskNone), one = constant(1), zero = constant(0);
+	uint32_t maxWord = constant(0xFFFFFFFF);
+	std::vector<uint32_t> indices; // low and high word of every counter
+	for (uint32_t i = 0; i < 2 * map.sites.size(); i++) indices.push_back(constant(i));
+
+	std::vector<SpirvInstruction> instrumented;
+	instrumented.reserve(module.instructions.size() + map.sites.size() * 6 + constants.size() + 16);
+	for (size_t i = 0; i < module.instructions.size(); i++)
+	{
+		if (i == firstDeclaration)
+		{
+			instrumented.push_back(MakeInstruction(spv::OpDecorate, 0, 0, { runtimeArray, spv::DecorationArrayStride, 4 }));
+			instrumented.push_back(MakeInstruction(spv::OpDecorate, 0, 0, { block, storageBufferClass ? spv::DecorationBlock : spv::DecorationBufferBlock }));
+			instrumented.push_back(MakeInstruction(spv::OpMemberDecorate, 0, 0, { block, 0, spv::DecorationOffset, 0 }));
+			instrumented.push_back(MakeInstruction(spv::OpDecorate, 0, 0, { variable, spv::DecorationDescriptorSet, 0 }));
+			instrumented.push_back(MakeInstruction(spv::OpDecorate, 0, 0, { variable, spv::DecorationBinding, binding }));
+		}
+		if (i == firstFunction)
+		{
+			if (newUint) instrumented.push_back(MakeInstruction(spv::OpTypeInt, 0, uintType, { 32, 0 }));
+			if (newBool) instrumented.push_back(MakeInstruction(spv::OpTypeBool, 0, boolType, {}));
+			instrumented.push_back(MakeInstruction(spv::OpTypeRuntimeArray, 0, runtimeArray, { uintType }));
+			instrumented.push_back(MakeInstruction(spv::OpTypeStruct, 0, block, { runtimeArray }));
+			instrumented.push_back(MakeInstruction(spv::OpTypePointer, 0, blockPointer, { (uint32_t)storageClass, block }));
+			instrumented.push_back(MakeInstruction(spv::OpTypePointer, 0, uintPointer, { (uint32_t)storageClass, uintType }));
+			for (const auto& c : constants) instrumented.push_back(MakeInstruction(spv::OpConstant, uintType, c.second, { c.first }));
+			instrumented.push_back(MakeInstruction(spv::OpVariable, blockPointer, variable, { (uint32_t)storageClass }));
+		}
+
+		auto counter = counterAt.find(i);
+		if (counter != counterAt.end())
+		{
+			// 32 bit counters wrap within minutes of a full screen fragment shader, the increment that
+			// wraps the low word carries into the high word, without a branch that would split the block
+			uint32_t low = module.NewId(), previous = module.NewId(), wrapped = module.NewId(), carry = module.NewId();
+			uint32_t high = module.NewId(), previousHigh = module.NewId();
+			uint32_t index = 2 * counter->second;
+			instrumented.push_back(MakeInstruction(spv::OpAccessChain, uintPointer, low, { variable, zero, indices[index] }));
+			instrumented.push_back(MakeInstruction(spv::OpAtomicIAdd, uintType, previous, { low, scope, semantics, one }));
+			instrumented.push_back(MakeInstruction(spv::OpIEqual, boolType, wrapped, { previous, maxWord }));
+			instrumented.push_back(MakeInstruction(spv::OpSelect, uintType, carry, { wrapped, one, zero }));
+			instrumented.push_back(MakeInstruction(spv::OpAccessChain, uintPointer, high, { variable, zero, indices[index + 1] }));
+			instrumented.push_back(MakeInstruction(spv::OpAtomicIAdd, uintType, previousHigh, { high, scope, semantics, carry }));
+		}
+
+		instrumented.push_back(module.instructions[i]);
+		if (fullInterface && module.instructions[i].opcode == spv::OpEntryPoint)
+		{
+			SpirvInstruction& entry = instrumented.back();
+			entry.words.push_back(variable);
+			entry.words[0] = (uint32_t)entry.words.size() << 16 | spv::OpEntryPoint;
+		}
+	}
+
+	// parse again so operands and lookups cover the new instructions
+	module.instructions = std::move(instrumented);
+	std::vector<uint32_t> words = module.Serialize();
+	if (!module.Parse(words.data(), words.size()))
+	{
+		errors << "Instrumentation error: the instrumented module is invalid" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Spirver::proc::instrumentSpirv(const std::vector<GLuint>& spirv, std::vector<GLuint>& instrumented, InstrumentationMap& map, uint32_t binding)
+{
+	SpirvModule module;
+	if (!module.Parse((const uint32_t*)spirv.data(), spirv.size()))
+	{
+		errors << "SPIR-V parse error!" << std::endl;
+		return false;
+	}
+	if (!InstrumentBlocks(module, binding, map)) return false;
+	std::vector<uint32_t> words = module.Serialize();
+	instrumented.assign(words.begin(), words.end());
+	return true;
+}
+
+#pragma endregion
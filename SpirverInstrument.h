@@ -0,0 +1,74 @@
+#pragma once
+#include <SpirverInterpreter.h>
+
+namespace Spirver {
+
+/// Block a counter of an instrumented shader belongs to
+struct CounterSite
+{
+	uint32_t function = 0; // function id
+	uint32_t block = 0; // label id
+	std::string functionName;
+	std::string file; // from OpLine, empty without debug info
+	int line = 0;
+	uint32_t instructions = 0; // executed per pass, counted like ExecutionProfile::instructions
+	std::map<uint32_t, uint32_t> opcodes; // spv::Op -> count in the block
+	std::vector<uint32_t> successors; // label ids
+};
+
+/// How often one block ran
+struct BlockHotness
+{
+	CounterSite site;
+	uint64_t count = 0;
+	double share = 0.0; // of all block executions
+};
+
+/// Blocks of a shader, hottest first
+struct HotnessReport
+{
+	uint64_t invocations = 0;
+	uint64_t blockExecutions = 0;
+	std::vector<BlockHotness> blocks;
+};
+
+/// Counter layout of a shader instrumented by SpirvShader::Instrument()
+struct InstrumentationMap
+{
+	uint64_t moduleHash = 0; // of the shader before instrumentation, profiles refer to it
+	uint32_t binding = 0; // of the counter buffer
+	uint32_t entryCounter = 0; // counts invocations
+	std::vector<CounterSite> sites; // by counter index
+
+	/// Bytes of the buffer to bind, zeroed before drawing.
+	/// Every counter is 64 bit, a low and a high word the shader carries into, so it does not wrap on long captures.
+	size_t GetBufferSize() const { return sites.size() * 2 * sizeof(uint32_t); }
+
+	/// Profile of the original shader from a dump of the counter buffer, counter i in the words 2i (low) and 2i + 1 (high).
+	/// Edges are derived where the control flow graph determines them.
+	ExecutionProfile Decode(const std::vector<uint32_t>& counters) const;
+	HotnessReport Report(const ExecutionProfile& profile) const;
+	HotnessReport Report(const std::vector<uint32_t>& counters) const { return Report(Decode(counters)); }
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+};
+
+}
+
+std::ostream& operator<<(std::ostream& os, const Spirver::HotnessReport& r);
+
+namespace Spirver::proc {
+
+/// Copy of the SPIR-V with a counter per block in the storage buffer at binding, see InstrumentationMap
+bool instrumentSpirv(const std::vector<GLuint>& spirv, std::vector<GLuint>& instrumented, InstrumentationMap& map, uint32_t binding = 0);
+
+}
+
+namespace Spirver::detail
+{
+
+/// Add an atomic 64 bit increment of counter i, words 2i and 2i + 1 of a storage buffer, at the start of every block
+bool InstrumentBlocks(SpirvModule& module, uint32_t binding, InstrumentationMap& map);
+
+}
@@ -0,0 +1,1823 @@
+#include <SpirverInterpreter.h>
+#include <glslang/SPIRV/GLSL.std.450.h>
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+
+#pragma region ExecutionProfile
+
+void ExecutionProfile::Merge(const ExecutionProfile& o)
+{
+	invocations += o.invocations;
+	instructions += o.instructions;
+	killed += o.killed;
+	for (const auto& c : o.opcodeCounts) opcodeCounts[c.first] += c.second;
+	for (const auto& c : o.blockCounts) blockCounts[c.first] += c.second;
+	for (const auto& c : o.edgeCounts) edgeCounts[c.first] += c.second;
+}
+
+bool ExecutionProfile::Save(const std::string& path) const
+{
+	std::stringstream s;
+	s << "profile " << moduleHash << " " << invocations << " " << instructions << " " << killed << "\n";
+	for (const auto& c : opcodeCounts) s << "op " << c.first << " " << c.second << "\n";
+	for (const auto& c : blockCounts) s << "block " << c.first << " " << c.second << "\n";
+	for (const auto& c : edgeCounts) s << "edge " << c.first.first << " " << c.first.second << " " << c.second << "\n";
+	return proc::stringToFile(s.str(), path);
+}
+
+bool ExecutionProfile::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) return false;
+
+	*this = ExecutionProfile();
+	bool header = false;
+	for (std::string line; std::getline(file, line); )
+	{
+		std::istringstream s(line);
+		std::string kind;
+		uint32_t a = 0, b = 0;
+		uint64_t count = 0;
+		if (!(s >> kind)) continue;
+		if (kind == "profile") header = (bool)(s >> moduleHash >> invocations >> instructions >> killed);
+		else if (kind == "op" && s >> a >> count) opcodeCounts[a] = count;
+		else if (kind == "block" && s >> a >> count) blockCounts[a] = count;
+		else if (kind == "edge" && s >> a >> b >> count) edgeCounts[{ a, b }] = count;
+	}
+	return header;
+}
+
+std::ostream& operator<<(std::ostream& os, const ExecutionProfile& p)
+{
+	os << "invocations: " << p.invocations << std::endl;
+	os << "instructions: " << p.instructions << std::endl;
+	os << "instructionsPerInvocation: " << p.GetInstructionsPerInvocation() << std::endl;
+	os << "killed: " << p.killed << std::endl;
+	os << "opcodes:" << std::endl;
+	for (const auto& c : p.opcodeCounts)
+		os << "  Op" << c.first << ": " << c.second << std::endl;
+	os << "blocks:" << std::endl;
+	for (const auto& c : p.blockCounts)
+		os << "  %" << c.first << ": " << c.second << std::endl;
+	os << "edges:" << std::endl;
+	for (const auto& c : p.edgeCounts)
+		os << "  %" << c.first.first << " -> %" << c.first.second << ": " << c.second << std::endl;
+	return os;
+}
+
+#pragma endregion
+
+#pragma region Helpers
+
+static float toFloat(uint32_t w)
+{
+	float f;
+	std::memcpy(&f, &w, sizeof(f));
+	return f;
+}
+
+static uint32_t fromFloat(float f)
+{
+	uint32_t w;
+	std::memcpy(&w, &f, sizeof(w));
+	return w;
+}
+
+template<typename F>
+static void unaryOp(std::vector<uint32_t>& r, const std::vector<uint32_t>& a, F f)
+{
+	r.resize(a.size());
+	for (size_t i = 0; i < a.size(); i++) r[i] = f(a[i]);
+}
+
+// a scalar b is applied to every component of a
+template<typename F>
+static void binaryOp(std::vector<uint32_t>& r, const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, F f)
+{
+	r.resize(a.size());
+	for (size_t i = 0; i < a.size(); i++) r[i] = f(a[i], b.empty() ? 0 : b[i < b.size() ? i : 0]);
+}
+
+template<typename F>
+static void floatOp(std::vector<uint32_t>& r, const std::vector<uint32_t>& a, F f)
+{
+	unaryOp(r, a, [&](uint32_t x) { return fromFloat(f(toFloat(x))); });
+}
+
+template<typename F>
+static void floatOp(std::vector<uint32_t>& r, const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, F f)
+{
+	binaryOp(r, a, b, [&](uint32_t x, uint32_t y) { return fromFloat(f(toFloat(x), toFloat(y))); });
+}
+
+template<typename F>
+static void floatOp(std::vector<uint32_t>& r, const std::vector<uint32_t>& a, const std::vector<uint32_t>& b,
+	const std::vector<uint32_t>& c, F f)
+{
+	r.resize(a.size());
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		float y = b.empty() ? 0.0f : toFloat(b[i < b.size() ? i : 0]);
+		float z = c.empty() ? 0.0f : toFloat(c[i < c.size() ? i : 0]);
+		r[i] = fromFloat(f(toFloat(a[i]), y, z));
+	}
+}
+
+template<typename F>
+static void compareOp(std::vector<uint32_t>& r, const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, F f)
+{
+	binaryOp(r, a, b, [&](uint32_t x, uint32_t y) { return f(toFloat(x), toFloat(y)) ? 1u : 0u; });
+}
+
+static float dot(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+	float sum = 0.0f;
+	for (size_t i = 0; i < a.size() && i < b.size(); i++) sum += toFloat(a[i]) * toFloat(b[i]);
+	return sum;
+}
+
+static int32_t signedDivide(int32_t a, int32_t b)
+{
+	if (b == 0) return 0;
+	if (a == INT32_MIN && b == -1) return a;
+	return a / b;
+}
+
+static int32_t signedRemainder(int32_t a, int32_t b)
+{
+	if (b == 0 || b == -1) return 0;
+	return a % b;
+}
+
+// determinant and inverse are the same for a matrix and its transpose, so column major input is fine
+static double determinant(std::vector<double> a, size_t n)
+{
+	double det = 1.0;
+	for (size_t c = 0; c < n; c++)
+	{
+		size_t p = c;
+		for (size_t r = c + 1; r < n; r++)
+			if (std::fabs(a[r * n + c]) > std::fabs(a[p * n + c])) p = r;
+		if (a[p * n + c] == 0.0) return 0.0;
+		if (p != c)
+		{
+			for (size_t j = 0; j < n; j++) std::swap(a[p * n + j], a[c * n + j]);
+			det = -det;
+		}
+		det *= a[c * n + c];
+		for (size_t r = c + 1; r < n; r++)
+		{
+			double f = a[r * n + c] / a[c * n + c];
+			for (size_t j = c; j < n; j++) a[r * n + j] -= f * a[c * n + j];
+		}
+	}
+	return det;
+}
+
+static std::vector<double> inverse(std::vector<double> a, size_t n)
+{
+	std::vector<double> inv(n * n, 0.0);
+	for (size_t i = 0; i < n; i++) inv[i * n + i] = 1.0;
+	for (size_t c = 0; c < n; c++)
+	{
+		size_t p = c;
+		for (size_t r = c + 1; r < n; r++)
+			if (std::fabs(a[r * n + c]) > std::fabs(a[p * n + c])) p = r;
+		if (a[p * n + c] == 0.0) return std::vector<double>(n * n, 0.0); // singular
+		for (size_t j = 0; j < n; j++)
+		{
+			std::swap(a[p * n + j], a[c * n + j]);
+			std::swap(inv[p * n + j], inv[c * n + j]);
+		}
+		double d = a[c * n + c];
+		for (size_t j = 0; j < n; j++)
+		{
+			a[c * n + j] /= d;
+			inv[c * n + j] /= d;
+		}
+		for (size_t r = 0; r < n; r++)
+		{
+			if (r == c || a[r * n + c] == 0.0) continue;
+			double f = a[r * n + c];
+			for (size_t j = 0; j < n; j++)
+			{
+				a[r * n + j] -= f * a[c * n + j];
+				inv[r * n + j] -= f * inv[c * n + j];
+			}
+		}
+	}
+	return inv;
+}
+
+static uint32_t floatToHalf(float f)
+{
+	uint32_t x = fromFloat(f);
+	uint32_t sign = (x >> 16) & 0x8000, exponent = (x >> 23) & 0xFF, mantissa = x & 0x7FFFFF;
+	if (exponent == 0xFF) return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+	int e = (int)exponent - 112;
+	if (e >= 31) return sign | 0x7C00;
+	if (e <= 0) return e < -10 ? sign : sign | ((mantissa | 0x800000) >> (14 - e));
+	return sign | ((uint32_t)e << 10) | (mantissa >> 13);
+}
+
+static float halfToFloat(uint32_t h)
+{
+	uint32_t sign = (h & 0x8000) << 16, exponent = (h >> 10) & 0x1F, mantissa = h & 0x3FF;
+	if (exponent == 0) return (sign != 0 ? -1.0f : 1.0f) * std::ldexp((float)mantissa, -24);
+	if (exponent == 31) return toFloat(sign | 0x7F800000 | (mantissa << 13));
+	return toFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+static uint32_t packNorm(const std::vector<uint32_t>& v, unsigned int bits, bool isSigned)
+{
+	uint32_t r = 0, mask = (1u << bits) - 1;
+	float scale = (float)(isSigned ? mask >> 1 : mask);
+	for (size_t i = 0; i < v.size() && i * bits < 32; i++)
+	{
+		float f = isSigned ? std::clamp(toFloat(v[i]), -1.0f, 1.0f) : std::clamp(toFloat(v[i]), 0.0f, 1.0f);
+		r |= ((uint32_t)(int32_t)std::round(f * scale) & mask) << (i * bits);
+	}
+	return r;
+}
+
+static void unpackNorm(uint32_t v, unsigned int bits, bool isSigned, std::vector<uint32_t>& r)
+{
+	uint32_t mask = (1u << bits) - 1;
+	float scale = (float)(isSigned ? mask >> 1 : mask);
+	r.resize(32 / bits);
+	for (size_t i = 0; i < r.size(); i++)
+	{
+		uint32_t c = (v >> (i * bits)) & mask;
+		float f = isSigned ? std::max((float)((int32_t)(c << (32 - bits)) >> (32 - bits)) / scale, -1.0f) : c / scale;
+		r[i] = fromFloat(f);
+	}
+}
+
+static uint32_t mostSignificantBit(uint32_t x)
+{
+	if (x == 0) return 0xFFFFFFFF;
+	uint32_t bit = 31;
+	while ((x >> bit) == 0) bit--;
+	return bit;
+}
+
+// atomics on buffers and shared memory, uncontended since a run with a bound storage buffer has one thread
+static std::mutex atomicMutex;
+
+#pragma endregion
+
+#pragma region ShaderInterpreter
+
+struct ShaderInterpreter::Type
+{
+	spv::Op op = spv::OpNop;
+	uint32_t element = 0; // component, column, element or pointee type
+	uint32_t count = 0; // vector size, matrix columns or array length, 0 for runtime arrays
+	uint32_t components = 0; // words in the logical layout
+	uint32_t arrayStride = 0; // words, from ArrayStride
+	uint32_t storageClass = 0; // of a pointer
+	bool isSigned = false;
+	std::vector<uint32_t> members;
+	std::vector<uint32_t> logicalOffsets;
+	std::vector<uint32_t> explicitOffsets; // words, from Offset
+	std::vector<uint32_t> matrixStrides; // words, from MatrixStride
+};
+
+struct ShaderInterpreter::Global
+{
+	uint32_t id = 0;
+	uint32_t type = 0; // pointee
+	spv::StorageClass storageClass = spv::StorageClassPrivate;
+	int location = -1, binding = -1, builtIn = -1;
+	bool storageBuffer = false;
+	uint32_t initializer = 0;
+};
+
+struct ShaderInterpreter::Memory
+{
+	std::vector<uint32_t>* data = nullptr;
+	bool explicitLayout = false; // buffer layout from Offset, ArrayStride and MatrixStride
+};
+
+// pointers are { memory slot, word offset, matrix stride }
+struct ShaderInterpreter::Invocation
+{
+	struct Frame
+	{
+		size_t returnPc;
+		uint32_t resultId, block;
+		size_t memory, locals;
+	};
+
+	std::vector<std::vector<uint32_t>> values; // by id, SSA so they are reused between invocations
+	std::vector<Memory> memory; // globals first, then function variables
+	std::vector<std::vector<uint32_t>> storage; // invocation private globals by global index
+	std::deque<std::vector<uint32_t>> locals;
+	std::vector<Frame> frames;
+	std::vector<std::vector<uint32_t>> phis;
+	std::vector<uint64_t> offsets;
+
+	size_t pc = 0;
+	uint32_t block = 0, previousBlock = 0;
+	uint64_t executed = 0;
+	uint32_t index = 0;
+	uint32_t workgroup[3] = { 0, 0, 0 }, local[3] = { 0, 0, 0 };
+	bool killed = false;
+	Status status = Status::Running;
+};
+
+struct ShaderInterpreter::Counters
+{
+	std::vector<uint64_t> opcodes = std::vector<uint64_t>(65536, 0);
+	std::vector<uint64_t> blocks;
+	std::unordered_map<uint64_t, uint64_t> edges; // from << 32 | to
+	uint64_t instructions = 0, invocations = 0, killed = 0;
+
+	Counters(size_t bound) : blocks(bound, 0) {}
+};
+
+ShaderInterpreter::ShaderInterpreter() {}
+ShaderInterpreter::~ShaderInterpreter() {}
+
+bool ShaderInterpreter::Load(SpirvShader& shader)
+{
+	loaded = false;
+	module = SpirvModule();
+	const std::vector<GLuint>& spirv = shader.GetSpirv();
+	if (!module.Parse((const uint32_t*)spirv.data(), spirv.size()))
+	{
+		errors << "Interpreter error: SPIR-V parse error" << std::endl;
+		return false;
+	}
+	moduleHash = hashBytes(spirv.data(), spirv.size() * sizeof(GLuint));
+
+	uint32_t bound = module.GetIdBound();
+	types.assign(bound, Type());
+	typeOf.assign(bound, 0);
+	constants.assign(bound, std::vector<uint32_t>());
+	isConstant.assign(bound, false);
+	labels.assign(bound, 0);
+	globals.clear();
+	functionIndex.clear();
+	entryFunction = entryLabel = glslStd450 = 0;
+	localSize[0] = localSize[1] = localSize[2] = 1;
+
+	// decorations come before the types that need them
+	std::unordered_map<uint32_t, std::map<uint32_t, uint32_t>> decorations; // id -> decoration -> literal
+	std::unordered_map<uint32_t, std::map<std::pair<uint32_t, uint32_t>, uint32_t>> memberDecorations; // struct -> (member, decoration) -> literal
+	for (const SpirvInstruction& inst : module.instructions)
+	{
+		const std::vector<uint32_t>& w = inst.words;
+		if (inst.opcode == spv::OpDecorate && w.size() > 2) decorations[w[1]][w[2]] = w.size() > 3 ? w[3] : 0;
+		else if (inst.opcode == spv::OpMemberDecorate && w.size() > 3) memberDecorations[w[1]][{ w[2], w[3] }] = w.size() > 4 ? w[4] : 0;
+	}
+	auto decoration = [&](uint32_t id, spv::Decoration d, int defaultValue) -> int
+	{
+		auto it = decorations.find(id);
+		if (it == decorations.end()) return defaultValue;
+		auto dit = it->second.find(d);
+		return dit != it->second.end() ? (int)dit->second : defaultValue;
+	};
+	auto memberDecoration = [&](uint32_t id, uint32_t member, spv::Decoration d, int defaultValue) -> int
+	{
+		auto it = memberDecorations.find(id);
+		if (it == memberDecorations.end()) return defaultValue;
+		auto dit = it->second.find({ member, d });
+		return dit != it->second.end() ? (int)dit->second : defaultValue;
+	};
+
+	for (size_t i = 0; i < module.instructions.size(); i++)
+	{
+		const SpirvInstruction& inst = module.instructions[i];
+		const std::vector<uint32_t>& w = inst.words;
+		if (inst.typeId != 0 && inst.resultId != 0) typeOf[inst.resultId] = inst.typeId;
+		Type& t = types[inst.resultId];
+
+		switch (inst.opcode)
+		{
+		case spv::OpEntryPoint:
+			if (entryFunction == 0 && (w[1] == spv::ExecutionModelVertex || w[1] == spv::ExecutionModelFragment || w[1] == spv::ExecutionModelGLCompute))
+			{
+				model = (spv::ExecutionModel)w[1];
+				entryFunction = w[2];
+			}
+			break;
+		case spv::OpExecutionMode:
+			if (w[1] == entryFunction && w[2] == spv::ExecutionModeLocalSize && w.size() >= 6)
+				std::copy(w.begin() + 3, w.begin() + 6, localSize);
+			break;
+		case spv::OpExtInstImport:
+			if (inst.GetString(1) == "GLSL.std.450") glslStd450 = inst.resultId;
+			break;
+		case spv::OpLabel:
+			labels[inst.resultId] = i;
+			break;
+
+		case spv::OpTypeBool:
+		case spv::OpTypeImage:
+		case spv::OpTypeSampler:
+		case spv::OpTypeSampledImage:
+			t.op = inst.opcode;
+			t.components = 1; // opaque types hold nothing usable
+			break;
+		case spv::OpTypeInt:
+		case spv::OpTypeFloat:
+			if (w[2] != 32)
+			{
+				errors << "Interpreter error: only 32 bit numbers are supported" << std::endl;
+				return false;
+			}
+			t.op = inst.opcode;
+			t.components = 1;
+			t.isSigned = inst.opcode == spv::OpTypeInt && w[3] != 0;
+			break;
+		case spv::OpTypeVector:
+		case spv::OpTypeMatrix:
+			t.op = inst.opcode;
+			t.element = w[2];
+			t.count = w[3];
+			t.components = t.count * types[t.element].components;
+			break;
+		case spv::OpTypeArray:
+		case spv::OpTypeRuntimeArray:
+			t.op = inst.opcode;
+			t.element = w[2];
+			t.count = inst.opcode == spv::OpTypeArray && !constants[w[3]].empty() ? constants[w[3]][0] : 0;
+			t.components = t.count * types[t.element].components;
+			t.arrayStride = (uint32_t)decoration(inst.resultId, spv::DecorationArrayStride, 0) / 4;
+			break;
+		case spv::OpTypeStruct:
+			t.op = inst.opcode;
+			for (size_t m = 2; m < w.size(); m++)
+			{
+				uint32_t member = (uint32_t)(m - 2);
+				if (memberDecoration(inst.resultId, member, spv::DecorationRowMajor, -1) >= 0)
+				{
+					errors << "Interpreter error: row major matrices are not supported" << std::endl;
+					return false;
+				}
+				t.members.push_back(w[m]);
+				t.logicalOffsets.push_back(t.components);
+				t.explicitOffsets.push_back((uint32_t)memberDecoration(inst.resultId, member, spv::DecorationOffset, 0) / 4);
+				t.matrixStrides.push_back((uint32_t)memberDecoration(inst.resultId, member, spv::DecorationMatrixStride, 0) / 4);
+				t.components += types[w[m]].components;
+			}
+			break;
+		case spv::OpTypePointer:
+			t.op = inst.opcode;
+			t.storageClass = w[2];
+			t.element = w[3];
+			t.components = 3;
+			break;
+
+		case spv::OpConstantTrue:
+		case spv::OpSpecConstantTrue:
+			constants[inst.resultId] = { 1 };
+			isConstant[inst.resultId] = true;
+			break;
+		case spv::OpConstantFalse:
+		case spv::OpSpecConstantFalse:
+			constants[inst.resultId] = { 0 };
+			isConstant[inst.resultId] = true;
+			break;
+		case spv::OpConstant:
+		case spv::OpSpecConstant:
+			constants[inst.resultId].assign(w.begin() + 3, w.end());
+			isConstant[inst.resultId] = true;
+			break;
+		case spv::OpConstantComposite:
+		case spv::OpSpecConstantComposite:
+			for (size_t c = 3; c < w.size(); c++)
+				constants[inst.resultId].insert(constants[inst.resultId].end(), constants[w[c]].begin(), constants[w[c]].end());
+			isConstant[inst.resultId] = true;
+			break;
+		case spv::OpConstantNull:
+		case spv::OpUndef:
+			constants[inst.resultId].assign(types[inst.typeId].components, 0);
+			isConstant[inst.resultId] = true;
+			break;
+		case spv::OpSpecConstantOp:
+			errors << "Interpreter error: OpSpecConstantOp is not supported" << std::endl;
+			return false;
+
+		case spv::OpVariable:
+		{
+			if (w[3] == spv::StorageClassFunction) break;
+			Global g;
+			g.id = inst.resultId;
+			g.type = types[inst.typeId].element;
+			g.storageClass = (spv::StorageClass)w[3];
+			g.location = decoration(g.id, spv::DecorationLocation, -1);
+			g.binding = decoration(g.id, spv::DecorationBinding, -1);
+			g.builtIn = decoration(g.id, spv::DecorationBuiltIn, -1);
+			g.storageBuffer = g.storageClass == spv::StorageClassStorageBuffer
+				|| (g.storageClass == spv::StorageClassUniform && decoration(g.type, spv::DecorationBufferBlock, -1) >= 0);
+			g.initializer = w.size() > 4 ? w[4] : 0;
+			constants[g.id] = { (uint32_t)globals.size(), 0, 0 };
+			isConstant[g.id] = true;
+			globals.push_back(g);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	for (size_t f = 0; f < module.functions.size(); f++)
+		functionIndex[module.functions[f].resultId] = f;
+	auto entry = functionIndex.find(entryFunction);
+	if (entry == functionIndex.end() || module.functions[entry->second].blocks.empty())
+	{
+		errors << "Interpreter error: no vertex, fragment or compute entry point" << std::endl;
+		return false;
+	}
+	entryLabel = module.functions[entry->second].blocks[0].labelId;
+	loaded = true;
+	return true;
+}
+
+void ShaderInterpreter::SetInput(uint32_t location, const std::vector<float>& values)
+{
+	std::vector<uint32_t>& v = inputs[location];
+	v.resize(values.size());
+	std::memcpy(v.data(), values.data(), values.size() * sizeof(float));
+}
+
+void ShaderInterpreter::SetUniform(uint32_t location, const std::vector<float>& value)
+{
+	std::vector<uint32_t>& v = uniforms[location];
+	v.resize(value.size());
+	std::memcpy(v.data(), value.data(), value.size() * sizeof(float));
+}
+
+const std::vector<uint32_t>& ShaderInterpreter::GetOutput(uint32_t location) const
+{
+	static const std::vector<uint32_t> empty;
+	auto it = outputs.find(location);
+	return it != outputs.end() ? it->second : empty;
+}
+
+const std::vector<uint32_t>& ShaderInterpreter::GetBuiltInOutput(uint32_t variable) const
+{
+	static const std::vector<uint32_t> empty;
+	auto it = builtInOutputs.find(variable);
+	return it != builtInOutputs.end() ? it->second : empty;
+}
+
+std::vector<float> ShaderInterpreter::GetOutputFloats(uint32_t location) const
+{
+	const std::vector<uint32_t>& v = GetOutput(location);
+	std::vector<float> ret(v.size());
+	std::memcpy(ret.data(), v.data(), v.size() * sizeof(float));
+	return ret;
+}
+
+std::string ShaderInterpreter::GetErrors()
+{
+	std::string ret = errors.str();
+	errors = std::stringstream();
+	return ret;
+}
+
+#pragma region Running
+
+bool ShaderInterpreter::BeginRun(uint64_t invocations)
+{
+	profile = ExecutionProfile();
+	profile.moduleHash = moduleHash;
+	outputs.clear();
+	builtInOutputs.clear();
+	if (!loaded)
+	{
+		errors << "Interpreter error: no shader loaded" << std::endl;
+		return false;
+	}
+	// every output is created here, the worker threads only look them up
+	for (const Global& g : globals)
+	{
+		if (g.storageClass != spv::StorageClassOutput) continue;
+		std::vector<uint32_t>& out = g.location >= 0 ? outputs[(uint32_t)g.location] : builtInOutputs[g.id];
+		out.assign(invocations * types[g.type].components, 0);
+	}
+	return true;
+}
+
+void ShaderInterpreter::EndRun(std::vector<Counters>& counters)
+{
+	for (const Counters& c : counters)
+	{
+		profile.invocations += c.invocations;
+		profile.instructions += c.instructions;
+		profile.killed += c.killed;
+		for (size_t op = 0; op < c.opcodes.size(); op++)
+			if (c.opcodes[op] > 0) profile.opcodeCounts[(uint32_t)op] += c.opcodes[op];
+		for (size_t b = 0; b < c.blocks.size(); b++)
+			if (c.blocks[b] > 0) profile.blockCounts[(uint32_t)b] += c.blocks[b];
+		for (const auto& e : c.edges)
+			profile.edgeCounts[{ (uint32_t)(e.first >> 32), (uint32_t)e.first }] += e.second;
+	}
+}
+
+static unsigned int threadCount(unsigned int threads, uint64_t work)
+{
+	if (threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1u);
+	return (unsigned int)std::max<uint64_t>(std::min<uint64_t>(threads, work), 1);
+}
+
+bool ShaderInterpreter::UsesStorageBuffers() const
+{
+	for (const Global& g : globals)
+	{
+		if (!g.storageBuffer) continue;
+		auto it = storageBuffers.find((uint32_t)g.binding);
+		if (it != storageBuffers.end() && it->second != nullptr) return true;
+	}
+	return false;
+}
+
+bool ShaderInterpreter::Run(uint32_t invocations, unsigned int threads, uint32_t width)
+{
+	if (loaded && model == spv::ExecutionModelGLCompute)
+	{
+		errors << "Interpreter error: compute shaders run with Dispatch()" << std::endl;
+		return false;
+	}
+	if (!BeginRun(invocations)) return false;
+	gridWidth = std::max(width, 1u);
+
+	const uint64_t chunk = 64;
+	threads = UsesStorageBuffers() ? 1 : threadCount(threads, (invocations + chunk - 1) / chunk);
+	std::vector<Counters> counters(threads, Counters(module.GetIdBound()));
+	std::atomic<uint64_t> next{ 0 };
+	std::atomic<bool> failed{ false };
+
+	auto work = [&](Counters& c)
+	{
+		Invocation inv;
+		for (uint64_t begin; !failed && (begin = next.fetch_add(chunk)) < invocations; )
+			for (uint64_t i = begin; i < std::min<uint64_t>(begin + chunk, invocations) && !failed; i++)
+			{
+				Setup(inv, (uint32_t)i, nullptr);
+				do inv.status = Execute(inv, c);
+				while (inv.status == Status::Barrier);
+				if (inv.status == Status::Error) failed = true;
+				else Finish(inv, c);
+			}
+	};
+	std::vector<std::thread> pool;
+	for (unsigned int t = 1; t < threads; t++) pool.emplace_back(work, std::ref(counters[t]));
+	work(counters[0]);
+	for (std::thread& t : pool) t.join();
+
+	EndRun(counters);
+	return !failed;
+}
+
+bool ShaderInterpreter::Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ, unsigned int threads)
+{
+	if (loaded && model != spv::ExecutionModelGLCompute)
+	{
+		errors << "Interpreter error: vertex and fragment shaders run with Run()" << std::endl;
+		return false;
+	}
+	uint64_t groups = (uint64_t)groupsX * groupsY * groupsZ;
+	uint32_t groupSize = localSize[0] * localSize[1] * localSize[2];
+	if (!BeginRun(groups * groupSize)) return false;
+	groupCount[0] = groupsX;
+	groupCount[1] = groupsY;
+	groupCount[2] = groupsZ;
+
+	threads = UsesStorageBuffers() ? 1 : threadCount(threads, groups); // the buffer words are not accessed atomically
+	std::vector<Counters> counters(threads, Counters(module.GetIdBound()));
+	std::atomic<uint64_t> next{ 0 };
+	std::atomic<bool> failed{ false };
+
+	auto work = [&](Counters& c)
+	{
+		std::vector<Invocation> group(groupSize);
+		std::vector<std::vector<uint32_t>> shared(globals.size());
+		for (uint64_t g; !failed && (g = next++) < groups; )
+		{
+			uint32_t id[3] = { (uint32_t)(g % groupsX), (uint32_t)(g / groupsX % groupsY), (uint32_t)(g / groupsX / groupsY) };
+			for (size_t s = 0; s < globals.size(); s++)
+				if (globals[s].storageClass == spv::StorageClassWorkgroup) shared[s].assign(types[globals[s].type].components, 0);
+
+			for (uint32_t i = 0; i < groupSize; i++)
+			{
+				Invocation& inv = group[i];
+				std::copy(id, id + 3, inv.workgroup);
+				inv.local[0] = i % localSize[0];
+				inv.local[1] = i / localSize[0] % localSize[1];
+				inv.local[2] = i / localSize[0] / localSize[1];
+				Setup(inv, (uint32_t)(g * groupSize + i), &shared);
+			}
+
+			// every invocation runs up to the next barrier before any of them continues
+			for (bool waiting = true; waiting && !failed; )
+			{
+				waiting = false;
+				for (Invocation& inv : group)
+				{
+					if (inv.status != Status::Running && inv.status != Status::Barrier) continue;
+					inv.status = Execute(inv, c);
+					if (inv.status == Status::Error) failed = true;
+					waiting |= inv.status == Status::Barrier;
+				}
+			}
+			if (!failed)
+				for (Invocation& inv : group) Finish(inv, c);
+		}
+	};
+	std::vector<std::thread> pool;
+	for (unsigned int t = 1; t < threads; t++) pool.emplace_back(work, std::ref(counters[t]));
+	work(counters[0]);
+	for (std::thread& t : pool) t.join();
+
+	EndRun(counters);
+	return !failed;
+}
+
+void ShaderInterpreter::Setup(Invocation& inv, uint32_t index, std::vector<std::vector<uint32_t>>* shared)
+{
+	if (inv.values.size() != types.size()) inv.values.assign(types.size(), std::vector<uint32_t>());
+	inv.memory.assign(globals.size(), Memory());
+	inv.storage.resize(globals.size());
+	inv.locals.clear();
+	inv.frames.clear();
+	inv.pc = 0;
+	inv.block = inv.previousBlock = 0;
+	inv.executed = 0;
+	inv.index = index;
+	inv.killed = false;
+	inv.status = Status::Running;
+
+	for (size_t i = 0; i < globals.size(); i++)
+	{
+		const Global& g = globals[i];
+		Memory& m = inv.memory[i];
+		std::vector<uint32_t>& storage = inv.storage[i];
+
+		if (g.storageClass == spv::StorageClassUniform || g.storageClass == spv::StorageClassStorageBuffer)
+		{
+			m.explicitLayout = true;
+			storage.clear();
+			m.data = &storage;
+			if (g.storageBuffer)
+			{
+				auto it = storageBuffers.find((uint32_t)g.binding);
+				if (it != storageBuffers.end() && it->second != nullptr) m.data = it->second;
+			}
+			else
+			{
+				auto it = uniformBuffers.find((uint32_t)g.binding);
+				if (it != uniformBuffers.end()) m.data = &it->second;
+			}
+			continue;
+		}
+		if (g.storageClass == spv::StorageClassWorkgroup && shared != nullptr)
+		{
+			m.data = &(*shared)[i];
+			continue;
+		}
+
+		storage.assign(types[g.type].components, 0);
+		m.data = &storage;
+		auto set = [&](std::initializer_list<uint32_t> v) { std::copy_n(v.begin(), std::min(v.size(), storage.size()), storage.begin()); };
+		auto fill = [&](const std::vector<uint32_t>& src, uint64_t first)
+		{
+			for (size_t c = 0; c < storage.size() && !src.empty(); c++) storage[c] = src[(first + c) % src.size()];
+		};
+
+		if (g.storageClass == spv::StorageClassInput && g.builtIn >= 0)
+		{
+			uint32_t global[3] = { inv.workgroup[0] * localSize[0] + inv.local[0], inv.workgroup[1] * localSize[1] + inv.local[1],
+				inv.workgroup[2] * localSize[2] + inv.local[2] };
+			switch (g.builtIn)
+			{
+			case spv::BuiltInVertexId:
+			case spv::BuiltInVertexIndex:
+				set({ index });
+				break;
+			case spv::BuiltInFragCoord:
+				set({ fromFloat(index % gridWidth + 0.5f), fromFloat(index / gridWidth + 0.5f), fromFloat(0.5f), fromFloat(1.0f) });
+				break;
+			case spv::BuiltInPointCoord:
+				set({ fromFloat(0.5f), fromFloat(0.5f) });
+				break;
+			case spv::BuiltInFrontFacing:
+				set({ 1 });
+				break;
+			case spv::BuiltInNumWorkgroups:
+				set({ groupCount[0], groupCount[1], groupCount[2] });
+				break;
+			case spv::BuiltInWorkgroupSize:
+				set({ localSize[0], localSize[1], localSize[2] });
+				break;
+			case spv::BuiltInWorkgroupId:
+				set({ inv.workgroup[0], inv.workgroup[1], inv.workgroup[2] });
+				break;
+			case spv::BuiltInLocalInvocationId:
+				set({ inv.local[0], inv.local[1], inv.local[2] });
+				break;
+			case spv::BuiltInGlobalInvocationId:
+				set({ global[0], global[1], global[2] });
+				break;
+			case spv::BuiltInLocalInvocationIndex:
+				set({ (inv.local[2] * localSize[1] + inv.local[1]) * localSize[0] + inv.local[0] });
+				break;
+			default:
+				break; // instance, primitive and sample ids are 0
+			}
+		}
+		else if (g.storageClass == spv::StorageClassInput && g.location >= 0)
+		{
+			auto it = inputs.find((uint32_t)g.location);
+			if (it != inputs.end()) fill(it->second, (uint64_t)index * storage.size());
+		}
+		else if (g.storageClass == spv::StorageClassUniformConstant && g.location >= 0)
+		{
+			auto it = uniforms.find((uint32_t)g.location);
+			if (it != uniforms.end()) std::copy_n(it->second.begin(), std::min(it->second.size(), storage.size()), storage.begin());
+		}
+		else if (g.initializer != 0) fill(constants[g.initializer], 0);
+	}
+}
+
+void ShaderInterpreter::Finish(Invocation& inv, Counters& counters)
+{
+	counters.invocations++;
+	if (inv.killed)
+	{
+		counters.killed++;
+		return;
+	}
+	for (size_t i = 0; i < globals.size(); i++)
+	{
+		const Global& g = globals[i];
+		if (g.storageClass != spv::StorageClassOutput) continue;
+		std::vector<uint32_t>& out = g.location >= 0 ? outputs.at((uint32_t)g.location) : builtInOutputs.at(g.id);
+		const std::vector<uint32_t>& storage = inv.storage[i];
+		uint64_t first = (uint64_t)inv.index * storage.size();
+		if (first + storage.size() <= out.size()) std::copy(storage.begin(), storage.end(), out.begin() + first);
+	}
+}
+
+ShaderInterpreter::Status ShaderInterpreter::Error(Invocation& inv, const std::string& message)
+{
+	std::lock_guard<std::mutex> lock(errorsMutex);
+	errors << "Interpreter error: " << message << " at instruction " << inv.pc << " in invocation " << inv.index << std::endl;
+	return Status::Error;
+}
+
+#pragma endregion
+
+#pragma region Memory
+
+const std::vector<uint32_t>& ShaderInterpreter::Value(const Invocation& inv, uint32_t id) const
+{
+	return isConstant[id] ? constants[id] : inv.values[id];
+}
+
+uint32_t ShaderInterpreter::Scalar(const Invocation& inv, uint32_t id) const
+{
+	const std::vector<uint32_t>& v = Value(inv, id);
+	return v.empty() ? 0 : v[0];
+}
+
+bool ShaderInterpreter::Element(uint32_t& type, uint32_t index, bool explicitLayout, uint64_t& offset, uint32_t& matrixStride) const
+{
+	const Type& t = types[type];
+	switch (t.op)
+	{
+	case spv::OpTypeStruct:
+		if (index >= t.members.size()) return false;
+		offset += explicitLayout ? t.explicitOffsets[index] : t.logicalOffsets[index];
+		matrixStride = t.matrixStrides[index];
+		type = t.members[index];
+		return true;
+	case spv::OpTypeArray:
+	case spv::OpTypeRuntimeArray: // bounded by the buffer size
+		if (t.op == spv::OpTypeArray && index >= t.count) return false;
+		offset += (uint64_t)index * (explicitLayout && t.arrayStride > 0 ? t.arrayStride : types[t.element].components);
+		type = t.element;
+		return true; // arrays of matrices keep the member's matrix stride
+	case spv::OpTypeMatrix:
+		if (index >= t.count) return false;
+		offset += (uint64_t)index * (explicitLayout && matrixStride > 0 ? matrixStride : types[t.element].components);
+		type = t.element;
+		return true;
+	case spv::OpTypeVector:
+		if (index >= t.count) return false;
+		offset += index;
+		type = t.element;
+		return true;
+	default:
+		return false;
+	}
+}
+
+void ShaderInterpreter::Layout(uint32_t type, uint64_t offset, uint32_t matrixStride, bool explicitLayout, std::vector<uint64_t>& offsets) const
+{
+	const Type& t = types[type];
+	switch (t.op)
+	{
+	case spv::OpTypeVector:
+		for (uint32_t i = 0; i < t.count; i++) offsets.push_back(offset + i);
+		break;
+	case spv::OpTypeMatrix:
+	case spv::OpTypeArray:
+		for (uint32_t i = 0; i < t.count; i++)
+		{
+			uint32_t element = type, stride = matrixStride;
+			uint64_t o = offset;
+			Element(element, i, explicitLayout, o, stride);
+			Layout(element, o, matrixStride, explicitLayout, offsets);
+		}
+		break;
+	case spv::OpTypeStruct:
+		for (uint32_t m = 0; m < t.members.size(); m++)
+			Layout(t.members[m], offset + (explicitLayout ? t.explicitOffsets[m] : t.logicalOffsets[m]), t.matrixStrides[m], explicitLayout, offsets);
+		break;
+	case spv::OpTypeRuntimeArray:
+		break; // only reachable through access chains
+	default:
+		offsets.push_back(offset);
+		break;
+	}
+}
+
+ShaderInterpreter::Memory* ShaderInterpreter::Resolve(Invocation& inv, const std::vector<uint32_t>& pointer)
+{
+	if (pointer.size() < 3 || pointer[0] >= inv.memory.size() || inv.memory[pointer[0]].data == nullptr) return nullptr;
+	return &inv.memory[pointer[0]];
+}
+
+// out of bounds buffer reads give 0 and writes are dropped
+bool ShaderInterpreter::Read(Invocation& inv, const std::vector<uint32_t>& pointer, uint32_t type, std::vector<uint32_t>& value)
+{
+	Memory* m = Resolve(inv, pointer);
+	if (m == nullptr) return false;
+	inv.offsets.clear();
+	Layout(type, pointer[1], pointer[2], m->explicitLayout, inv.offsets);
+	value.resize(inv.offsets.size());
+	for (size_t i = 0; i < inv.offsets.size(); i++)
+		value[i] = inv.offsets[i] < m->data->size() ? (*m->data)[inv.offsets[i]] : 0;
+	return true;
+}
+
+bool ShaderInterpreter::Write(Invocation& inv, const std::vector<uint32_t>& pointer, uint32_t type, const std::vector<uint32_t>& value)
+{
+	Memory* m = Resolve(inv, pointer);
+	if (m == nullptr) return false;
+	inv.offsets.clear();
+	Layout(type, pointer[1], pointer[2], m->explicitLayout, inv.offsets);
+	for (size_t i = 0; i < inv.offsets.size() && i < value.size(); i++)
+		if (inv.offsets[i] < m->data->size()) (*m->data)[inv.offsets[i]] = value[i];
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Execution
+
+bool ShaderInterpreter::Branch(Invocation& inv, uint32_t label, Counters& counters)
+{
+	if (label >= labels.size() || module.instructions[labels[label]].opcode != spv::OpLabel) return false;
+	inv.previousBlock = inv.block;
+	inv.block = label;
+	counters.blocks[label]++;
+
+	// phis of a block read their operands before any of them is written
+	size_t i = labels[label] + 1, count = 0;
+	for (; module.instructions[i].opcode == spv::OpPhi; i++, count++)
+	{
+		const std::vector<uint32_t>& w = module.instructions[i].words;
+		if (inv.phis.size() <= count) inv.phis.resize(count + 1);
+		bool found = false;
+		for (size_t o = 3; o + 1 < w.size() && !found; o += 2)
+			if (w[o + 1] == inv.previousBlock)
+			{
+				inv.phis[count] = Value(inv, w[o]);
+				found = true;
+			}
+		if (!found) return false;
+	}
+	for (size_t p = 0; p < count; p++)
+		inv.values[module.instructions[labels[label] + 1 + p].resultId].swap(inv.phis[p]);
+	counters.opcodes[spv::OpPhi] += count;
+	counters.instructions += count;
+	inv.pc = i;
+	return true;
+}
+
+ShaderInterpreter::Status ShaderInterpreter::Execute(Invocation& inv, Counters& counters)
+{
+	if (inv.block == 0 && !Branch(inv, entryLabel, counters)) return Error(inv, "invalid entry block");
+
+	for (;;)
+	{
+		const SpirvInstruction& inst = module.instructions[inv.pc];
+		const std::vector<uint32_t>& w = inst.words;
+		auto operand = [&](size_t i) -> const std::vector<uint32_t>& { return Value(inv, w[i]); };
+		std::vector<uint32_t>& r = inv.values[inst.resultId];
+
+		if (inst.opcode != spv::OpLine && inst.opcode != spv::OpNoLine && inst.opcode != spv::OpSelectionMerge && inst.opcode != spv::OpLoopMerge)
+		{
+			if (++inv.executed > instructionLimit) return Error(inv, "instruction limit exceeded");
+			counters.opcodes[inst.opcode]++;
+			counters.instructions++;
+		}
+
+		switch (inst.opcode)
+		{
+		case spv::OpNop:
+		case spv::OpLine:
+		case spv::OpNoLine:
+		case spv::OpSelectionMerge:
+		case spv::OpLoopMerge:
+		case spv::OpMemoryBarrier:
+		case spv::OpUndef: // evaluated at load
+			break;
+
+		// memory
+		case spv::OpVariable:
+			inv.locals.emplace_back(types[types[inst.typeId].element].components, 0);
+			if (w.size() > 4) inv.locals.back() = operand(4);
+			inv.memory.push_back(Memory{ &inv.locals.back(), false });
+			r = { (uint32_t)(inv.memory.size() - 1), 0, 0 };
+			break;
+		case spv::OpLoad:
+			if (!Read(inv, operand(3), inst.typeId, r)) return Error(inv, "invalid pointer");
+			break;
+		case spv::OpStore:
+			if (!Write(inv, operand(1), types[typeOf[w[1]]].element, operand(2))) return Error(inv, "invalid pointer");
+			break;
+		case spv::OpCopyMemory:
+		{
+			std::vector<uint32_t> value;
+			if (!Read(inv, operand(2), types[typeOf[w[2]]].element, value) || !Write(inv, operand(1), types[typeOf[w[1]]].element, value))
+				return Error(inv, "invalid pointer");
+			break;
+		}
+		case spv::OpAccessChain:
+		case spv::OpInBoundsAccessChain:
+		{
+			const std::vector<uint32_t>& base = operand(3);
+			Memory* m = Resolve(inv, base);
+			if (m == nullptr) return Error(inv, "invalid pointer");
+			uint32_t type = types[typeOf[w[3]]].element, matrixStride = base[2];
+			uint64_t offset = base[1];
+			for (size_t i = 4; i < w.size(); i++)
+				if (!Element(type, Scalar(inv, w[i]), m->explicitLayout, offset, matrixStride)) return Error(inv, "index out of bounds");
+			r = { base[0], (uint32_t)offset, matrixStride };
+			break;
+		}
+		case spv::OpArrayLength:
+		{
+			const std::vector<uint32_t>& base = operand(3);
+			Memory* m = Resolve(inv, base);
+			if (m == nullptr) return Error(inv, "invalid pointer");
+			uint32_t type = types[typeOf[w[3]]].element, matrixStride = 0;
+			uint64_t offset = base[1];
+			if (!Element(type, w[4], true, offset, matrixStride)) return Error(inv, "invalid member");
+			uint32_t stride = std::max(types[type].arrayStride, 1u);
+			r = { offset < m->data->size() ? (uint32_t)((m->data->size() - offset) / stride) : 0 };
+			break;
+		}
+
+
+		// composites
+		case spv::OpCompositeConstruct:
+			r.clear();
+			for (size_t i = 3; i < w.size(); i++) r.insert(r.end(), operand(i).begin(), operand(i).end());
+			break;
+		case spv::OpCompositeExtract:
+		{
+			uint32_t type = typeOf[w[3]], matrixStride = 0;
+			uint64_t offset = 0;
+			for (size_t i = 4; i < w.size(); i++)
+				if (!Element(type, w[i], false, offset, matrixStride)) return Error(inv, "index out of bounds");
+			const std::vector<uint32_t>& composite = operand(3);
+			if (offset + types[type].components > composite.size()) return Error(inv, "undefined composite");
+			r.assign(composite.begin() + offset, composite.begin() + offset + types[type].components);
+			break;
+		}
+		case spv::OpCompositeInsert:
+		{
+			uint32_t type = inst.typeId, matrixStride = 0;
+			uint64_t offset = 0;
+			for (size_t i = 5; i < w.size(); i++)
+				if (!Element(type, w[i], false, offset, matrixStride)) return Error(inv, "index out of bounds");
+			r = operand(4);
+			const std::vector<uint32_t>& object = operand(3);
+			if (offset + object.size() > r.size()) return Error(inv, "undefined composite");
+			std::copy(object.begin(), object.end(), r.begin() + offset);
+			break;
+		}
+		case spv::OpVectorShuffle:
+		{
+			const std::vector<uint32_t>& a = operand(3);
+			const std::vector<uint32_t>& b = operand(4);
+			r.resize(w.size() - 5);
+			for (size_t i = 5; i < w.size(); i++)
+			{
+				uint32_t c = w[i];
+				r[i - 5] = c < a.size() ? a[c] : c - a.size() < b.size() ? b[c - a.size()] : 0;
+			}
+			break;
+		}
+		case spv::OpVectorExtractDynamic:
+		{
+			const std::vector<uint32_t>& a = operand(3);
+			uint32_t i = Scalar(inv, w[4]);
+			r = { i < a.size() ? a[i] : 0 };
+			break;
+		}
+		case spv::OpVectorInsertDynamic:
+		{
+			uint32_t i = Scalar(inv, w[5]);
+			r = operand(3);
+			if (i < r.size()) r[i] = Scalar(inv, w[4]);
+			break;
+		}
+		case spv::OpCopyObject:
+			r = operand(3);
+			break;
+		case spv::OpTranspose:
+		{
+			const std::vector<uint32_t>& m = operand(3);
+			uint32_t columns = types[typeOf[w[3]]].count, rows = types[types[typeOf[w[3]]].element].count;
+			r.resize(m.size());
+			for (uint32_t c = 0; c < columns; c++)
+				for (uint32_t row = 0; row < rows; row++) r[row * columns + c] = m[c * rows + row];
+			break;
+		}
+
+
+		// conversions
+		case spv::OpConvertFToU:
+			unaryOp(r, operand(3), [](uint32_t x)
+				{
+					float f = toFloat(x);
+					return !(f > 0.0f) ? 0u : f >= 4294967295.0f ? 0xFFFFFFFFu : (uint32_t)f;
+				});
+			break;
+		case spv::OpConvertFToS:
+			unaryOp(r, operand(3), [](uint32_t x)
+				{
+					float f = toFloat(x);
+					return f != f ? 0u : (uint32_t)(int32_t)std::clamp(f, -2147483648.0f, 2147483520.0f);
+				});
+			break;
+		case spv::OpConvertSToF:
+			unaryOp(r, operand(3), [](uint32_t x) { return fromFloat((float)(int32_t)x); });
+			break;
+		case spv::OpConvertUToF:
+			unaryOp(r, operand(3), [](uint32_t x) { return fromFloat((float)x); });
+			break;
+		case spv::OpUConvert:
+		case spv::OpSConvert:
+		case spv::OpFConvert:
+		case spv::OpBitcast:
+			r = operand(3); // every type is 32 bit
+			break;
+		case spv::OpQuantizeToF16:
+			floatOp(r, operand(3), [](float x) { return halfToFloat(floatToHalf(x)); });
+			break;
+
+
+		// arithmetic
+		case spv::OpSNegate:
+			unaryOp(r, operand(3), [](uint32_t x) { return 0u - x; });
+			break;
+		case spv::OpFNegate:
+			unaryOp(r, operand(3), [](uint32_t x) { return x ^ 0x80000000u; });
+			break;
+		case spv::OpIAdd:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x + y; });
+			break;
+		case spv::OpISub:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x - y; });
+			break;
+		case spv::OpIMul:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x * y; });
+			break;
+		case spv::OpUDiv:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return y != 0 ? x / y : 0; });
+			break;
+		case spv::OpSDiv:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return (uint32_t)signedDivide((int32_t)x, (int32_t)y); });
+			break;
+		case spv::OpUMod:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return y != 0 ? x % y : 0; });
+			break;
+		case spv::OpSRem:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return (uint32_t)signedRemainder((int32_t)x, (int32_t)y); });
+			break;
+		case spv::OpSMod:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y)
+				{
+					int32_t m = signedRemainder((int32_t)x, (int32_t)y);
+					return (uint32_t)(m != 0 && (m < 0) != ((int32_t)y < 0) ? m + (int32_t)y : m);
+				});
+			break;
+		case spv::OpFAdd:
+			floatOp(r, operand(3), operand(4), [](float x, float y) { return x + y; });
+			break;
+		case spv::OpFSub:
+			floatOp(r, operand(3), operand(4), [](float x, float y) { return x - y; });
+			break;
+		case spv::OpFMul:
+		case spv::OpVectorTimesScalar:
+		case spv::OpMatrixTimesScalar:
+			floatOp(r, operand(3), operand(4), [](float x, float y) { return x * y; });
+			break;
+		case spv::OpFDiv:
+			floatOp(r, operand(3), operand(4), [](float x, float y) { return x / y; });
+			break;
+		case spv::OpFRem:
+			floatOp(r, operand(3), operand(4), [](float x, float y) { return std::fmod(x, y); });
+			break;
+		case spv::OpFMod:
+			floatOp(r, operand(3), operand(4), [](float x, float y) { return x - y * std::floor(x / y); });
+			break;
+		case spv::OpMatrixTimesVector:
+		{
+			const std::vector<uint32_t>& m = operand(3);
+			const std::vector<uint32_t>& v = operand(4);
+			uint32_t rows = types[inst.typeId].count;
+			r.assign(rows, 0);
+			for (uint32_t row = 0; row < rows; row++)
+			{
+				float sum = 0.0f;
+				for (size_t c = 0; c < v.size() && c * rows + row < m.size(); c++) sum += toFloat(m[c * rows + row]) * toFloat(v[c]);
+				r[row] = fromFloat(sum);
+			}
+			break;
+		}
+		case spv::OpVectorTimesMatrix:
+		{
+			const std::vector<uint32_t>& v = operand(3);
+			const std::vector<uint32_t>& m = operand(4);
+			uint32_t columns = types[inst.typeId].count, rows = (uint32_t)v.size();
+			r.assign(columns, 0);
+			for (uint32_t c = 0; c < columns; c++)
+			{
+				float sum = 0.0f;
+				for (uint32_t row = 0; row < rows && c * rows + row < m.size(); row++) sum += toFloat(v[row]) * toFloat(m[c * rows + row]);
+				r[c] = fromFloat(sum);
+			}
+			break;
+		}
+		case spv::OpMatrixTimesMatrix:
+		{
+			const std::vector<uint32_t>& a = operand(3);
+			const std::vector<uint32_t>& b = operand(4);
+			uint32_t columns = types[inst.typeId].count, rows = types[types[inst.typeId].element].count;
+			uint32_t inner = rows > 0 ? (uint32_t)a.size() / rows : 0;
+			r.assign(columns * rows, 0);
+			for (uint32_t c = 0; c < columns; c++)
+				for (uint32_t row = 0; row < rows; row++)
+				{
+					float sum = 0.0f;
+					for (uint32_t k = 0; k < inner && c * inner + k < b.size(); k++) sum += toFloat(a[k * rows + row]) * toFloat(b[c * inner + k]);
+					r[c * rows + row] = fromFloat(sum);
+				}
+			break;
+		}
+		case spv::OpOuterProduct:
+		{
+			const std::vector<uint32_t>& a = operand(3);
+			const std::vector<uint32_t>& b = operand(4);
+			r.resize(a.size() * b.size());
+			for (size_t c = 0; c < b.size(); c++)
+				for (size_t row = 0; row < a.size(); row++) r[c * a.size() + row] = fromFloat(toFloat(a[row]) * toFloat(b[c]));
+			break;
+		}
+		case spv::OpDot:
+			r = { fromFloat(dot(operand(3), operand(4))) };
+			break;
+
+
+		// logic and comparison
+		case spv::OpAny:
+		case spv::OpAll:
+		{
+			const std::vector<uint32_t>& a = operand(3);
+			bool any = std::any_of(a.begin(), a.end(), [](uint32_t x) { return x != 0; });
+			bool all = std::all_of(a.begin(), a.end(), [](uint32_t x) { return x != 0; });
+			r = { (inst.opcode == spv::OpAny ? any : all) ? 1u : 0u };
+			break;
+		}
+		case spv::OpIsNan:
+			unaryOp(r, operand(3), [](uint32_t x) { return std::isnan(toFloat(x)) ? 1u : 0u; });
+			break;
+		case spv::OpIsInf:
+			unaryOp(r, operand(3), [](uint32_t x) { return std::isinf(toFloat(x)) ? 1u : 0u; });
+			break;
+		case spv::OpLogicalEqual:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return (x != 0) == (y != 0) ? 1u : 0u; });
+			break;
+		case spv::OpLogicalNotEqual:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return (x != 0) != (y != 0) ? 1u : 0u; });
+			break;
+		case spv::OpLogicalOr:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x != 0 || y != 0 ? 1u : 0u; });
+			break;
+		case spv::OpLogicalAnd:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x != 0 && y != 0 ? 1u : 0u; });
+			break;
+		case spv::OpLogicalNot:
+			unaryOp(r, operand(3), [](uint32_t x) { return x != 0 ? 0u : 1u; });
+			break;
+		case spv::OpSelect:
+		{
+			const std::vector<uint32_t>& condition = operand(3);
+			const std::vector<uint32_t>& a = operand(4);
+			const std::vector<uint32_t>& b = operand(5);
+			r.resize(a.size());
+			for (size_t i = 0; i < a.size() && i < b.size(); i++)
+				r[i] = condition.empty() || condition[condition.size() == 1 ? 0 : i] != 0 ? a[i] : b[i];
+			break;
+		}
+		case spv::OpIEqual:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x == y ? 1u : 0u; });
+			break;
+		case spv::OpINotEqual:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x != y ? 1u : 0u; });
+			break;
+		case spv::OpUGreaterThan:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x > y ? 1u : 0u; });
+			break;
+		case spv::OpSGreaterThan:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return (int32_t)x > (int32_t)y ? 1u : 0u; });
+			break;
+		case spv::OpUGreaterThanEqual:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x >= y ? 1u : 0u; });
+			break;
+		case spv::OpSGreaterThanEqual:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return (int32_t)x >= (int32_t)y ? 1u : 0u; });
+			break;
+		case spv::OpULessThan:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x < y ? 1u : 0u; });
+			break;
+		case spv::OpSLessThan:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return (int32_t)x < (int32_t)y ? 1u : 0u; });
+			break;
+		case spv::OpULessThanEqual:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x <= y ? 1u : 0u; });
+			break;
+		case spv::OpSLessThanEqual:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return (int32_t)x <= (int32_t)y ? 1u : 0u; });
+			break;
+		// ordered comparisons are false and unordered ones true when an operand is NaN
+		case spv::OpFOrdEqual:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return x == y; });
+			break;
+		case spv::OpFUnordEqual:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return x == y || x != x || y != y; });
+			break;
+		case spv::OpFOrdNotEqual:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return x == x && y == y && x != y; });
+			break;
+		case spv::OpFUnordNotEqual:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return x != y; });
+			break;
+		case spv::OpFOrdLessThan:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return x < y; });
+			break;
+		case spv::OpFUnordLessThan:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return !(x >= y); });
+			break;
+		case spv::OpFOrdGreaterThan:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return x > y; });
+			break;
+		case spv::OpFUnordGreaterThan:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return !(x <= y); });
+			break;
+		case spv::OpFOrdLessThanEqual:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return x <= y; });
+			break;
+		case spv::OpFUnordLessThanEqual:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return !(x > y); });
+			break;
+		case spv::OpFOrdGreaterThanEqual:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return x >= y; });
+			break;
+		case spv::OpFUnordGreaterThanEqual:
+			compareOp(r, operand(3), operand(4), [](float x, float y) { return !(x < y); });
+			break;
+
+
+		// bits
+		case spv::OpShiftRightLogical:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x >> (y & 31); });
+			break;
+		case spv::OpShiftRightArithmetic:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return (uint32_t)((int32_t)x >> (y & 31)); });
+			break;
+		case spv::OpShiftLeftLogical:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x << (y & 31); });
+			break;
+		case spv::OpBitwiseOr:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x | y; });
+			break;
+		case spv::OpBitwiseXor:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x ^ y; });
+			break;
+		case spv::OpBitwiseAnd:
+			binaryOp(r, operand(3), operand(4), [](uint32_t x, uint32_t y) { return x & y; });
+			break;
+		case spv::OpNot:
+			unaryOp(r, operand(3), [](uint32_t x) { return ~x; });
+			break;
+		case spv::OpBitFieldInsert:
+		{
+			uint32_t offset = Scalar(inv, w[5]) & 31, count = Scalar(inv, w[6]);
+			uint32_t mask = (count >= 32 ? 0xFFFFFFFFu : (1u << count) - 1) << offset;
+			binaryOp(r, operand(3), operand(4), [&](uint32_t base, uint32_t insert) { return (base & ~mask) | ((insert << offset) & mask); });
+			break;
+		}
+		case spv::OpBitFieldSExtract:
+		case spv::OpBitFieldUExtract:
+		{
+			uint32_t offset = Scalar(inv, w[4]) & 31, count = std::min(Scalar(inv, w[5]), 32 - offset);
+			bool isSigned = inst.opcode == spv::OpBitFieldSExtract;
+			unaryOp(r, operand(3), [&](uint32_t x)
+				{
+					if (count == 0) return 0u;
+					uint32_t shifted = x << (32 - offset - count);
+					return isSigned ? (uint32_t)((int32_t)shifted >> (32 - count)) : shifted >> (32 - count);
+				});
+			break;
+		}
+		case spv::OpBitReverse:
+			unaryOp(r, operand(3), [](uint32_t x)
+				{
+					uint32_t y = 0;
+					for (int i = 0; i < 32; i++) y |= ((x >> i) & 1u) << (31 - i);
+					return y;
+				});
+			break;
+		case spv::OpBitCount:
+			unaryOp(r, operand(3), [](uint32_t x) { return (uint32_t)std::bitset<32>(x).count(); });
+			break;
+
+
+		case spv::OpDPdx:
+		case spv::OpDPdy:
+		case spv::OpFwidth:
+		case spv::OpDPdxFine:
+		case spv::OpDPdyFine:
+		case spv::OpFwidthFine:
+		case spv::OpDPdxCoarse:
+		case spv::OpDPdyCoarse:
+		case spv::OpFwidthCoarse:
+			r.assign(types[inst.typeId].components, 0); // invocations run one at a time, not in quads
+			break;
+
+		case spv::OpExtInst:
+			if (w[3] != glslStd450 || !ExecuteExtended(inv, inst, r))
+				return Error(inv, "unsupported extended instruction " + std::to_string(w[4]));
+			break;
+
+		// atomics
+		case spv::OpAtomicLoad:
+		{
+			std::lock_guard<std::mutex> lock(atomicMutex);
+			if (!Read(inv, operand(3), inst.typeId, r)) return Error(inv, "invalid pointer");
+			break;
+		}
+		case spv::OpAtomicStore:
+		{
+			std::lock_guard<std::mutex> lock(atomicMutex);
+			if (!Write(inv, operand(1), types[typeOf[w[1]]].element, operand(4))) return Error(inv, "invalid pointer");
+			break;
+		}
+		case spv::OpAtomicExchange:
+		case spv::OpAtomicCompareExchange:
+		case spv::OpAtomicIIncrement:
+		case spv::OpAtomicIDecrement:
+		case spv::OpAtomicIAdd:
+		case spv::OpAtomicISub:
+		case spv::OpAtomicSMin:
+		case spv::OpAtomicUMin:
+		case spv::OpAtomicSMax:
+		case spv::OpAtomicUMax:
+		case spv::OpAtomicAnd:
+		case spv::OpAtomicOr:
+		case spv::OpAtomicXor:
+		{
+			std::lock_guard<std::mutex> lock(atomicMutex);
+			const std::vector<uint32_t>& pointer = operand(3);
+			if (!Read(inv, pointer, inst.typeId, r) || r.empty()) return Error(inv, "invalid pointer");
+			uint32_t old = r[0], value = 0, result = old;
+			if (inst.opcode == spv::OpAtomicCompareExchange) value = Scalar(inv, w[7]);
+			else if (inst.opcode != spv::OpAtomicIIncrement && inst.opcode != spv::OpAtomicIDecrement) value = Scalar(inv, w[6]);
+			switch (inst.opcode)
+			{
+			case spv::OpAtomicExchange: result = value; break;
+			case spv::OpAtomicCompareExchange: result = old == Scalar(inv, w[8]) ? value : old; break;
+			case spv::OpAtomicIIncrement: result = old + 1; break;
+			case spv::OpAtomicIDecrement: result = old - 1; break;
+			case spv::OpAtomicIAdd: result = old + value; break;
+			case spv::OpAtomicISub: result = old - value; break;
+			case spv::OpAtomicSMin: result = (uint32_t)std::min((int32_t)old, (int32_t)value); break;
+			case spv::OpAtomicUMin: result = std::min(old, value); break;
+			case spv::OpAtomicSMax: result = (uint32_t)std::max((int32_t)old, (int32_t)value); break;
+			case spv::OpAtomicUMax: result = std::max(old, value); break;
+			case spv::OpAtomicAnd: result = old & value; break;
+			case spv::OpAtomicOr: result = old | value; break;
+			case spv::OpAtomicXor: result = old ^ value; break;
+			default: break;
+			}
+			Write(inv, pointer, inst.typeId, { result });
+			break;
+		}
+
+
+		// control flow
+		case spv::OpBranch:
+		case spv::OpBranchConditional:
+		case spv::OpSwitch:
+		{
+			uint32_t target = w[1];
+			if (inst.opcode == spv::OpBranchConditional) target = Scalar(inv, w[1]) != 0 ? w[2] : w[3];
+			else if (inst.opcode == spv::OpSwitch)
+			{
+				uint32_t selector = Scalar(inv, w[1]);
+				target = w[2];
+				for (size_t i = 3; i + 1 < w.size(); i += 2)
+					if (w[i] == selector) target = w[i + 1];
+			}
+			counters.edges[(uint64_t)inv.block << 32 | target]++;
+			if (!Branch(inv, target, counters)) return Error(inv, "invalid branch");
+			continue;
+		}
+		case spv::OpReturn:
+		case spv::OpReturnValue:
+		{
+			if (inv.frames.empty()) return Status::Done;
+			Invocation::Frame frame = inv.frames.back();
+			inv.frames.pop_back();
+			if (inst.opcode == spv::OpReturnValue) inv.values[frame.resultId] = operand(1);
+			inv.memory.resize(frame.memory);
+			inv.locals.resize(frame.locals);
+			inv.block = frame.block;
+			inv.pc = frame.returnPc + 1;
+			continue;
+		}
+		case spv::OpFunctionCall:
+		{
+			auto it = functionIndex.find(w[3]);
+			if (it == functionIndex.end() || module.functions[it->second].blocks.empty()) return Error(inv, "call to a function without body");
+			const SpirvFunction& f = module.functions[it->second];
+			for (size_t a = 4, p = f.begin + 1; a < w.size() && p < f.end; a++, p++)
+				inv.values[module.instructions[p].resultId] = operand(a);
+			inv.frames.push_back({ inv.pc, inst.resultId, inv.block, inv.memory.size(), inv.locals.size() });
+			if (!Branch(inv, f.blocks[0].labelId, counters)) return Error(inv, "invalid function");
+			continue;
+		}
+		case spv::OpKill:
+		case spv::OpTerminateInvocation:
+			inv.killed = true;
+			return Status::Killed;
+		case spv::OpControlBarrier:
+			inv.pc++;
+			return Status::Barrier;
+		case spv::OpUnreachable:
+			return Error(inv, "reached OpUnreachable");
+
+
+		default:
+			return Error(inv, "unsupported instruction Op" + std::to_string(inst.opcode));
+		}
+		inv.pc++;
+	}
+}
+
+bool ShaderInterpreter::ExecuteExtended(Invocation& inv, const SpirvInstruction& inst, std::vector<uint32_t>& r)
+{
+	const std::vector<uint32_t>& w = inst.words;
+	static const std::vector<uint32_t> none;
+	auto arg = [&](size_t i) -> const std::vector<uint32_t>& { return 5 + i < w.size() ? Value(inv, w[5 + i]) : none; };
+	auto toDoubles = [](const std::vector<uint32_t>& v)
+	{
+		std::vector<double> d(v.size());
+		for (size_t i = 0; i < v.size(); i++) d[i] = toFloat(v[i]);
+		return d;
+	};
+
+	switch (w[4])
+	{
+	case GLSLstd450Round: floatOp(r, arg(0), [](float x) { return std::round(x); }); break;
+	case GLSLstd450RoundEven: floatOp(r, arg(0), [](float x) { return std::nearbyint(x); }); break;
+	case GLSLstd450Trunc: floatOp(r, arg(0), [](float x) { return std::trunc(x); }); break;
+	case GLSLstd450FAbs: floatOp(r, arg(0), [](float x) { return std::fabs(x); }); break;
+	case GLSLstd450SAbs: unaryOp(r, arg(0), [](uint32_t x) { return (int32_t)x < 0 ? 0u - x : x; }); break;
+	case GLSLstd450FSign: floatOp(r, arg(0), [](float x) { return x > 0.0f ? 1.0f : x < 0.0f ? -1.0f : 0.0f; }); break;
+	case GLSLstd450SSign: unaryOp(r, arg(0), [](uint32_t x) { return (int32_t)x > 0 ? 1u : (int32_t)x < 0 ? 0xFFFFFFFFu : 0u; }); break;
+	case GLSLstd450Floor: floatOp(r, arg(0), [](float x) { return std::floor(x); }); break;
+	case GLSLstd450Ceil: floatOp(r, arg(0), [](float x) { return std::ceil(x); }); break;
+	case GLSLstd450Fract: floatOp(r, arg(0), [](float x) { return x - std::floor(x); }); break;
+	case GLSLstd450Radians: floatOp(r, arg(0), [](float x) { return x * 0.017453292519943295f; }); break;
+	case GLSLstd450Degrees: floatOp(r, arg(0), [](float x) { return x * 57.29577951308232f; }); break;
+	case GLSLstd450Sin: floatOp(r, arg(0), [](float x) { return std::sin(x); }); break;
+	case GLSLstd450Cos: floatOp(r, arg(0), [](float x) { return std::cos(x); }); break;
+	case GLSLstd450Tan: floatOp(r, arg(0), [](float x) { return std::tan(x); }); break;
+	case GLSLstd450Asin: floatOp(r, arg(0), [](float x) { return std::asin(x); }); break;
+	case GLSLstd450Acos: floatOp(r, arg(0), [](float x) { return std::acos(x); }); break;
+	case GLSLstd450Atan: floatOp(r, arg(0), [](float x) { return std::atan(x); }); break;
+	case GLSLstd450Sinh: floatOp(r, arg(0), [](float x) { return std::sinh(x); }); break;
+	case GLSLstd450Cosh: floatOp(r, arg(0), [](float x) { return std::cosh(x); }); break;
+	case GLSLstd450Tanh: floatOp(r, arg(0), [](float x) { return std::tanh(x); }); break;
+	case GLSLstd450Asinh: floatOp(r, arg(0), [](float x) { return std::asinh(x); }); break;
+	case GLSLstd450Acosh: floatOp(r, arg(0), [](float x) { return std::acosh(x); }); break;
+	case GLSLstd450Atanh: floatOp(r, arg(0), [](float x) { return std::atanh(x); }); break;
+	case GLSLstd450Atan2: floatOp(r, arg(0), arg(1), [](float y, float x) { return std::atan2(y, x); }); break;
+	case GLSLstd450Pow: floatOp(r, arg(0), arg(1), [](float x, float y) { return std::pow(x, y); }); break;
+	case GLSLstd450Exp: floatOp(r, arg(0), [](float x) { return std::exp(x); }); break;
+	case GLSLstd450Log: floatOp(r, arg(0), [](float x) { return std::log(x); }); break;
+	case GLSLstd450Exp2: floatOp(r, arg(0), [](float x) { return std::exp2(x); }); break;
+	case GLSLstd450Log2: floatOp(r, arg(0), [](float x) { return std::log2(x); }); break;
+	case GLSLstd450Sqrt: floatOp(r, arg(0), [](float x) { return std::sqrt(x); }); break;
+	case GLSLstd450InverseSqrt: floatOp(r, arg(0), [](float x) { return 1.0f / std::sqrt(x); }); break;
+	case GLSLstd450Determinant:
+	{
+		std::vector<double> m = toDoubles(arg(0));
+		size_t n = (size_t)std::lround(std::sqrt((double)m.size()));
+		r = { fromFloat((float)determinant(m, n)) };
+		break;
+	}
+	case GLSLstd450MatrixInverse:
+	{
+		std::vector<double> m = toDoubles(arg(0));
+		size_t n = (size_t)std::lround(std::sqrt((double)m.size()));
+		std::vector<double> inv = inverse(m, n);
+		r.resize(inv.size());
+		for (size_t i = 0; i < inv.size(); i++) r[i] = fromFloat((float)inv[i]);
+		break;
+	}
+	case GLSLstd450Modf:
+	case GLSLstd450ModfStruct:
+	{
+		std::vector<uint32_t> whole;
+		floatOp(whole, arg(0), [](float x) { return std::trunc(x); });
+		floatOp(r, arg(0), [](float x) { return x - std::trunc(x); });
+		if (w[4] == GLSLstd450ModfStruct) r.insert(r.end(), whole.begin(), whole.end());
+		else if (!Write(inv, arg(1), types[typeOf[w[6]]].element, whole)) return false;
+		break;
+	}
+	case GLSLstd450Frexp:
+	case GLSLstd450FrexpStruct:
+	{
+		const std::vector<uint32_t>& x = arg(0);
+		std::vector<uint32_t> exponents(x.size());
+		r.resize(x.size());
+		for (size_t i = 0; i < x.size(); i++)
+		{
+			int e = 0;
+			r[i] = fromFloat(std::frexp(toFloat(x[i]), &e));
+			exponents[i] = (uint32_t)e;
+		}
+		if (w[4] == GLSLstd450FrexpStruct) r.insert(r.end(), exponents.begin(), exponents.end());
+		else if (!Write(inv, arg(1), types[typeOf[w[6]]].element, exponents)) return false;
+		break;
+	}
+	case GLSLstd450Ldexp:
+		binaryOp(r, arg(0), arg(1), [](uint32_t x, uint32_t e) { return fromFloat(std::ldexp(toFloat(x), (int32_t)e)); });
+		break;
+	case GLSLstd450FMin:
+	case GLSLstd450NMin:
+		floatOp(r, arg(0), arg(1), [](float x, float y) { return std::fmin(x, y); });
+		break;
+	case GLSLstd450FMax:
+	case GLSLstd450NMax:
+		floatOp(r, arg(0), arg(1), [](float x, float y) { return std::fmax(x, y); });
+		break;
+	case GLSLstd450UMin: binaryOp(r, arg(0), arg(1), [](uint32_t x, uint32_t y) { return std::min(x, y); }); break;
+	case GLSLstd450UMax: binaryOp(r, arg(0), arg(1), [](uint32_t x, uint32_t y) { return std::max(x, y); }); break;
+	case GLSLstd450SMin: binaryOp(r, arg(0), arg(1), [](uint32_t x, uint32_t y) { return (uint32_t)std::min((int32_t)x, (int32_t)y); }); break;
+	case GLSLstd450SMax: binaryOp(r, arg(0), arg(1), [](uint32_t x, uint32_t y) { return (uint32_t)std::max((int32_t)x, (int32_t)y); }); break;
+	case GLSLstd450FClamp:
+	case GLSLstd450NClamp:
+		floatOp(r, arg(0), arg(1), arg(2), [](float x, float lo, float hi) { return std::fmin(std::fmax(x, lo), hi); });
+		break;
+	case GLSLstd450UClamp:
+	case GLSLstd450SClamp:
+	{
+		const std::vector<uint32_t>& lo = arg(1);
+		const std::vector<uint32_t>& hi = arg(2);
+		bool isSigned = w[4] == GLSLstd450SClamp;
+		r = arg(0);
+		for (size_t i = 0; i < r.size() && !lo.empty() && !hi.empty(); i++)
+		{
+			uint32_t l = lo[i < lo.size() ? i : 0], h = hi[i < hi.size() ? i : 0];
+			r[i] = isSigned ? (uint32_t)std::min(std::max((int32_t)r[i], (int32_t)l), (int32_t)h) : std::min(std::max(r[i], l), h);
+		}
+		break;
+	}
+	case GLSLstd450FMix: floatOp(r, arg(0), arg(1), arg(2), [](float x, float y, float a) { return x * (1.0f - a) + y * a; }); break;
+	case GLSLstd450Step: floatOp(r, arg(1), arg(0), [](float x, float edge) { return x < edge ? 0.0f : 1.0f; }); break;
+	case GLSLstd450SmoothStep:
+		floatOp(r, arg(2), arg(0), arg(1), [](float x, float edge0, float edge1)
+			{
+				float t = std::clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+				return t * t * (3.0f - 2.0f * t);
+			});
+		break;
+	case GLSLstd450Fma: floatOp(r, arg(0), arg(1), arg(2), [](float a, float b, float c) { return a * b + c; }); break;
+	case GLSLstd450PackSnorm4x8: r = { packNorm(arg(0), 8, true) }; break;
+	case GLSLstd450PackUnorm4x8: r = { packNorm(arg(0), 8, false) }; break;
+	case GLSLstd450PackSnorm2x16: r = { packNorm(arg(0), 16, true) }; break;
+	case GLSLstd450PackUnorm2x16: r = { packNorm(arg(0), 16, false) }; break;
+	case GLSLstd450PackHalf2x16:
+	{
+		const std::vector<uint32_t>& v = arg(0);
+		r = { v.size() < 2 ? 0 : floatToHalf(toFloat(v[0])) | floatToHalf(toFloat(v[1])) << 16 };
+		break;
+	}
+	case GLSLstd450UnpackSnorm4x8: unpackNorm(arg(0).empty() ? 0 : arg(0)[0], 8, true, r); break;
+	case GLSLstd450UnpackUnorm4x8: unpackNorm(arg(0).empty() ? 0 : arg(0)[0], 8, false, r); break;
+	case GLSLstd450UnpackSnorm2x16: unpackNorm(arg(0).empty() ? 0 : arg(0)[0], 16, true, r); break;
+	case GLSLstd450UnpackUnorm2x16: unpackNorm(arg(0).empty() ? 0 : arg(0)[0], 16, false, r); break;
+	case GLSLstd450UnpackHalf2x16:
+	{
+		uint32_t v = arg(0).empty() ? 0 : arg(0)[0];
+		r = { fromFloat(halfToFloat(v & 0xFFFF)), fromFloat(halfToFloat(v >> 16)) };
+		break;
+	}
+	case GLSLstd450Length: r = { fromFloat(std::sqrt(dot(arg(0), arg(0)))) }; break;
+	case GLSLstd450Distance:
+	{
+		std::vector<uint32_t> d;
+		floatOp(d, arg(0), arg(1), [](float x, float y) { return x - y; });
+		r = { fromFloat(std::sqrt(dot(d, d))) };
+		break;
+	}
+	case GLSLstd450Cross:
+	{
+		const std::vector<uint32_t>& a = arg(0);
+		const std::vector<uint32_t>& b = arg(1);
+		if (a.size() < 3 || b.size() < 3) return false;
+		float x[3] = { toFloat(a[0]), toFloat(a[1]), toFloat(a[2]) }, y[3] = { toFloat(b[0]), toFloat(b[1]), toFloat(b[2]) };
+		r = { fromFloat(x[1] * y[2] - x[2] * y[1]), fromFloat(x[2] * y[0] - x[0] * y[2]), fromFloat(x[0] * y[1] - x[1] * y[0]) };
+		break;
+	}
+	case GLSLstd450Normalize:
+	{
+		float length = std::sqrt(dot(arg(0), arg(0)));
+		floatOp(r, arg(0), [&](float x) { return x / length; });
+		break;
+	}
+	case GLSLstd450FaceForward:
+	{
+		bool keep = dot(arg(2), arg(1)) < 0.0f;
+		floatOp(r, arg(0), [&](float x) { return keep ? x : -x; });
+		break;
+	}
+	case GLSLstd450Reflect:
+	{
+		float d = dot(arg(1), arg(0));
+		floatOp(r, arg(0), arg(1), [&](float i, float n) { return i - 2.0f * d * n; });
+		break;
+	}
+	case GLSLstd450Refract:
+	{
+		float d = dot(arg(1), arg(0)), eta = arg(2).empty() ? 1.0f : toFloat(arg(2)[0]);
+		float k = 1.0f - eta * eta * (1.0f - d * d);
+		floatOp(r, arg(0), arg(1), [&](float i, float n) { return k < 0.0f ? 0.0f : eta * i - (eta * d + std::sqrt(k)) * n; });
+		break;
+	}
+	case GLSLstd450FindILsb:
+		unaryOp(r, arg(0), [](uint32_t x)
+			{
+				if (x == 0) return 0xFFFFFFFFu;
+				uint32_t bit = 0;
+				while (((x >> bit) & 1u) == 0) bit++;
+				return bit;
+			});
+		break;
+	case GLSLstd450FindSMsb: unaryOp(r, arg(0), [](uint32_t x) { return mostSignificantBit((int32_t)x < 0 ? ~x : x); }); break;
+	case GLSLstd450FindUMsb: unaryOp(r, arg(0), [](uint32_t x) { return mostSignificantBit(x); }); break;
+	case GLSLstd450InterpolateAtCentroid:
+	case GLSLstd450InterpolateAtSample:
+	case GLSLstd450InterpolateAtOffset:
+		return Read(inv, arg(0), inst.typeId, r); // one sample per invocation
+	default:
+		return false;
+	}
+	return true;
+}
+
+#pragma endregion
+
+#pragma endregion
@@ -0,0 +1,140 @@
+#pragma once
+#include <Spirver.h>
+#include <SpirverModule.h>
+#include <deque>
+#include <map>
+#include <ostream>
+
+namespace Spirver {
+
+/// Instructions executed by one or more invocations
+struct ExecutionProfile
+{
+	uint64_t moduleHash = 0; // detail::hashBytes of the SPIR-V the label ids refer to
+	uint64_t invocations = 0;
+	uint64_t instructions = 0; // without labels, merge and line instructions
+	uint64_t killed = 0; // fragment invocations ended by discard
+	std::map<uint32_t, uint64_t> opcodeCounts; // spv::Op -> executions
+	std::map<uint32_t, uint64_t> blockCounts; // label id -> executions
+	std::map<std::pair<uint32_t, uint32_t>, uint64_t> edgeCounts; // (from, to) label ids -> branches taken
+
+	double GetInstructionsPerInvocation() const { return invocations > 0 ? (double)instructions / invocations : 0.0; }
+	void Merge(const ExecutionProfile& o);
+	/// Whether the profile was recorded for this SPIR-V
+	bool Matches(const std::vector<GLuint>& spirv) const { return moduleHash == detail::hashBytes(spirv.data(), spirv.size() * sizeof(GLuint)); }
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+};
+
+}
+
+std::ostream& operator<<(std::ostream& os, const Spirver::ExecutionProfile& p);
+
+namespace Spirver {
+
+/// Runs a vertex, fragment or compute shader on the CPU and counts what it executes.
+/// Values are 32 bit scalars, vectors, matrices, arrays and structs. Images, 64 bit types and
+/// row major buffer matrices are not supported, derivatives are 0. Unbound resources read as 0.
+class ShaderInterpreter
+{
+public:
+	ShaderInterpreter();
+	~ShaderInterpreter();
+	ShaderInterpreter(const ShaderInterpreter&) = delete;
+	ShaderInterpreter& operator=(const ShaderInterpreter&) = delete;
+
+	/// Prepare the first vertex, fragment or compute entry point of the shader, run after Optimize() for realistic counts
+	bool Load(SpirvShader& shader);
+
+	/// Values of an input for every invocation back to back, cycled if shorter than the invocation count
+	void SetInput(uint32_t location, const std::vector<uint32_t>& values) { inputs[location] = values; }
+	void SetInput(uint32_t location, const std::vector<float>& values);
+	/// Uniform outside of a block, components in declaration order
+	void SetUniform(uint32_t location, const std::vector<uint32_t>& value) { uniforms[location] = value; }
+	void SetUniform(uint32_t location, const std::vector<float>& value);
+	/// Uniform block contents in std140 layout
+	void SetUniformBuffer(uint32_t binding, const std::vector<uint32_t>& data) { uniformBuffers[binding] = data; }
+	/// Shader storage block in std430 layout, shared by all invocations and written in place.
+	/// Runs of a shader that uses a bound storage buffer are single threaded, plain loads and stores would race.
+	void SetStorageBuffer(uint32_t binding, std::vector<uint32_t>* data) { storageBuffers[binding] = data; }
+	/// Executed instructions per invocation before it is stopped as runaway
+	void SetInstructionLimit(uint64_t limit) { instructionLimit = limit; }
+
+	/// Run a vertex or fragment shader, gl_FragCoord walks a grid of the given width row by row.
+	/// threads 0 uses every hardware thread, bound storage buffers force a single one.
+	bool Run(uint32_t invocations, unsigned int threads = 0, uint32_t width = 1);
+	/// Run a compute shader over groupsX * groupsY * groupsZ workgroups
+	bool Dispatch(uint32_t groupsX, uint32_t groupsY = 1, uint32_t groupsZ = 1, unsigned int threads = 0);
+
+	/// Profile of the last Run() or Dispatch()
+	const ExecutionProfile& GetProfile() const { return profile; }
+	/// Output of every invocation back to back, discarded invocations leave zeros
+	const std::vector<uint32_t>& GetOutput(uint32_t location) const;
+	std::vector<float> GetOutputFloats(uint32_t location) const;
+	/// Output without a location, like gl_Position in gl_PerVertex, by variable id
+	const std::vector<uint32_t>& GetBuiltInOutput(uint32_t variable) const;
+
+	/// Parsed module the block ids of the profile refer to
+	const detail::SpirvModule& GetModule() const { return module; }
+	spv::ExecutionModel GetExecutionModel() const { return model; }
+	const uint32_t* GetLocalSize() const { return localSize; }
+
+	std::string GetErrors();
+
+private:
+	struct Type;
+	struct Global;
+	struct Memory;
+	struct Invocation;
+	struct Counters;
+	enum class Status { Running, Barrier, Done, Killed, Error };
+
+	detail::SpirvModule module;
+	spv::ExecutionModel model = spv::ExecutionModelVertex;
+	uint32_t entryFunction = 0, entryLabel = 0;
+	uint32_t localSize[3] = { 1, 1, 1 };
+	uint32_t glslStd450 = 0; // id of the imported GLSL.std.450 set
+	uint64_t moduleHash = 0;
+	uint64_t instructionLimit = 10000000;
+	bool loaded = false;
+	uint32_t gridWidth = 1, groupCount[3] = { 1, 1, 1 }; // of the current run
+
+	std::vector<Type> types; // by id
+	std::vector<uint32_t> typeOf; // result type by id
+	std::vector<std::vector<uint32_t>> constants; // by id, also pointers to globals
+	std::vector<bool> isConstant;
+	std::vector<Global> globals;
+	std::vector<size_t> labels; // instruction index by label id
+	std::unordered_map<uint32_t, size_t> functionIndex;
+
+	std::map<uint32_t, std::vector<uint32_t>> inputs, uniforms, uniformBuffers, outputs;
+	std::map<uint32_t, std::vector<uint32_t>*> storageBuffers;
+	std::map<uint32_t, std::vector<uint32_t>> builtInOutputs; // by variable id
+
+	ExecutionProfile profile;
+	std::stringstream errors;
+	std::mutex errorsMutex;
+
+	bool BeginRun(uint64_t invocations);
+	bool UsesStorageBuffers() const;
+	void EndRun(std::vector<Counters>& counters);
+	void Setup(Invocation& inv, uint32_t index, std::vector<std::vector<uint32_t>>* shared);
+	void Finish(Invocation& inv, Counters& counters);
+	Status Execute(Invocation& inv, Counters& counters);
+	bool ExecuteExtended(Invocation& inv, const detail::SpirvInstruction& inst, std::vector<uint32_t>& r);
+	bool Branch(Invocation& inv, uint32_t label, Counters& counters);
+	Status Error(Invocation& inv, const std::string& message);
+
+	const std::vector<uint32_t>& Value(const Invocation& inv, uint32_t id) const;
+	uint32_t Scalar(const Invocation& inv, uint32_t id) const;
+	/// Step into a member, element, column or component of a type
+	bool Element(uint32_t& type, uint32_t index, bool explicitLayout, uint64_t& offset, uint32_t& matrixStride) const;
+	/// Word offsets of every scalar component of a value in memory
+	void Layout(uint32_t type, uint64_t offset, uint32_t matrixStride, bool explicitLayout, std::vector<uint64_t>& offsets) const;
+	Memory* Resolve(Invocation& inv, const std::vector<uint32_t>& pointer);
+	bool Read(Invocation& inv, const std::vector<uint32_t>& pointer, uint32_t type, std::vector<uint32_t>& value);
+	bool Write(Invocation& inv, const std::vector<uint32_t>& pointer, uint32_t type, const std::vector<uint32_t>& value);
+};
+
+}
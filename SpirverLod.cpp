@@ -0,0 +1,797 @@
+#include <SpirverLod.h>
+#include <glslang/SPIRV/GLSL.std.450.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+
+std::ostream& operator<<(std::ostream& os, const ShaderLod& l)
+{
+	if (!l.valid) return os << "invalid" << std::endl;
+	os << "cycles: " << l.cyclesBefore << " -> " << l.cyclesAfter << std::endl;
+	os << "mathExpensive: " << l.mathExpensiveBefore << " -> " << l.mathExpensiveAfter << std::endl;
+	os << "maxError: " << l.maxError << " (" << l.rejected << " candidates rejected)" << std::endl;
+	for (const LodChange& c : l.changes) os << "  " << c.description << ", error " << c.error << std::endl;
+	return os;
+}
+
+#pragma region Editing
+
+namespace {
+
+/// New instructions of a module, applied in one pass
+struct ModuleEdit
+{
+	std::vector<SpirvInstruction> annotations; // before the first declaration
+	std::vector<SpirvInstruction> declarations; // before the first function
+	std::map<uint32_t, std::vector<SpirvInstruction>> replacements; // result id -> instructions taking the place of its definition
+};
+
+/// Emits code on a 32 bit float scalar or vector type, integer steps use an int type of the same size
+class Emitter
+{
+public:
+	std::vector<SpirvInstruction> code;
+
+	Emitter(SpirvModule& module, ModuleEdit& edit, uint32_t type) : module(module), edit(edit), type(type)
+	{
+		const SpirvInstruction* t = module.GetDefinition(type);
+		if (t != nullptr && t->opcode == spv::OpTypeVector)
+		{
+			scalar = t->words[2];
+			count = t->words[3];
+		}
+		else scalar = type;
+		const SpirvInstruction* s = module.GetDefinition(scalar);
+		valid = s != nullptr && s->opcode == spv::OpTypeFloat && s->words[2] == 32;
+
+		for (const SpirvInstruction& inst : module.instructions)
+			if (inst.opcode == spv::OpExtInstImport && inst.GetString(1) == "GLSL.std.450") glsl = inst.resultId;
+	}
+
+	bool IsValid() const { return valid && glsl != 0; }
+	bool IsVector() const { return count > 1; }
+	uint32_t GetScalarType() const { return scalar; }
+
+	uint32_t Emit(spv::Op op, uint32_t resultType, const std::vector<uint32_t>& operands)
+	{
+		uint32_t id = module.NewId();
+		code.push_back(MakeInstruction(op, resultType, id, operands));
+		return id;
+	}
+	uint32_t Op(spv::Op op, const std::vector<uint32_t>& operands) { return Emit(op, type, operands); }
+	uint32_t IntOp(spv::Op op, const std::vector<uint32_t>& operands) { return Emit(op, IntType(), operands); }
+	uint32_t Ext(GLSLstd450 instruction, const std::vector<uint32_t>& operands)
+	{
+		std::vector<uint32_t> words = { glsl, (uint32_t)instruction };
+		words.insert(words.end(), operands.begin(), operands.end());
+		return Emit(spv::OpExtInst, type, words);
+	}
+
+	uint32_t Float(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return Constant(scalar, type, bits);
+	}
+	uint32_t Int(int32_t value) { return Constant(IntScalarType(), IntType(), (uint32_t)value); }
+
+	/// Code of another emitter of the same module goes first
+	void Append(const std::vector<SpirvInstruction>& other) { code.insert(code.end(), other.begin(), other.end()); }
+	/// The code with the last result renamed to the id of the replaced definition
+	std::vector<SpirvInstruction> Finish(uint32_t resultId)
+	{
+		code.back().resultId = resultId;
+		code.back().words[2] = resultId;
+		return code;
+	}
+
+private:
+	SpirvModule& module;
+	ModuleEdit& edit;
+	uint32_t type = 0, scalar = 0, count = 1, glsl = 0;
+	bool valid = false;
+	std::map<std::pair<uint32_t, uint32_t>, uint32_t> constants; // (type, bits) -> id
+
+	uint32_t FindType(spv::Op op, const std::vector<uint32_t>& operands)
+	{
+		auto matches = [&](const SpirvInstruction& inst)
+		{
+			return inst.opcode == op && inst.words.size() == operands.size() + 2 && std::equal(operands.begin(), operands.end(), inst.words.begin() + 2);
+		};
+		for (const SpirvInstruction& inst : module.instructions) if (matches(inst)) return inst.resultId;
+		for (const SpirvInstruction& inst : edit.declarations) if (matches(inst)) return inst.resultId;
+
+		// types must be unique, so it is only declared if missing
+		uint32_t id = module.NewId();
+		edit.declarations.push_back(MakeInstruction(op, 0, id, operands));
+		return id;
+	}
+	uint32_t IntScalarType() { return FindType(spv::OpTypeInt, { 32, 1 }); }
+	uint32_t IntType() { return count > 1 ? FindType(spv::OpTypeVector, { IntScalarType(), count }) : IntScalarType(); }
+
+	uint32_t Constant(uint32_t scalarType, uint32_t resultType, uint32_t bits)
+	{
+		uint32_t& id = constants[{ resultType, bits }];
+		if (id != 0) return id;
+
+		uint32_t c = module.NewId();
+		edit.declarations.push_back(MakeInstruction(spv::OpConstant, scalarType, c, { bits }));
+		if (count > 1)
+		{
+			id = module.NewId();
+			edit.declarations.push_back(MakeInstruction(spv::OpConstantComposite, resultType, id, std::vector<uint32_t>(count, c)));
+		}
+		else id = c;
+		return id;
+	}
+};
+
+}
+
+static bool applyEdit(SpirvModule& module, const ModuleEdit& edit)
+{
+	size_t firstDeclaration = SIZE_MAX, firstFunction = module.instructions.size();
+	for (size_t i = 0; i < module.instructions.size(); i++)
+	{
+		if (module.instructions[i].opcode == spv::OpFunction) firstFunction = std::min(firstFunction, i);
+		if (IsDeclaration(module.instructions[i].opcode)) firstDeclaration = std::min(firstDeclaration, i);
+	}
+	if (firstDeclaration == SIZE_MAX) firstDeclaration = firstFunction;
+
+	std::vector<SpirvInstruction> edited;
+	edited.reserve(module.instructions.size() + edit.annotations.size() + edit.declarations.size() + edit.replacements.size() * 8);
+	for (size_t i = 0; i < module.instructions.size(); i++)
+	{
+		if (i == firstDeclaration) edited.insert(edited.end(), edit.annotations.begin(), edit.annotations.end());
+		if (i == firstFunction) edited.insert(edited.end(), edit.declarations.begin(), edit.declarations.end());
+
+		const SpirvInstruction& inst = module.instructions[i];
+		auto replacement = i > firstFunction && inst.resultId != 0 ? edit.replacements.find(inst.resultId) : edit.replacements.end();
+		if (replacement != edit.replacements.end()) edited.insert(edited.end(), replacement->second.begin(), replacement->second.end());
+		else edited.push_back(inst);
+	}
+
+	// parse again so operands and lookups cover the new instructions
+	module.instructions = std::move(edited);
+	std::vector<uint32_t> words = module.Serialize();
+	return module.Parse(words.data(), words.size());
+}
+
+static bool isFloatType(const SpirvModule& module, uint32_t type)
+{
+	const SpirvInstruction* t = module.GetDefinition(type);
+	if (t != nullptr && t->opcode == spv::OpTypeVector) t = module.GetDefinition(t->words[2]);
+	return t != nullptr && t->opcode == spv::OpTypeFloat && t->words[2] == 32;
+}
+
+#pragma endregion
+
+#pragma region Approximations
+
+// 2^x = 2^floor(x) * 2^fract(x), the integer part goes straight into the exponent bits,
+// relative error below 2e-4 on [-10, 10]
+static uint32_t fastExp2(Emitter& e, uint32_t x)
+{
+	x = e.Ext(GLSLstd450FClamp, { x, e.Float(-126.0f), e.Float(126.0f) });
+	uint32_t i = e.Ext(GLSLstd450Floor, { x });
+	uint32_t f = e.Op(spv::OpFSub, { x, i });
+	uint32_t p = e.Op(spv::OpFMul, { f, e.Float(0.0773806f) });
+	p = e.Op(spv::OpFMul, { f, e.Op(spv::OpFAdd, { p, e.Float(0.2269401f) }) });
+	p = e.Op(spv::OpFMul, { f, e.Op(spv::OpFAdd, { p, e.Float(0.6954300f) }) });
+	p = e.Op(spv::OpFAdd, { p, e.Float(1.0f) });
+	uint32_t exponent = e.IntOp(spv::OpShiftLeftLogical, { e.IntOp(spv::OpConvertFToS, { i }), e.Int(23) });
+	uint32_t bits = e.IntOp(spv::OpIAdd, { e.IntOp(spv::OpBitcast, { p }), exponent });
+	return e.Op(spv::OpBitcast, { bits });
+}
+
+// exponent bits plus a polynomial of the mantissa in [1, 2), for x > 0, absolute error below 2e-3 on [1e-3, 1e3]
+static uint32_t fastLog2(Emitter& e, uint32_t x)
+{
+	uint32_t bits = e.IntOp(spv::OpBitcast, { x });
+	uint32_t exponent = e.IntOp(spv::OpISub, { e.IntOp(spv::OpShiftRightArithmetic, { bits, e.Int(23) }), e.Int(127) });
+	uint32_t mantissa = e.IntOp(spv::OpBitwiseOr, { e.IntOp(spv::OpBitwiseAnd, { bits, e.Int(0x007FFFFF) }), e.Int(0x3F800000) });
+	uint32_t t = e.Op(spv::OpFSub, { e.Op(spv::OpBitcast, { mantissa }), e.Float(1.0f) });
+	uint32_t p = e.Op(spv::OpFMul, { t, e.Float(0.1655588f) });
+	p = e.Op(spv::OpFMul, { t, e.Op(spv::OpFAdd, { p, e.Float(-0.5877338f) }) });
+	p = e.Op(spv::OpFMul, { t, e.Op(spv::OpFAdd, { p, e.Float(1.4234853f) }) });
+	return e.Op(spv::OpFAdd, { e.Op(spv::OpConvertSToF, { exponent }), p });
+}
+
+// one period mapped to u in [-1, 1], a parabola through the zeros and extremes, then a correction,
+// absolute error below 2e-3 on [-10, 10]
+static uint32_t fastSin(Emitter& e, uint32_t x)
+{
+	uint32_t t = e.Op(spv::OpFMul, { x, e.Float(0.15915494f) });
+	uint32_t u = e.Op(spv::OpFMul, { e.Op(spv::OpFSub, { t, e.Ext(GLSLstd450Round, { t }) }), e.Float(2.0f) });
+	uint32_t y = e.Op(spv::OpFMul, { e.Op(spv::OpFMul, { u, e.Float(4.0f) }), e.Op(spv::OpFSub, { e.Float(1.0f), e.Ext(GLSLstd450FAbs, { u }) }) });
+	uint32_t c = e.Op(spv::OpFSub, { e.Op(spv::OpFMul, { y, e.Ext(GLSLstd450FAbs, { y }) }), y });
+	return e.Op(spv::OpFAdd, { e.Op(spv::OpFMul, { c, e.Float(0.225f) }), y });
+}
+
+// the bit trick estimate with one Newton step, relative error below 2e-3 on [1e-3, 1e3]
+static uint32_t fastInverseSqrt(Emitter& e, uint32_t x)
+{
+	uint32_t half = e.IntOp(spv::OpShiftRightLogical, { e.IntOp(spv::OpBitcast, { x }), e.Int(1) });
+	uint32_t y = e.Op(spv::OpBitcast, { e.IntOp(spv::OpISub, { e.Int(0x5F3759DF), half }) });
+	uint32_t xyy = e.Op(spv::OpFMul, { e.Op(spv::OpFMul, { x, y }), y });
+	return e.Op(spv::OpFMul, { y, e.Op(spv::OpFSub, { e.Float(1.5f), e.Op(spv::OpFMul, { xyy, e.Float(0.5f) }) }) });
+}
+
+static const char* approximationName(uint32_t instruction)
+{
+	switch (instruction)
+	{
+	case GLSLstd450Exp: return "exp";
+	case GLSLstd450Exp2: return "exp2";
+	case GLSLstd450Log: return "log";
+	case GLSLstd450Log2: return "log2";
+	case GLSLstd450Pow: return "pow";
+	case GLSLstd450Sin: return "sin";
+	case GLSLstd450Cos: return "cos";
+	case GLSLstd450Sqrt: return "sqrt";
+	case GLSLstd450InverseSqrt: return "inversesqrt";
+	case GLSLstd450Normalize: return "normalize";
+	default: return nullptr;
+	}
+}
+
+// replace an OpExtInst of GLSL.std.450 by its approximation, same result id
+static bool approximate(SpirvModule& module, uint32_t id)
+{
+	const SpirvInstruction* inst = module.GetDefinition(id);
+	if (inst == nullptr || inst->opcode != spv::OpExtInst || inst->words.size() < 6) return false;
+
+	ModuleEdit edit;
+	Emitter e(module, edit, inst->typeId);
+	if (!e.IsValid()) return false;
+	uint32_t x = inst->words[5], y = inst->words.size() > 6 ? inst->words[6] : 0;
+	switch (inst->words[4])
+	{
+	case GLSLstd450Exp: fastExp2(e, e.Op(spv::OpFMul, { x, e.Float(1.4426950f) })); break;
+	case GLSLstd450Exp2: fastExp2(e, x); break;
+	case GLSLstd450Log: e.Op(spv::OpFMul, { fastLog2(e, x), e.Float(0.6931472f) }); break;
+	case GLSLstd450Log2: fastLog2(e, x); break;
+	case GLSLstd450Pow: fastExp2(e, e.Op(spv::OpFMul, { y, fastLog2(e, x) })); break;
+	case GLSLstd450Sin: fastSin(e, x); break;
+	case GLSLstd450Cos: fastSin(e, e.Op(spv::OpFAdd, { x, e.Float(1.5707964f) })); break;
+	case GLSLstd450Sqrt: e.Op(spv::OpFMul, { x, fastInverseSqrt(e, x) }); break;
+	case GLSLstd450InverseSqrt: fastInverseSqrt(e, x); break;
+	case GLSLstd450Normalize:
+	{
+		// the length is computed on the scalar type
+		if (!e.IsVector()) return false;
+		Emitter s(module, edit, e.GetScalarType());
+		uint32_t r = fastInverseSqrt(s, s.Op(spv::OpDot, { x, x }));
+		e.Append(s.code);
+		e.Emit(spv::OpVectorTimesScalar, inst->typeId, { x, r });
+		break;
+	}
+	default:
+		return false;
+	}
+
+	edit.replacements[id] = e.Finish(id);
+	return applyEdit(module, edit);
+}
+
+// replace an addition or subtraction by one of its sides, same result id: a + b becomes b or a, a - b becomes -b or a
+static bool dropTerm(SpirvModule& module, uint32_t id, bool dropFirst)
+{
+	const SpirvInstruction* inst = module.GetDefinition(id);
+	if (inst == nullptr || (inst->opcode != spv::OpFAdd && inst->opcode != spv::OpFSub)) return false;
+
+	ModuleEdit edit;
+	if (!dropFirst) edit.replacements[id] = { MakeInstruction(spv::OpCopyObject, inst->typeId, id, { inst->words[3] }) };
+	else if (inst->opcode == spv::OpFAdd) edit.replacements[id] = { MakeInstruction(spv::OpCopyObject, inst->typeId, id, { inst->words[4] }) };
+	else edit.replacements[id] = { MakeInstruction(spv::OpFNegate, inst->typeId, id, { inst->words[4] }) };
+	return applyEdit(module, edit);
+}
+
+// round the relaxed results to 16 bit floats, so the interpreter shows what RelaxedPrecision may cost
+static bool quantize(SpirvModule& module, const std::set<uint32_t>& relaxed)
+{
+	ModuleEdit edit;
+	for (uint32_t id : relaxed)
+	{
+		const SpirvInstruction* inst = module.GetDefinition(id);
+		if (inst == nullptr || inst->typeId == 0) continue;
+		SpirvInstruction full = *inst;
+		full.resultId = module.NewId();
+		full.words[2] = full.resultId;
+		edit.replacements[id] = { full, MakeInstruction(spv::OpQuantizeToF16, inst->typeId, id, { full.resultId }) };
+	}
+	return applyEdit(module, edit);
+}
+
+static bool isRelaxable(spv::Op op)
+{
+	switch (op)
+	{
+	case spv::OpFAdd:
+	case spv::OpFSub:
+	case spv::OpFMul:
+	case spv::OpFDiv:
+	case spv::OpFNegate:
+	case spv::OpFMod:
+	case spv::OpFRem:
+	case spv::OpDot:
+	case spv::OpVectorTimesScalar:
+	case spv::OpMatrixTimesVector:
+	case spv::OpVectorTimesMatrix:
+	case spv::OpExtInst:
+		return true;
+	default:
+		return false;
+	}
+}
+
+#pragma endregion
+
+#pragma region Sampling
+
+namespace {
+
+/// An output of every sampled invocation
+struct OutputSlot
+{
+	bool builtIn = false; // by variable id instead of location
+	uint32_t key = 0;
+	std::vector<bool> isFloat; // per component of one invocation
+};
+
+/// Generated inputs and the outputs of the original shader
+class Sampler
+{
+public:
+	std::vector<OutputSlot> outputs;
+	std::vector<std::vector<uint32_t>> reference;
+	std::string errors;
+
+	Sampler(Stage stage, const LodOptions& options) : stage(stage), options(options) {}
+
+	void Prepare(const SpirvModule& module)
+	{
+		std::map<uint32_t, std::map<uint32_t, uint32_t>> decorations; // id -> decoration -> value
+		for (const SpirvInstruction& inst : module.instructions)
+			if (inst.opcode == spv::OpDecorate && inst.words.size() >= 3) decorations[inst.words[1]][inst.words[2]] = inst.words.size() > 3 ? inst.words[3] : 0;
+		auto decoration = [&](uint32_t id, spv::Decoration d, int64_t defaultValue) -> int64_t
+		{
+			auto it = decorations.find(id);
+			if (it == decorations.end()) return defaultValue;
+			auto v = it->second.find(d);
+			return v != it->second.end() ? v->second : defaultValue;
+		};
+
+		std::mt19937 random(options.seed);
+		std::uniform_real_distribution<float> floats(options.inputMin, options.inputMax);
+		std::uniform_int_distribution<uint32_t> ints(0, 7);
+		auto generate = [&](const std::vector<bool>& isFloat, uint32_t copies)
+		{
+			std::vector<uint32_t> values;
+			values.reserve(isFloat.size() * copies);
+			for (uint32_t c = 0; c < copies; c++)
+				for (bool f : isFloat)
+				{
+					float v = floats(random);
+					uint32_t bits;
+					std::memcpy(&bits, &v, sizeof(bits));
+					values.push_back(f ? bits : ints(random));
+				}
+			return values;
+		};
+
+		for (const SpirvInstruction& inst : module.instructions)
+		{
+			if (inst.opcode != spv::OpVariable) continue;
+			const SpirvInstruction* pointer = module.GetDefinition(inst.typeId);
+			if (pointer == nullptr) continue;
+			uint32_t type = pointer->words[3];
+			int64_t location = decoration(inst.resultId, spv::DecorationLocation, -1), binding = decoration(inst.resultId, spv::DecorationBinding, -1);
+			std::vector<bool> isFloat;
+
+			switch ((spv::StorageClass)inst.words[3])
+			{
+			case spv::StorageClassInput:
+				if (location >= 0 && flatten(module, type, isFloat)) inputs[(uint32_t)location] = generate(isFloat, options.samples);
+				break;
+			case spv::StorageClassUniformConstant:
+				if (location >= 0 && flatten(module, type, isFloat)) uniforms[(uint32_t)location] = generate(isFloat, 1);
+				break;
+			case spv::StorageClassUniform:
+				// std140 block contents as floats, members that are integers get odd values, LodOptions::setup fixes them
+				if (binding >= 0 && decoration(type, spv::DecorationBlock, -1) >= 0) uniformBuffers[(uint32_t)binding] = generate(std::vector<bool>(4096, true), 1);
+				break;
+			case spv::StorageClassOutput:
+			{
+				OutputSlot slot;
+				slot.builtIn = location < 0;
+				slot.key = slot.builtIn ? inst.resultId : (uint32_t)location;
+				if (flatten(module, type, slot.isFloat)) outputs.push_back(slot);
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	}
+
+	bool Run(const std::vector<GLuint>& spirv, std::vector<std::vector<uint32_t>>& results)
+	{
+		SpirvShader shader = SpirvShader::FromMemory(spirv, stage);
+		ShaderInterpreter interpreter;
+		if (!interpreter.Load(shader))
+		{
+			errors = interpreter.GetErrors();
+			return false;
+		}
+		for (const auto& i : inputs) interpreter.SetInput(i.first, i.second);
+		for (const auto& u : uniforms) interpreter.SetUniform(u.first, u.second);
+		for (const auto& b : uniformBuffers) interpreter.SetUniformBuffer(b.first, b.second);
+		if (options.setup) options.setup(interpreter);
+		if (!interpreter.Run(options.samples, 0, 16))
+		{
+			errors = interpreter.GetErrors();
+			return false;
+		}
+
+		results.clear();
+		for (const OutputSlot& slot : outputs) results.push_back(slot.builtIn ? interpreter.GetBuiltInOutput(slot.key) : interpreter.GetOutput(slot.key));
+		return true;
+	}
+
+	/// Largest difference to the reference, infinite for a changed integer or a new NaN or infinity
+	float Error(const std::vector<std::vector<uint32_t>>& results) const
+	{
+		float worst = 0.0f;
+		for (size_t s = 0; s < outputs.size(); s++)
+		{
+			const std::vector<uint32_t>& a = reference[s];
+			const std::vector<uint32_t>& b = results[s];
+			if (a.size() != b.size()) return INFINITY;
+			size_t components = outputs[s].isFloat.size();
+			for (size_t i = 0; i < a.size(); i++)
+			{
+				if (components > 0 && !outputs[s].isFloat[i % components])
+				{
+					if (a[i] != b[i]) return INFINITY;
+					continue;
+				}
+				float x, y;
+				std::memcpy(&x, &a[i], sizeof(x));
+				std::memcpy(&y, &b[i], sizeof(y));
+				if (!std::isfinite(x)) continue;
+				if (!std::isfinite(y)) return INFINITY;
+				worst = std::max(worst, std::fabs(x - y));
+			}
+		}
+		return worst;
+	}
+
+private:
+	Stage stage;
+	const LodOptions& options;
+	std::map<uint32_t, std::vector<uint32_t>> inputs, uniforms, uniformBuffers;
+
+	// components in the order the interpreter stores them
+	static bool flatten(const SpirvModule& module, uint32_t type, std::vector<bool>& isFloat)
+	{
+		const SpirvInstruction* t = module.GetDefinition(type);
+		if (t == nullptr) return false;
+		switch (t->opcode)
+		{
+		case spv::OpTypeFloat:
+			isFloat.push_back(true);
+			return t->words[2] == 32;
+		case spv::OpTypeInt:
+		case spv::OpTypeBool:
+			isFloat.push_back(false);
+			return true;
+		case spv::OpTypeVector:
+		case spv::OpTypeMatrix:
+		case spv::OpTypeArray:
+		{
+			uint32_t count = t->opcode == spv::OpTypeArray ? module.GetConstantValue(t->words[3], 0) : t->words[3];
+			for (uint32_t i = 0; i < count; i++)
+				if (!flatten(module, t->words[2], isFloat)) return false;
+			return count > 0;
+		}
+		case spv::OpTypeStruct:
+			for (size_t m = 2; m < t->words.size(); m++)
+				if (!flatten(module, t->words[m], isFloat)) return false;
+			return true;
+		default:
+			return false;
+		}
+	}
+};
+
+/// A change to try
+struct Candidate
+{
+	enum class Kind { Approximate, DropFirst, DropSecond, Relax } kind = Kind::Approximate;
+	uint32_t id = 0; // result id, label of the block for Relax
+	std::vector<uint32_t> results; // of the block for Relax
+	std::string description;
+};
+
+}
+
+static std::vector<Candidate> collectCandidates(const SpirvModule& module, const LodOptions& options)
+{
+	uint32_t glsl = 0;
+	for (const SpirvInstruction& inst : module.instructions)
+		if (inst.opcode == spv::OpExtInstImport && inst.GetString(1) == "GLSL.std.450") glsl = inst.resultId;
+
+	// the biggest savings first
+	std::vector<Candidate> approximations, drops, relaxations;
+	for (const SpirvFunction& function : module.functions)
+	{
+		for (const SpirvBlock& block : function.blocks)
+		{
+			Candidate relax;
+			relax.kind = Candidate::Kind::Relax;
+			relax.id = block.labelId;
+			for (size_t i = block.begin; i < block.end; i++)
+			{
+				const SpirvInstruction& inst = module.instructions[i];
+				if (inst.resultId == 0 || !isFloatType(module, inst.typeId)) continue;
+				const char* name = inst.opcode == spv::OpExtInst && inst.words[3] == glsl ? approximationName(inst.words[4]) : nullptr;
+				std::string id = "%" + std::to_string(inst.resultId);
+
+				if (options.approximateMath && name != nullptr)
+					approximations.push_back({ Candidate::Kind::Approximate, inst.resultId, {}, std::string(name) + " " + id + " approximated" });
+				if (options.dropTerms && (inst.opcode == spv::OpFAdd || inst.opcode == spv::OpFSub))
+				{
+					drops.push_back({ Candidate::Kind::DropSecond, inst.resultId, {}, "second term of " + id + " dropped" });
+					drops.push_back({ Candidate::Kind::DropFirst, inst.resultId, {}, "first term of " + id + " dropped" });
+				}
+				if (options.relaxPrecision && isRelaxable(inst.opcode)) relax.results.push_back(inst.resultId);
+			}
+			if (!relax.results.empty())
+			{
+				relax.description = "precision of " + std::to_string(relax.results.size()) + " results in block %" + std::to_string(block.labelId) + " relaxed";
+				relaxations.push_back(relax);
+			}
+		}
+	}
+
+	approximations.insert(approximations.end(), drops.begin(), drops.end());
+	approximations.insert(approximations.end(), relaxations.begin(), relaxations.end());
+	return approximations;
+}
+
+#pragma endregion
+
+#pragma region Generation
+
+ShaderLod Spirver::proc::GenerateLod(SpirvShader& shader, const LodOptions& options, const CostModel& model)
+{
+	ShaderLod lod;
+	Stage stage = shader.GetStage();
+	if (stage != Stage::Vertex && stage != Stage::Fragment)
+	{
+		errors << "LOD error: only vertex and fragment shaders can be sampled" << std::endl;
+		return lod;
+	}
+
+	SpirvShader base = shader;
+	if (!base.Optimize())
+	{
+		errors << "LOD error: " << base.GetErrors();
+		return lod;
+	}
+	SpirvModule original;
+	if (!original.Parse((const uint32_t*)base.GetSpirv().data(), base.GetSpirv().size()))
+	{
+		errors << "SPIR-V parse error!" << std::endl;
+		return lod;
+	}
+
+	Sampler sampler(stage, options);
+	sampler.Prepare(original);
+	if (!sampler.Run(base.GetSpirv(), sampler.reference))
+	{
+		errors << "LOD error: the original shader failed on the sampled inputs, LodOptions::setup can provide others" << std::endl << sampler.errors;
+		return lod;
+	}
+	lod.cyclesBefore = base.EstimateCost(model).estimatedCycles;
+	lod.mathExpensiveBefore = base.Analyze().stats[mathExpensive];
+
+	// every candidate is measured together with the ones kept before it
+	SpirvModule accepted = original;
+	std::set<uint32_t> relaxed;
+	std::vector<std::vector<uint32_t>> results;
+	for (const Candidate& c : collectCandidates(original, options))
+	{
+		SpirvModule trial = accepted;
+		std::set<uint32_t> trialRelaxed = relaxed;
+		bool applied = false;
+		switch (c.kind)
+		{
+		case Candidate::Kind::Approximate: applied = approximate(trial, c.id); break;
+		case Candidate::Kind::DropFirst: applied = dropTerm(trial, c.id, true); break;
+		case Candidate::Kind::DropSecond: applied = dropTerm(trial, c.id, false); break;
+		case Candidate::Kind::Relax:
+			trialRelaxed.insert(c.results.begin(), c.results.end());
+			applied = true;
+			break;
+		}
+		if (!applied) continue;
+
+		SpirvModule validation = trial;
+		if (!trialRelaxed.empty() && !quantize(validation, trialRelaxed)) continue;
+		std::vector<uint32_t> words = validation.Serialize();
+		float error = sampler.Run(std::vector<GLuint>(words.begin(), words.end()), results) ? sampler.Error(results) : INFINITY;
+		if (!(error <= options.maxError))
+		{
+			lod.rejected++;
+			continue;
+		}
+
+		accepted = std::move(trial);
+		relaxed = std::move(trialRelaxed);
+		lod.changes.push_back({ c.description, error });
+	}
+
+	ModuleEdit decorations;
+	for (uint32_t id : relaxed) decorations.annotations.push_back(MakeInstruction(spv::OpDecorate, 0, 0, { id, spv::DecorationRelaxedPrecision }));
+	if (!applyEdit(accepted, decorations))
+	{
+		errors << "LOD error: the edited module is invalid" << std::endl;
+		return lod;
+	}
+	std::vector<uint32_t> words = accepted.Serialize();
+	std::vector<GLuint> spirv(words.begin(), words.end());
+
+	// the optimizer removes what the changes left unused, the error is measured on what is returned
+	std::vector<GLuint> optimized = spirv;
+	if (optimizeSpirv(optimized) && sampler.Run(optimized, results) && sampler.Error(results) <= options.maxError) spirv = std::move(optimized);
+	else if (!sampler.Run(spirv, results))
+	{
+		errors << "LOD error: " << sampler.errors;
+		return lod;
+	}
+	lod.maxError = sampler.Error(results);
+
+	lod.shader = SpirvShader::FromMemory(spirv, stage);
+	lod.valid = true;
+	lod.cyclesAfter = lod.shader.EstimateCost(model).estimatedCycles;
+	lod.mathExpensiveAfter = lod.shader.Analyze().stats[mathExpensive];
+	return lod;
+}
+
+std::vector<ShaderLod> Spirver::proc::GenerateLods(SpirvShader& shader, const std::vector<float>& budgets, const LodOptions& options, const CostModel& model)
+{
+	std::vector<ShaderLod> lods;
+	for (float budget : budgets)
+	{
+		LodOptions o = options;
+		o.maxError = budget;
+		lods.push_back(GenerateLod(shader, o, model));
+	}
+	return lods;
+}
+
+#pragma endregion
+
+#pragma region Checks
+
+namespace {
+
+/// A function approximate() replaces and the bound documented at its approximation
+struct ApproximationRange
+{
+	const char* function;
+	float inputMin, inputMax;
+	bool logarithmic; // inputs spread evenly over the exponent
+	bool relative;
+	float bound;
+	double (*exact)(double);
+};
+
+const ApproximationRange approximationRanges[] = {
+	{ "sin", -10.0f, 10.0f, false, false, 2e-3f, [](double x) { return std::sin(x); } },
+	{ "exp2", -10.0f, 10.0f, false, true, 2e-4f, [](double x) { return std::exp2(x); } },
+	{ "log2", 1e-3f, 1e3f, true, false, 2e-3f, [](double x) { return std::log2(x); } },
+	{ "inversesqrt", 1e-3f, 1e3f, true, true, 2e-3f, [](double x) { return 1.0 / std::sqrt(x); } },
+};
+
+}
+
+bool Spirver::proc::CheckLodApproximations(std::vector<ApproximationCheck>* checks, uint32_t samples)
+{
+	// every function reads its own input, so each gets its own range
+	SpirvShader shader = GlslShader::FromMemory(
+		"#version 460\n"
+		"layout(location = 0) in float s;\n"
+		"layout(location = 1) in float e;\n"
+		"layout(location = 2) in float l;\n"
+		"layout(location = 3) in float r;\n"
+		"layout(location = 0) out vec4 o;\n"
+		"void main() { o = vec4(sin(s), exp2(e), log2(l), inversesqrt(r)); }\n", Stage::Fragment).ToSpirv();
+	if (shader.HasErrors())
+	{
+		errors << "LOD error: " << shader.GetErrors();
+		return false;
+	}
+
+	SpirvModule module;
+	if (!module.Parse((const uint32_t*)shader.GetSpirv().data(), shader.GetSpirv().size()))
+	{
+		errors << "SPIR-V parse error!" << std::endl;
+		return false;
+	}
+	std::vector<uint32_t> ids;
+	for (const SpirvInstruction& inst : module.instructions)
+		if (inst.opcode == spv::OpExtInst && inst.words.size() >= 6 && approximationName(inst.words[4]) != nullptr) ids.push_back(inst.resultId);
+	for (uint32_t id : ids)
+	{
+		if (!approximate(module, id))
+		{
+			errors << "LOD error: %" << id << " could not be approximated" << std::endl;
+			return false;
+		}
+	}
+
+	std::vector<uint32_t> words = module.Serialize();
+	SpirvShader approximated = SpirvShader::FromMemory(std::vector<GLuint>(words.begin(), words.end()), Stage::Fragment);
+	ShaderInterpreter interpreter;
+	if (!interpreter.Load(approximated))
+	{
+		errors << "LOD error: " << interpreter.GetErrors();
+		return false;
+	}
+
+	const size_t count = sizeof(approximationRanges) / sizeof(approximationRanges[0]);
+	std::vector<std::vector<float>> inputs(count, std::vector<float>(samples));
+	for (size_t f = 0; f < count; f++)
+	{
+		const ApproximationRange& range = approximationRanges[f];
+		for (uint32_t i = 0; i < samples; i++)
+		{
+			float t = samples > 1 ? (float)i / (samples - 1) : 0.0f;
+			inputs[f][i] = range.logarithmic ? range.inputMin * std::pow(range.inputMax / range.inputMin, t) : range.inputMin + (range.inputMax - range.inputMin) * t;
+		}
+		interpreter.SetInput((uint32_t)f, inputs[f]);
+	}
+	if (!interpreter.Run(samples, 0, 16))
+	{
+		errors << "LOD error: " << interpreter.GetErrors();
+		return false;
+	}
+
+	std::vector<float> results = interpreter.GetOutputFloats(0);
+	if (results.size() != samples * count)
+	{
+		errors << "LOD error: the check shader wrote no results" << std::endl;
+		return false;
+	}
+
+	bool success = true;
+	if (checks != nullptr) checks->clear();
+	for (size_t f = 0; f < count; f++)
+	{
+		const ApproximationRange& range = approximationRanges[f];
+		ApproximationCheck check = { range.function, range.inputMin, range.inputMax, range.relative, range.bound, 0.0f };
+		for (uint32_t i = 0; i < samples; i++)
+		{
+			double exact = range.exact(inputs[f][i]);
+			double error = std::fabs(results[i * count + f] - exact);
+			if (range.relative) error /= std::fabs(exact);
+			if (!(error <= check.error)) check.error = (float)error; // a NaN stays the worst
+		}
+		if (!(check.error <= check.bound))
+		{
+			errors << "LOD error: " << check.function << " approximation error " << check.error << " exceeds " << check.bound << std::endl;
+			success = false;
+		}
+		if (checks != nullptr) checks->push_back(check);
+	}
+	return success;
+}
+
+#pragma endregion
@@ -0,0 +1,65 @@
+#pragma once
+#include <SpirverInterpreter.h>
+#include <functional>
+
+namespace Spirver {
+
+/// Error budget and sampling of GenerateLod()
+struct LodOptions
+{
+	float maxError = 0.01f; // largest absolute difference of any output component over the samples
+	uint32_t samples = 256; // invocations run to measure the error
+	float inputMin = -1.0f, inputMax = 1.0f; // range of generated inputs, uniforms and uniform buffer contents
+	uint32_t seed = 1;
+	bool approximateMath = true; // exp, exp2, log, log2, pow, sin, cos, sqrt, inversesqrt and normalize
+	bool dropTerms = true; // additions and subtractions reduced to one side
+	bool relaxPrecision = true; // RelaxedPrecision per block, measured with the results rounded to 16 bit
+	std::function<void(ShaderInterpreter&)> setup; // runs after the generated values are set, for realistic inputs
+};
+
+/// A change GenerateLod() kept
+struct LodChange
+{
+	std::string description;
+	float error = 0.0f; // with this and every earlier change
+};
+
+/// A cheaper variant of a vertex or fragment shader within an error budget
+struct ShaderLod
+{
+	SpirvShader shader;
+	bool valid = false;
+	float maxError = 0.0f; // measured on the final binary
+	std::vector<LodChange> changes;
+	unsigned int rejected = 0; // candidates over the budget
+	double cyclesBefore = 0.0, cyclesAfter = 0.0; // CostModel estimate
+	unsigned int mathExpensiveBefore = 0, mathExpensiveAfter = 0; // ShaderStat
+};
+
+/// Measured error of one approximation GenerateLod() uses
+struct ApproximationCheck
+{
+	std::string function;
+	float inputMin = 0.0f, inputMax = 0.0f;
+	bool relative = false; // to the exact value, absolute otherwise
+	float bound = 0.0f; // documented at the approximation
+	float error = 0.0f; // largest over the samples
+};
+
+}
+
+std::ostream& operator<<(std::ostream& os, const Spirver::ShaderLod& l);
+
+namespace Spirver::proc {
+
+/// Try polynomial and bit trick approximations of expensive math, dropped terms and relaxed precision one
+/// candidate at a time, keeping those that leave every output within the budget on the sampled inputs
+ShaderLod GenerateLod(SpirvShader& shader, const LodOptions& options = LodOptions(), const CostModel& model = CostModel());
+/// One LOD per error budget
+std::vector<ShaderLod> GenerateLods(SpirvShader& shader, const std::vector<float>& budgets,
+	const LodOptions& options = LodOptions(), const CostModel& model = CostModel());
+/// Run the sin, exp2, log2 and inversesqrt approximations on the interpreter over their documented ranges,
+/// false if one exceeds its bound
+bool CheckLodApproximations(std::vector<ApproximationCheck>* checks = nullptr, uint32_t samples = 4096);
+
+}
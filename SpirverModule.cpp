@@ -0,0 +1,487 @@
+#include <SpirverModule.h>
+#include <algorithm>
+#include <unordered_set>
+
+using namespace Spirver::detail;
+
+#pragma region SpirvInstruction
+
+bool SpirvInstruction::IsIdOperand(size_t operand) const
+{
+	switch (operands[operand].type)
+	{
+	case SPV_OPERAND_TYPE_ID:
+	case SPV_OPERAND_TYPE_TYPE_ID:
+	case SPV_OPERAND_TYPE_RESULT_ID:
+	case SPV_OPERAND_TYPE_MEMORY_SEMANTICS_ID:
+	case SPV_OPERAND_TYPE_SCOPE_ID:
+		return true;
+	default:
+		return false;
+	}
+}
+
+std::string SpirvInstruction::GetString(size_t operand) const
+{
+	// literal strings are nul terminated and packed little endian
+	std::string ret;
+	const spv_parsed_operand_t& o = operands[operand];
+	for (uint16_t w = 0; w < o.num_words; w++)
+		for (int b = 0; b < 4; b++)
+		{
+			char c = (char)((words[o.offset + w] >> (b * 8)) & 0xFF);
+			if (c == '\0') return ret;
+			ret += c;
+		}
+	return ret;
+}
+
+std::vector<uint32_t> SpirvInstruction::GetUsedIds() const
+{
+	std::vector<uint32_t> ids;
+	for (size_t i = 0; i < operands.size(); i++)
+	{
+		if (!IsIdOperand(i) || operands[i].type == SPV_OPERAND_TYPE_RESULT_ID) continue;
+		if (operands[i].type == SPV_OPERAND_TYPE_TYPE_ID && typeId != 0 && operands[i].offset == 1) continue;
+		ids.push_back(GetWord(i));
+	}
+	return ids;
+}
+
+SpirvInstruction Spirver::detail::MakeInstruction(spv::Op opcode, uint32_t typeId, uint32_t resultId, const std::vector<uint32_t>& operands)
+{
+	SpirvInstruction inst;
+	inst.opcode = opcode;
+	inst.typeId = typeId;
+	inst.resultId = resultId;
+	inst.words.push_back(0);
+	if (typeId != 0) inst.words.push_back(typeId);
+	if (resultId != 0) inst.words.push_back(resultId);
+	inst.words.insert(inst.words.end(), operands.begin(), operands.end());
+	inst.words[0] = (uint32_t)inst.words.size() << 16 | opcode;
+	return inst;
+}
+
+bool Spirver::detail::IsDeclaration(spv::Op op)
+{
+	// the type and constant opcodes are contiguous
+	return (op >= spv::OpTypeVoid && op <= spv::OpTypeForwardPointer) || (op >= spv::OpConstantTrue && op <= spv::OpSpecConstantOp)
+		|| op == spv::OpVariable || op == spv::OpUndef;
+}
+
+#pragma endregion
+
+#pragma region SpirvModule
+
+static spv_result_t parseHeader(void* userData, spv_endianness_t, uint32_t magic, uint32_t version,
+	uint32_t generator, uint32_t idBound, uint32_t schema)
+{
+	SpirvModule* module = (SpirvModule*)userData;
+	module->header[0] = magic;
+	module->header[1] = version;
+	module->header[2] = generator;
+	module->header[3] = idBound;
+	module->header[4] = schema;
+	return SPV_SUCCESS;
+}
+
+static spv_result_t parseInstruction(void* userData, const spv_parsed_instruction_t* parsed)
+{
+	SpirvModule* module = (SpirvModule*)userData;
+	SpirvInstruction inst;
+	inst.opcode = (spv::Op)parsed->opcode;
+	inst.typeId = parsed->type_id;
+	inst.resultId = parsed->result_id;
+	inst.words.assign(parsed->words, parsed->words + parsed->num_words);
+	inst.operands.assign(parsed->operands, parsed->operands + parsed->num_operands);
+	module->instructions.push_back(std::move(inst));
+	return SPV_SUCCESS;
+}
+
+bool SpirvModule::Parse(const uint32_t* words, size_t count)
+{
+	instructions.clear();
+
+	spv_context context = spvContextCreate(SPV_ENV_OPENGL_4_5);
+	spv_diagnostic diagnostic = nullptr;
+	spv_result_t result = spvBinaryParse(context, this, words, count, parseHeader, parseInstruction, &diagnostic);
+	spvDiagnosticDestroy(diagnostic);
+	spvContextDestroy(context);
+
+	if (result != SPV_SUCCESS) return false;
+	Reindex();
+	return true;
+}
+
+std::vector<uint32_t> SpirvModule::Serialize() const
+{
+	std::vector<uint32_t> words(header, header + 5);
+	for (const SpirvInstruction& inst : instructions)
+		words.insert(words.end(), inst.words.begin(), inst.words.end());
+	return words;
+}
+
+void SpirvModule::Reindex()
+{
+	definitions.clear();
+	names.clear();
+	functions.clear();
+
+	for (size_t i = 0; i < instructions.size(); i++)
+	{
+		const SpirvInstruction& inst = instructions[i];
+		if (inst.resultId != 0) definitions[inst.resultId] = i;
+
+		switch (inst.opcode)
+		{
+		case spv::OpName:
+			names[inst.GetWord(0)] = inst.GetString(1);
+			break;
+		case spv::OpFunction:
+			functions.emplace_back();
+			functions.back().resultId = inst.resultId;
+			functions.back().begin = i;
+			break;
+		case spv::OpFunctionEnd:
+			if (!functions.empty()) functions.back().end = i + 1;
+			break;
+		case spv::OpLabel:
+			if (functions.empty()) break;
+			if (!functions.back().blocks.empty()) functions.back().blocks.back().end = i;
+			functions.back().blocks.emplace_back();
+			functions.back().blocks.back().labelId = inst.resultId;
+			functions.back().blocks.back().begin = i;
+			break;
+		default:
+			break;
+		}
+	}
+
+	// blocks end at the next label or the end of the function
+	for (SpirvFunction& f : functions)
+	{
+		if (!f.blocks.empty()) f.blocks.back().end = f.end - 1;
+		for (SpirvBlock& b : f.blocks)
+		{
+			const SpirvInstruction& terminator = instructions[b.end - 1];
+			switch (terminator.opcode)
+			{
+			case spv::OpBranch:
+				b.successors.push_back(terminator.GetWord(0));
+				break;
+			case spv::OpBranchConditional:
+				b.successors.push_back(terminator.GetWord(1));
+				b.successors.push_back(terminator.GetWord(2));
+				break;
+			case spv::OpSwitch:
+				for (size_t o = 1; o < terminator.operands.size(); o++)
+					if (terminator.IsIdOperand(o)) b.successors.push_back(terminator.GetWord(o));
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+const SpirvInstruction* SpirvModule::GetDefinition(uint32_t id) const
+{
+	auto it = definitions.find(id);
+	return it != definitions.end() ? &instructions[it->second] : nullptr;
+}
+
+std::string SpirvModule::GetName(uint32_t id) const
+{
+	auto it = names.find(id);
+	return it != names.end() ? it->second : "%" + std::to_string(id);
+}
+
+unsigned int SpirvModule::GetComponentCount(uint32_t typeId) const
+{
+	const SpirvInstruction* type = GetDefinition(typeId);
+	if (type == nullptr) return 0;
+
+	switch (type->opcode)
+	{
+	case spv::OpTypeBool:
+		return 1;
+	case spv::OpTypeInt:
+	case spv::OpTypeFloat:
+		return type->GetWord(1) > 32 ? type->GetWord(1) / 32 : 1;
+	case spv::OpTypeVector:
+	case spv::OpTypeMatrix:
+		return type->GetWord(2) * GetComponentCount(type->GetWord(1));
+	case spv::OpTypeArray:
+		return GetConstantValue(type->GetWord(2), 1) * GetComponentCount(type->GetWord(1));
+	case spv::OpTypeStruct:
+	{
+		unsigned int count = 0;
+		for (size_t o = 1; o < type->operands.size(); o++) count += GetComponentCount(type->GetWord(o));
+		return count;
+	}
+	case spv::OpTypeVoid:
+	case spv::OpTypeFunction:
+		return 0;
+	default:
+		return 1; // pointers, images, samplers: one address or descriptor
+	}
+}
+
+uint32_t SpirvModule::GetConstantValue(uint32_t id, uint32_t defaultValue) const
+{
+	const SpirvInstruction* c = GetDefinition(id);
+	if (c == nullptr || c->opcode != spv::OpConstant) return defaultValue;
+	return c->GetWord(2);
+}
+
+#pragma endregion
+
+#pragma region Canonical hash
+
+namespace {
+
+uint64_t mix(uint64_t hash, uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+uint64_t mixSorted(uint64_t hash, std::vector<uint64_t>& values)
+{
+	std::sort(values.begin(), values.end());
+	hash = mix(hash, values.size());
+	for (uint64_t v : values) hash = mix(hash, v);
+	return hash;
+}
+
+bool isDebugInstruction(spv::Op op)
+{
+	switch (op)
+	{
+	case spv::OpName:
+	case spv::OpMemberName:
+	case spv::OpString:
+	case spv::OpLine:
+	case spv::OpNoLine:
+	case spv::OpSource:
+	case spv::OpSourceContinued:
+	case spv::OpSourceExtension:
+	case spv::OpModuleProcessed:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/// Structural hashes of ids: globals by their definition, function locals by position
+class CanonicalHasher
+{
+public:
+	CanonicalHasher(const SpirvModule& module) : module(module)
+	{
+		for (const SpirvFunction& f : module.functions) functions[f.resultId] = &f;
+
+		// decorations become part of the hash of their target
+		for (const SpirvInstruction& inst : module.instructions)
+		{
+			if (inst.opcode == spv::OpDecorate || inst.opcode == spv::OpMemberDecorate || inst.opcode == spv::OpDecorateId)
+				decorations[inst.GetWord(0)].push_back(&inst);
+			else if (inst.opcode == spv::OpVariable && !InFunction(inst))
+				globals.insert(inst.resultId);
+		}
+
+		// globals of the same type and decorations differ only by where they are used
+		std::unordered_set<uint32_t> visited;
+		for (const SpirvInstruction& inst : module.instructions)
+			if (inst.opcode == spv::OpEntryPoint) OrderGlobals(inst.GetWord(1), visited);
+	}
+
+	uint64_t HashModule()
+	{
+		std::vector<uint64_t> capabilities, extensions, entryPoints, executionModes, variables;
+		uint64_t hash = mix(14695981039346656037ull, module.header[1]); // version
+
+		for (const SpirvInstruction& inst : module.instructions)
+		{
+			switch (inst.opcode)
+			{
+			case spv::OpCapability:
+				capabilities.push_back(inst.GetWord(0));
+				break;
+			case spv::OpExtension:
+				extensions.push_back(HashLiteral(0, inst, 0));
+				break;
+			case spv::OpMemoryModel:
+				hash = mix(mix(hash, inst.GetWord(0)), inst.GetWord(1));
+				break;
+			case spv::OpEntryPoint:
+			{
+				uint64_t h = mix(HashLiteral(mix(0, inst.GetWord(0)), inst, 2), HashId(inst.GetWord(1)));
+				std::vector<uint64_t> interface;
+				for (size_t o = 3; o < inst.operands.size(); o++) interface.push_back(HashId(inst.GetWord(o)));
+				entryPoints.push_back(mixSorted(h, interface));
+				break;
+			}
+			case spv::OpExecutionMode:
+			{
+				uint64_t h = HashId(inst.GetWord(0));
+				for (size_t o = 1; o < inst.operands.size(); o++) h = HashLiteral(h, inst, o);
+				executionModes.push_back(h);
+				break;
+			}
+			case spv::OpVariable:
+				// globals are visible to the API even when unused
+				if (inst.typeId != 0 && module.GetDefinition(inst.resultId) == &inst && !InFunction(inst)) variables.push_back(HashId(inst.resultId));
+				break;
+			default:
+				break;
+			}
+		}
+
+		hash = mixSorted(hash, capabilities);
+		hash = mixSorted(hash, extensions);
+		hash = mixSorted(hash, entryPoints);
+		hash = mixSorted(hash, executionModes);
+		return mixSorted(hash, variables);
+	}
+
+private:
+	const SpirvModule& module;
+	std::unordered_map<uint32_t, const SpirvFunction*> functions;
+	std::unordered_map<uint32_t, std::vector<const SpirvInstruction*>> decorations;
+	std::unordered_set<uint32_t> globals; // variables outside functions
+	std::unordered_map<uint32_t, uint64_t> globalOrder; // global -> order of first use from the entry points
+	std::unordered_map<uint32_t, uint64_t> hashes;
+	std::unordered_map<uint32_t, bool> visiting;
+
+	bool InFunction(const SpirvInstruction& inst) const
+	{
+		size_t index = &inst - module.instructions.data();
+		for (const SpirvFunction& f : module.functions)
+			if (index >= f.begin && index < f.end) return true;
+		return false;
+	}
+
+	static uint64_t HashLiteral(uint64_t hash, const SpirvInstruction& inst, size_t operand)
+	{
+		const spv_parsed_operand_t& o = inst.operands[operand];
+		for (uint16_t w = 0; w < o.num_words; w++) hash = mix(hash, inst.words[o.offset + w]);
+		return hash;
+	}
+
+	// calls are followed where they are made, so the order does not depend on id numbers
+	void OrderGlobals(uint32_t function, std::unordered_set<uint32_t>& visited)
+	{
+		auto f = functions.find(function);
+		if (f == functions.end() || !visited.insert(function).second) return;
+		for (size_t i = f->second->begin; i < f->second->end; i++)
+		{
+			for (uint32_t id : module.instructions[i].GetUsedIds())
+			{
+				if (functions.count(id) != 0) OrderGlobals(id, visited);
+				else if (globals.count(id) != 0 && globalOrder.count(id) == 0) globalOrder[id] = globalOrder.size();
+			}
+		}
+	}
+
+	uint64_t HashDecorations(uint64_t hash, uint32_t id)
+	{
+		auto it = decorations.find(id);
+		if (it == decorations.end()) return hash;
+
+		std::vector<uint64_t> sorted;
+		for (const SpirvInstruction* inst : it->second)
+		{
+			// the target is skipped, other ids of OpDecorateId are hashed by their definition
+			uint64_t h = mix(14695981039346656037ull, inst->opcode);
+			for (size_t o = 1; o < inst->operands.size(); o++)
+				h = inst->IsIdOperand(o) ? mix(h, HashId(inst->GetWord(o))) : HashLiteral(h, *inst, o);
+			sorted.push_back(h);
+		}
+		return mixSorted(hash, sorted);
+	}
+
+	uint64_t HashId(uint32_t id)
+	{
+		auto memo = hashes.find(id);
+		if (memo != hashes.end()) return memo->second;
+
+		const SpirvInstruction* def = module.GetDefinition(id);
+		if (def == nullptr) return mix(0, id);
+		if (visiting[id]) return mix(0, def->opcode); // forward pointers refer back to their struct
+		visiting[id] = true;
+
+		uint64_t h;
+		auto function = functions.find(id);
+		if (function != functions.end()) h = HashFunction(*function->second);
+		else
+		{
+			h = mix(14695981039346656037ull, def->opcode);
+			if (def->typeId != 0) h = mix(h, HashId(def->typeId));
+			for (size_t o = 0; o < def->operands.size(); o++)
+			{
+				const spv_parsed_operand_t& op = def->operands[o];
+				if (op.type == SPV_OPERAND_TYPE_RESULT_ID || (op.type == SPV_OPERAND_TYPE_TYPE_ID && def->typeId != 0 && op.offset == 1)) continue;
+				h = def->IsIdOperand(o) ? mix(h, HashId(def->GetWord(o))) : HashLiteral(h, *def, o);
+			}
+			if (globals.count(id) != 0)
+			{
+				auto order = globalOrder.find(id);
+				h = mix(h, order != globalOrder.end() ? order->second : ~0ull); // unused globals are interchangeable
+			}
+		}
+		h = HashDecorations(h, id);
+
+		visiting[id] = false;
+		hashes[id] = h;
+		return h;
+	}
+
+	uint64_t HashFunction(const SpirvFunction& f)
+	{
+		// locals are numbered in order of definition, so renumbering does not change the hash
+		std::unordered_map<uint32_t, uint64_t> locals;
+		for (size_t i = f.begin; i < f.end; i++)
+			if (module.instructions[i].resultId != 0 && i != f.begin) locals[module.instructions[i].resultId] = locals.size();
+
+		const SpirvInstruction& def = module.instructions[f.begin];
+		uint64_t h = mix(mix(14695981039346656037ull, def.GetWord(2)), HashId(def.GetWord(3))); // control, type
+		for (size_t i = f.begin + 1; i < f.end; i++)
+		{
+			const SpirvInstruction& inst = module.instructions[i];
+			if (isDebugInstruction(inst.opcode)) continue;
+
+			h = mix(h, inst.opcode);
+			if (inst.typeId != 0) h = mix(h, HashId(inst.typeId));
+			for (size_t o = 0; o < inst.operands.size(); o++)
+			{
+				const spv_parsed_operand_t& op = inst.operands[o];
+				if (op.type == SPV_OPERAND_TYPE_RESULT_ID || (op.type == SPV_OPERAND_TYPE_TYPE_ID && inst.typeId != 0 && op.offset == 1)) continue;
+				if (!inst.IsIdOperand(o))
+				{
+					h = HashLiteral(h, inst, o);
+					continue;
+				}
+
+				auto local = locals.find(inst.GetWord(o));
+				h = local != locals.end() ? mix(mix(h, 'L'), local->second) : mix(h, HashId(inst.GetWord(o)));
+			}
+			if (inst.resultId != 0) h = HashDecorations(h, inst.resultId);
+		}
+		return h;
+	}
+};
+
+}
+
+uint64_t SpirvModule::GetCanonicalHash() const
+{
+	CanonicalHasher hasher(*this);
+	return hasher.HashModule();
+}
+
+#pragma endregion
@@ -0,0 +1,80 @@
+#pragma once
+#include <spirv-tools/libspirv.h>
+#include <glslang/SPIRV/spirv.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace Spirver::detail
+{
+
+/// A single parsed SPIR-V instruction
+struct SpirvInstruction
+{
+	spv::Op opcode = spv::OpNop;
+	uint32_t typeId = 0;
+	uint32_t resultId = 0;
+	std::vector<uint32_t> words; // including the opcode word
+	std::vector<spv_parsed_operand_t> operands;
+
+	uint32_t GetWord(size_t operand) const { return words[operands[operand].offset]; }
+	bool IsIdOperand(size_t operand) const;
+	std::string GetString(size_t operand) const;
+	/// Ids read by this instruction, without the result and result type
+	std::vector<uint32_t> GetUsedIds() const;
+};
+
+/// Instruction to insert into a module, operands are filled in when the module is parsed again
+SpirvInstruction MakeInstruction(spv::Op opcode, uint32_t typeId, uint32_t resultId, const std::vector<uint32_t>& operands);
+/// Types, constants and global variables
+bool IsDeclaration(spv::Op op);
+
+/// Instructions from an OpLabel to the terminator of the block
+struct SpirvBlock
+{
+	uint32_t labelId = 0;
+	size_t begin = 0, end = 0; // instruction indices, end is exclusive
+	std::vector<uint32_t> successors; // label ids
+};
+
+/// Instructions from an OpFunction to its OpFunctionEnd
+struct SpirvFunction
+{
+	uint32_t resultId = 0;
+	size_t begin = 0, end = 0; // instruction indices, end is exclusive
+	std::vector<SpirvBlock> blocks;
+};
+
+/// SPIR-V binary split into instructions, functions and blocks
+class SpirvModule
+{
+public:
+	uint32_t header[5] = { 0 }; // magic, version, generator, bound, schema
+	std::vector<SpirvInstruction> instructions;
+	std::vector<SpirvFunction> functions;
+
+	bool Parse(const uint32_t* words, size_t count);
+	std::vector<uint32_t> Serialize() const;
+	/// Rebuild functions, blocks and lookups after editing instructions
+	void Reindex();
+
+	const SpirvInstruction* GetDefinition(uint32_t id) const;
+	std::string GetName(uint32_t id) const;
+	/// Number of 32 bit scalar components a value of the type occupies
+	unsigned int GetComponentCount(uint32_t typeId) const;
+	/// Value of an integer OpConstant, or defaultValue if id is not one
+	uint32_t GetConstantValue(uint32_t id, uint32_t defaultValue = 0) const;
+
+	/// Hash that ignores id numbering, debug instructions and the order of declarations
+	uint64_t GetCanonicalHash() const;
+
+	uint32_t GetIdBound() const { return header[3]; }
+	uint32_t NewId() { return header[3]++; }
+
+private:
+	std::unordered_map<uint32_t, size_t> definitions; // result id -> instruction index
+	std::unordered_map<uint32_t, std::string> names;
+};
+
+}
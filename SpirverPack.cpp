@@ -0,0 +1,348 @@
+#include <SpirverPack.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Spirver;
+using namespace Spirver::detail;
+using namespace Spirver::proc;
+
+// length prefixed, nul padded to whole words
+static void appendString(std::vector<uint32_t>& meta, const std::string& s)
+{
+	meta.push_back((uint32_t)s.size());
+	size_t begin = meta.size();
+	meta.resize(begin + (s.size() + 3) / 4, 0);
+	std::memcpy(meta.data() + begin, s.data(), s.size());
+}
+
+static bool readString(const uint32_t*& p, const uint32_t* end, std::string& s)
+{
+	if (p >= end) return false;
+	uint32_t length = *p++;
+	uint32_t words = (length + 3) / 4;
+	if ((size_t)(end - p) < words) return false;
+	s.assign((const char*)p, length);
+	p += words;
+	return true;
+}
+
+// count elements of size bytes at offset fit the mapping, written so a crafted offset cannot wrap around
+static bool inBounds(uint64_t offset, uint64_t count, uint64_t size, uint64_t alignment, size_t mappingSize)
+{
+	return offset % alignment == 0 && offset <= mappingSize && count <= (mappingSize - offset) / size;
+}
+
+#pragma region SpirvShaderView
+
+bool SpirvShaderView::Compile(GLuint id) const
+{
+	return spirvBinaryToShader(data, size, id, {}); // no constants to specialize
+}
+
+SpirvShader SpirvShaderView::ToShader() const
+{
+	return SpirvShader::FromMemory(std::vector<GLuint>(data, data + size), stage);
+}
+
+#pragma endregion
+
+#pragma region ShaderPackBuilder
+
+bool ShaderPackBuilder::Add(const std::string& name, SpirvShader& shader, bool analyze)
+{
+	Item item;
+	item.name = name;
+	item.hash = hashString(name);
+	item.stage = shader.GetStage();
+	item.spirv = shader.GetSpirv();
+
+	appendString(item.meta, name);
+
+	if (analyze)
+	{
+		ShaderStat stat = shader.Analyze();
+		item.meta.push_back(shaderStatTypesCount);
+		item.meta.insert(item.meta.end(), stat.stats, stat.stats + shaderStatTypesCount);
+		item.meta.push_back(791);
+		item.meta.insert(item.meta.end(), stat.opCounts, stat.opCounts + 791);
+	}
+	else
+	{
+		item.meta.push_back(0);
+		item.meta.push_back(0);
+	}
+
+	std::vector<ReflectedResource> resources = shader.Reflect();
+	item.meta.push_back((uint32_t)resources.size());
+	for (const ReflectedResource& r : resources)
+	{
+		item.meta.push_back((uint32_t)r.kind);
+		item.meta.push_back((uint32_t)r.properties.location);
+		item.meta.push_back((uint32_t)r.properties.binding);
+		appendString(item.meta, r.name);
+	}
+
+	items.push_back(std::move(item));
+	return true;
+}
+
+bool ShaderPackBuilder::Write(const std::string& path)
+{
+	std::sort(items.begin(), items.end(), [](const Item& a, const Item& b)
+		{
+			return a.hash != b.hash ? a.hash < b.hash : a.name < b.name;
+		});
+	for (size_t i = 1; i < items.size(); i++)
+		if (items[i].name == items[i - 1].name)
+		{
+			errors << "Shader pack error: duplicate name " << items[i].name << std::endl;
+			return false;
+		}
+
+	auto align = [](uint64_t offset) { return (offset + packAlignment - 1) / packAlignment * packAlignment; };
+
+	// offsets first, so the index can be written in one go
+	std::vector<PackEntry> index(items.size());
+	uint64_t offset = align(sizeof(PackHeader) + items.size() * sizeof(PackEntry));
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		index[i] = PackEntry{ items[i].hash, offset, 0, (uint32_t)items[i].spirv.size(), (uint32_t)items[i].meta.size(),
+			(uint32_t)StageToInt(items[i].stage), 0 };
+		offset = align(offset + items[i].spirv.size() * sizeof(GLuint));
+	}
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		index[i].metaOffset = offset;
+		offset += items[i].meta.size() * sizeof(uint32_t);
+	}
+
+	PackHeader header = { { 'S', 'P', 'V', 'K' }, packVersion, (uint32_t)items.size(), packByteOrder, sizeof(PackHeader), offset };
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		errors << "Shader pack error: cannot open " << path << std::endl;
+		return false;
+	}
+
+	const char zeros[packAlignment] = { 0 };
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)index.data(), index.size() * sizeof(PackEntry));
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		file.write(zeros, index[i].spirvOffset - (uint64_t)file.tellp());
+		file.write((const char*)items[i].spirv.data(), items[i].spirv.size() * sizeof(GLuint));
+	}
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		file.write(zeros, index[i].metaOffset - (uint64_t)file.tellp());
+		file.write((const char*)items[i].meta.data(), items[i].meta.size() * sizeof(uint32_t));
+	}
+
+	bool success = file.good();
+	file.close();
+	return success;
+}
+
+std::string ShaderPackBuilder::GetErrors()
+{
+	std::string ret = errors.str();
+	errors = std::stringstream();
+	return ret;
+}
+
+#pragma endregion
+
+#pragma region ShaderPack
+
+bool ShaderPack::Open(const std::string& path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		errors << "Shader pack error: cannot open " << path << std::endl;
+		return false;
+	}
+	LARGE_INTEGER size;
+	HANDLE map = GetFileSizeEx(file, &size) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	if (map == nullptr)
+	{
+		errors << "Shader pack error: cannot map " << path << std::endl;
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	mappingHandle = map;
+	mappingSize = (size_t)size.QuadPart;
+	mapping = (const unsigned char*)MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		errors << "Shader pack error: cannot open " << path << std::endl;
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		errors << "Shader pack error: " << path << " is not a valid pack" << std::endl;
+		close(fd);
+		return false;
+	}
+	mappingSize = (size_t)st.st_size;
+	void* m = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file alive
+	mapping = m != MAP_FAILED ? (const unsigned char*)m : nullptr;
+#endif
+
+	if (mapping == nullptr)
+	{
+		errors << "Shader pack error: cannot map " << path << std::endl;
+		Close();
+		return false;
+	}
+
+	// validate the header and index before handing out pointers into them
+	const PackHeader* header = (const PackHeader*)mapping;
+	if (mappingSize >= sizeof(PackHeader) && std::memcmp(header->magic, "SPVK", 4) == 0 && header->byteOrder == 0x04030201)
+	{
+		errors << "Shader pack error: " << path << " was written with the other byte order" << std::endl;
+		Close();
+		return false;
+	}
+	if (mappingSize < sizeof(PackHeader) || std::memcmp(header->magic, "SPVK", 4) != 0 || header->version != packVersion
+		|| header->byteOrder != packByteOrder || header->fileSize != mappingSize
+		|| !inBounds(header->indexOffset, header->entryCount, sizeof(PackEntry), alignof(PackEntry), mappingSize))
+	{
+		errors << "Shader pack error: " << path << " is not a valid pack" << std::endl;
+		Close();
+		return false;
+	}
+
+	entries = (const PackEntry*)(mapping + header->indexOffset);
+	entryCount = header->entryCount;
+	return true;
+}
+
+std::string ShaderPack::GetErrors()
+{
+	std::string ret = errors.str();
+	errors = std::stringstream();
+	return ret;
+}
+
+void ShaderPack::Close()
+{
+#ifdef _WIN32
+	if (mapping != nullptr) UnmapViewOfFile(mapping);
+	if (mappingHandle != nullptr) CloseHandle((HANDLE)mappingHandle);
+	if (fileHandle != nullptr) CloseHandle((HANDLE)fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (mapping != nullptr) munmap((void*)mapping, mappingSize);
+#endif
+	mapping = nullptr;
+	mappingSize = 0;
+	entries = nullptr;
+	entryCount = 0;
+}
+
+const PackEntry* ShaderPack::Find(uint64_t hash) const
+{
+	const PackEntry* end = entries + entryCount;
+	const PackEntry* it = std::lower_bound(entries, end, hash, [](const PackEntry& e, uint64_t h) { return e.hash < h; });
+	return it != end && it->hash == hash ? it : nullptr;
+}
+
+const PackEntry* ShaderPack::Find(const std::string& name) const
+{
+	const PackEntry* end = entries + entryCount;
+	for (const PackEntry* it = Find(hashString(name)); it != nullptr && it != end && it->hash == hashString(name); it++)
+		if (GetName(it) == name) return it;
+	return nullptr;
+}
+
+SpirvShaderView ShaderPack::GetShader(const PackEntry* entry) const
+{
+	if (entry == nullptr || !inBounds(entry->spirvOffset, entry->spirvWords, sizeof(GLuint), sizeof(GLuint), mappingSize)) return SpirvShaderView();
+	return SpirvShaderView((const GLuint*)(mapping + entry->spirvOffset), entry->spirvWords, StageToSpirver((int)entry->stage));
+}
+
+const uint32_t* ShaderPack::GetMeta(const PackEntry* entry) const
+{
+	if (entry == nullptr || !inBounds(entry->metaOffset, entry->metaSize, sizeof(uint32_t), sizeof(uint32_t), mappingSize)) return nullptr;
+	return (const uint32_t*)(mapping + entry->metaOffset);
+}
+
+std::string ShaderPack::GetName(const PackEntry* entry) const
+{
+	const uint32_t* p = GetMeta(entry);
+	std::string name;
+	if (p != nullptr) readString(p, p + entry->metaSize, name);
+	return name;
+}
+
+bool ShaderPack::GetStat(const PackEntry* entry, ShaderStat& stat) const
+{
+	const uint32_t* p = GetMeta(entry);
+	if (p == nullptr) return false;
+	const uint32_t* end = p + entry->metaSize;
+
+	std::string name;
+	if (!readString(p, end, name) || p >= end) return false;
+
+	uint32_t statCount = *p++;
+	if (statCount != shaderStatTypesCount || end - p < shaderStatTypesCount + 1) return false; // not analyzed
+	std::copy(p, p + shaderStatTypesCount, stat.stats);
+	p += shaderStatTypesCount;
+
+	uint32_t opCount = *p++;
+	if (opCount != 791 || end - p < 791) return false;
+	std::copy(p, p + 791, stat.opCounts);
+	return true;
+}
+
+bool ShaderPack::GetReflection(const PackEntry* entry, std::vector<ReflectedResource>& resources) const
+{
+	const uint32_t* p = GetMeta(entry);
+	if (p == nullptr) return false;
+	const uint32_t* end = p + entry->metaSize;
+
+	std::string name;
+	if (!readString(p, end, name) || p >= end) return false;
+	uint32_t statCount = *p++;
+	if ((size_t)(end - p) < statCount + 1) return false;
+	p += statCount;
+	uint32_t opCount = *p++;
+	if ((size_t)(end - p) < opCount + 1) return false;
+	p += opCount;
+
+	uint32_t resourceCount = *p++;
+	for (uint32_t i = 0; i < resourceCount; i++)
+	{
+		if (end - p < 3) return false;
+		ReflectedResource r;
+		r.kind = (ResourceKind)p[0];
+		r.properties.location = (int)p[1];
+		r.properties.binding = (int)p[2];
+		p += 3;
+		if (!readString(p, end, r.name)) return false;
+		resources.push_back(r);
+	}
+	return true;
+}
+
+#pragma endregion
@@ -0,0 +1,141 @@
+#pragma once
+#include <Spirver.h>
+
+/// Many SPIR-V shaders in one memory mapped file
+namespace Spirver {
+
+#pragma region Format
+
+// Layout: PackHeader | PackEntry[entryCount] sorted by hash | SPIR-V payloads | metadata blocks.
+// Payloads are 16 byte aligned. A metadata block holds the name, the ShaderStat and the
+// reflected resources of its entry. All values are in the native byte order of the writer,
+// packs written on a machine of the other byte order are rejected.
+
+struct PackHeader
+{
+	char magic[4]; // "SPVK"
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t byteOrder; // packByteOrder as written by the builder
+	uint64_t indexOffset;
+	uint64_t fileSize;
+};
+
+struct PackEntry
+{
+	uint64_t hash; // detail::hashString of the name
+	uint64_t spirvOffset;
+	uint64_t metaOffset;
+	uint32_t spirvWords;
+	uint32_t metaSize;
+	uint32_t stage;
+	uint32_t reserved;
+};
+
+inline const uint32_t packVersion = 2;
+inline const uint32_t packByteOrder = 0x01020304;
+inline const uint32_t packAlignment = 16;
+
+#pragma endregion
+
+#pragma region SpirvShaderView
+
+/// SPIR-V words inside a pack, valid while the pack is open
+class SpirvShaderView
+{
+public:
+	SpirvShaderView() {}
+	SpirvShaderView(const GLuint* data, size_t size, Stage stage) : data(data), size(size), stage(stage) {}
+
+	const GLuint* Data() const { return data; }
+	size_t Size() const { return size; }
+	Stage GetStage() const { return stage; }
+	bool IsValid() const { return data != nullptr; }
+
+	/// Load the binary straight from the mapped memory
+	bool Compile(GLuint shader) const;
+	/// Copy into a SpirvShader that can be optimized and converted
+	SpirvShader ToShader() const;
+
+private:
+	const GLuint* data = nullptr;
+	size_t size = 0;
+	Stage stage = Stage::Vertex;
+};
+
+#pragma endregion
+
+#pragma region ShaderPackBuilder
+
+/// Collects shaders and writes them as a pack
+class ShaderPackBuilder
+{
+public:
+	/// Add a shader, analyze stores its ShaderStat as well
+	bool Add(const std::string& name, SpirvShader& shader, bool analyze = true);
+	bool Write(const std::string& path);
+
+	size_t Size() const { return items.size(); }
+	std::string GetErrors();
+
+private:
+	struct Item
+	{
+		std::string name;
+		uint64_t hash;
+		Stage stage;
+		std::vector<GLuint> spirv;
+		std::vector<uint32_t> meta;
+	};
+	std::vector<Item> items;
+	std::stringstream errors;
+};
+
+#pragma endregion
+
+#pragma region ShaderPack
+
+/// Read only, memory mapped pack, lookups are binary searches over the index
+class ShaderPack
+{
+public:
+	ShaderPack() {}
+	ShaderPack(const ShaderPack&) = delete;
+	ShaderPack& operator=(const ShaderPack&) = delete;
+	~ShaderPack() { Close(); }
+
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const { return mapping != nullptr; }
+	std::string GetErrors();
+
+	size_t Size() const { return entryCount; }
+	const PackEntry* GetEntry(size_t i) const { return entries + i; }
+	/// Entry with the given name, nullptr if there is none
+	const PackEntry* Find(const std::string& name) const;
+	/// First entry with the given hash, nullptr if there is none
+	const PackEntry* Find(uint64_t hash) const;
+
+	SpirvShaderView GetShader(const PackEntry* entry) const;
+	SpirvShaderView GetShader(const std::string& name) const { return GetShader(Find(name)); }
+	std::string GetName(const PackEntry* entry) const;
+	bool GetStat(const PackEntry* entry, ShaderStat& stat) const;
+	bool GetReflection(const PackEntry* entry, std::vector<ReflectedResource>& resources) const;
+
+private:
+	const unsigned char* mapping = nullptr;
+	size_t mappingSize = 0;
+	const PackEntry* entries = nullptr;
+	size_t entryCount = 0;
+	std::stringstream errors;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+
+	const uint32_t* GetMeta(const PackEntry* entry) const;
+};
+
+#pragma endregion
+
+}
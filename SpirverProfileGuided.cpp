@@ -0,0 +1,247 @@
+#include <SpirverProfileGuided.h>
+#include <algorithm>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+
+std::ostream& operator<<(std::ostream& os, const PgoReport& r)
+{
+	os << "cycles: " << r.cyclesBefore << " -> " << r.cyclesAfter << " (" << r.cyclesAfter - r.cyclesBefore << ")" << std::endl;
+	os << "bytes: " << r.bytesBefore << " -> " << r.bytesAfter << std::endl;
+	for (const ProfileDecision& d : r.decisions)
+	{
+		os << "  " << (d.loop ? "loop %" : "branch %") << d.block << " ";
+		if (d.loop)
+		{
+			if (d.control & spv::LoopControlUnrollMask)
+			{
+				os << "unroll";
+				if (d.unrollFactor > 0) os << " x" << d.unrollFactor;
+			}
+			else if (d.control & spv::LoopControlDontUnrollMask) os << "dont_unroll";
+			else os << "keep";
+			os << " (" << d.share * 100.0 << "% of blocks, " << d.bias << " iterations)" << (d.applied ? "" : " skipped") << std::endl;
+		}
+		else
+		{
+			if (d.control & spv::SelectionControlFlattenMask) os << "flatten";
+			else if (d.control & spv::SelectionControlDontFlattenMask) os << "dont_flatten";
+			else os << "keep";
+			os << " (" << d.share * 100.0 << "% of blocks, " << d.bias * 100.0 << "% one side)" << (d.applied ? "" : " skipped") << std::endl;
+		}
+	}
+	return os;
+}
+
+#pragma region Decisions
+
+static uint64_t countOf(const std::map<uint32_t, uint64_t>& counts, uint32_t label)
+{
+	auto it = counts.find(label);
+	return it != counts.end() ? it->second : 0;
+}
+
+// instructions of the blocks laid out from start up to the first of the stop blocks after it,
+// structured control flow keeps the blocks of a construct between its header and merge block
+static size_t constructInstructions(const SpirvFunction& function, const std::map<uint32_t, size_t>& index,
+	uint32_t start, std::initializer_list<uint32_t> stops)
+{
+	auto begin = index.find(start);
+	if (begin == index.end()) return 0;
+	size_t end = function.blocks.size();
+	for (uint32_t stop : stops)
+	{
+		auto it = index.find(stop);
+		if (it != index.end() && it->second >= begin->second) end = std::min(end, it->second);
+	}
+
+	size_t instructions = 0;
+	for (size_t i = begin->second; i < end; i++) instructions += function.blocks[i].end - function.blocks[i].begin;
+	return instructions;
+}
+
+std::vector<ProfileDecision> Spirver::detail::DecideControlHints(const SpirvModule& module, const ExecutionProfile& profile, const PgoOptions& options)
+{
+	std::vector<ProfileDecision> decisions;
+	uint64_t total = 0;
+	for (const auto& b : profile.blockCounts) total += b.second;
+	if (total == 0) return decisions;
+
+	for (const SpirvFunction& function : module.functions)
+	{
+		std::map<uint32_t, size_t> index;
+		for (size_t i = 0; i < function.blocks.size(); i++) index[function.blocks[i].labelId] = i;
+
+		for (size_t i = 0; i < function.blocks.size(); i++)
+		{
+			const SpirvBlock& block = function.blocks[i];
+			if (block.end - block.begin < 2) continue;
+			const SpirvInstruction& merge = module.instructions[block.end - 2];
+			const SpirvInstruction& terminator = module.instructions[block.end - 1];
+			uint64_t count = countOf(profile.blockCounts, block.labelId);
+			if (count == 0) continue; // never reached, nothing to go by
+
+			ProfileDecision d;
+			d.block = block.labelId;
+			if (merge.opcode == spv::OpLoopMerge)
+			{
+				// hints written in the source win over the profile
+				if (merge.GetWord(2) & (spv::LoopControlUnrollMask | spv::LoopControlDontUnrollMask)) continue;
+
+				uint32_t mergeLabel = merge.GetWord(0);
+				auto end = index.find(mergeLabel);
+				size_t last = end != index.end() && end->second > i ? end->second : i + 1;
+				uint64_t executions = 0, entries = 0;
+				size_t instructions = 0;
+				for (size_t j = i; j < last; j++)
+				{
+					executions += countOf(profile.blockCounts, function.blocks[j].labelId);
+					instructions += function.blocks[j].end - function.blocks[j].begin;
+				}
+
+				// entries come over edges from outside the loop, or leave through the merge block
+				for (const auto& e : profile.edgeCounts)
+				{
+					if (e.first.second != block.labelId) continue;
+					auto from = index.find(e.first.first);
+					if (from == index.end() || from->second < i || from->second >= last) entries += e.second;
+				}
+				if (entries == 0) entries = countOf(profile.blockCounts, mergeLabel);
+				if (entries == 0) entries = 1;
+
+				d.loop = true;
+				d.share = (double)executions / total;
+				d.bias = (double)count / entries;
+				if (d.share < options.hotShare) d.control = spv::LoopControlDontUnrollMask;
+				else if (d.bias <= options.unrollTrips && d.bias * instructions <= options.unrollInstructions) d.control = spv::LoopControlUnrollMask;
+				else if (options.partialFactor > 1 && instructions * options.partialFactor <= options.unrollInstructions)
+				{
+					d.control = spv::LoopControlUnrollMask;
+					d.unrollFactor = options.partialFactor;
+				}
+				else d.control = spv::LoopControlMaskNone;
+				decisions.push_back(d);
+			}
+			else if (merge.opcode == spv::OpSelectionMerge && terminator.opcode == spv::OpBranchConditional)
+			{
+				if (merge.GetWord(1) & (spv::SelectionControlFlattenMask | spv::SelectionControlDontFlattenMask)) continue;
+
+				uint32_t mergeLabel = merge.GetWord(0), t = terminator.GetWord(1), f = terminator.GetWord(2);
+				if (t == f) continue;
+
+				// a side that jumps straight to the merge block shares its count with other predecessors
+				uint64_t taken = 0, notTaken = 0;
+				auto te = profile.edgeCounts.find({ block.labelId, t }), fe = profile.edgeCounts.find({ block.labelId, f });
+				if (te != profile.edgeCounts.end() || fe != profile.edgeCounts.end())
+				{
+					taken = te != profile.edgeCounts.end() ? te->second : 0;
+					notTaken = fe != profile.edgeCounts.end() ? fe->second : 0;
+				}
+				else if (t != mergeLabel)
+				{
+					taken = std::min(count, countOf(profile.blockCounts, t));
+					notTaken = f != mergeLabel ? countOf(profile.blockCounts, f) : count - taken;
+				}
+				else
+				{
+					notTaken = std::min(count, countOf(profile.blockCounts, f));
+					taken = count - notTaken;
+				}
+				if (taken + notTaken == 0) continue;
+
+				size_t sides = std::max(t != mergeLabel ? constructInstructions(function, index, t, { f, mergeLabel }) : 0,
+					f != mergeLabel ? constructInstructions(function, index, f, { t, mergeLabel }) : 0);
+
+				d.share = (double)count / total;
+				d.bias = (double)std::max(taken, notTaken) / (taken + notTaken);
+				if (d.bias >= options.branchBias) d.control = spv::SelectionControlDontFlattenMask;
+				else if (d.share >= options.hotShare && sides <= options.flattenInstructions) d.control = spv::SelectionControlFlattenMask;
+				else d.control = spv::SelectionControlMaskNone;
+				decisions.push_back(d);
+			}
+		}
+	}
+	return decisions;
+}
+
+size_t Spirver::detail::ApplyControlHints(SpirvModule& module, std::vector<ProfileDecision>& decisions, bool partial)
+{
+	std::map<uint32_t, ProfileDecision*> byBlock;
+	for (ProfileDecision& d : decisions)
+	{
+		if (d.loop && (d.unrollFactor > 0) != partial) continue;
+		if (!d.loop && partial) continue;
+		byBlock[d.block] = &d;
+	}
+
+	size_t applied = 0;
+	for (const SpirvFunction& function : module.functions)
+	{
+		for (const SpirvBlock& block : function.blocks)
+		{
+			auto it = byBlock.find(block.labelId);
+			if (it == byBlock.end() || block.end - block.begin < 2) continue;
+
+			SpirvInstruction& merge = module.instructions[block.end - 2];
+			if (merge.opcode == spv::OpLoopMerge && it->second->loop)
+			{
+				uint32_t& control = merge.words[merge.operands[2].offset];
+				control = (control & ~(uint32_t)(spv::LoopControlUnrollMask | spv::LoopControlDontUnrollMask)) | it->second->control;
+				it->second->applied = true;
+				applied++;
+			}
+			else if (merge.opcode == spv::OpSelectionMerge && !it->second->loop)
+			{
+				uint32_t& control = merge.words[merge.operands[1].offset];
+				control = (control & ~(uint32_t)(spv::SelectionControlFlattenMask | spv::SelectionControlDontFlattenMask)) | it->second->control;
+				it->second->applied = true;
+				applied++;
+			}
+		}
+	}
+	return applied;
+}
+
+#pragma endregion
+
+#pragma region Optimization
+
+bool Spirver::proc::optimizeSpirvWithProfile(std::vector<GLuint>& spirv, const ExecutionProfile& profile, const PgoOptions& options, PgoReport* report)
+{
+	if (!profile.Matches(spirv))
+	{
+		errors << "PGO error: the profile was recorded for a different module" << std::endl;
+		return false;
+	}
+
+	SpirvModule module;
+	if (!module.Parse((const uint32_t*)spirv.data(), spirv.size()))
+	{
+		errors << "SPIR-V parse error!" << std::endl;
+		return false;
+	}
+
+	// the full unroll of spirvOpt only touches loops with the unroll hint
+	std::vector<ProfileDecision> decisions = DecideControlHints(module, profile, options);
+	ApplyControlHints(module, decisions, false);
+	std::vector<uint32_t> words = module.Serialize();
+	spirv.assign(words.begin(), words.end());
+	if (!optimizeSpirv(spirv)) return false;
+
+	// loops to unroll by a factor get their hint once the full unroll is done, labels of the
+	// entry function keep their ids, loops inlined from other functions are not found again.
+	// Loops that were meant to unroll fully but could not are unrolled by the factor as well.
+	bool partial = std::any_of(decisions.begin(), decisions.end(), [](const ProfileDecision& d) { return d.unrollFactor > 0; });
+	if (partial && module.Parse((const uint32_t*)spirv.data(), spirv.size()) && ApplyControlHints(module, decisions, true) > 0)
+	{
+		words = module.Serialize();
+		spirv.assign(words.begin(), words.end());
+		InitSpirvUnrollOpt(options.partialFactor);
+		if (!spirvUnrollOpt->Run(spirv.data(), spirv.size(), &spirv)) return false;
+	}
+
+	if (report != nullptr) report->decisions = std::move(decisions);
+	return true;
+}
+
+#pragma endregion
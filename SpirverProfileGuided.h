@@ -0,0 +1,26 @@
+#pragma once
+#include <SpirverInterpreter.h>
+
+std::ostream& operator<<(std::ostream& os, const Spirver::PgoReport& r);
+
+namespace Spirver::proc {
+
+/// Optimize SPIR-V with loop and selection control hints derived from a profile of that SPIR-V.
+/// Loops unrolled by a factor are unrolled after optimizeSpirv(), so they are not also unrolled fully.
+bool optimizeSpirvWithProfile(std::vector<GLuint>& spirv, const ExecutionProfile& profile,
+	const PgoOptions& options = PgoOptions(), PgoReport* report = nullptr);
+
+}
+
+namespace Spirver::detail
+{
+
+/// Decide the unroll and flatten hints of every loop and selection the profile reached,
+/// the decisions with an unroll factor are not applied
+std::vector<ProfileDecision> DecideControlHints(const SpirvModule& module, const ExecutionProfile& profile, const PgoOptions& options);
+
+/// Set the loop or selection control of the merge instructions in the decided headers and mark those decisions applied,
+/// returns how many were found
+size_t ApplyControlHints(SpirvModule& module, std::vector<ProfileDecision>& decisions, bool partial);
+
+}
@@ -0,0 +1,249 @@
+#include <SpirverProgramCache.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace Spirver;
+using namespace Spirver::detail;
+using namespace Spirver::proc;
+
+namespace fs = std::filesystem;
+
+static long processId()
+{
+#ifdef _WIN32
+	return (long)_getpid();
+#else
+	return (long)getpid();
+#endif
+}
+
+static std::string glString(GLenum name)
+{
+	const GLubyte* s = glGetString(name);
+	return s != nullptr ? std::string((const char*)s) : std::string();
+}
+
+ProgramBinaryCache::ProgramBinaryCache(const std::string& directory) : directory(directory)
+{
+	// a driver update changes the strings, so its binaries get new keys
+	std::string driverId = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+	driver = hashString(driverId);
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	supported = formats > 0;
+
+	std::error_code ec;
+	fs::create_directories(directory, ec);
+}
+
+// any other offset basis than the one of hashBytes
+static const uint64_t checkSeed = 0x9e3779b97f4a7c15ull;
+
+static void hashBoth(const void* data, size_t size, ProgramBinaryKey& key)
+{
+	key.hash = hashBytes(data, size, key.hash);
+	key.check = hashBytes(data, size, key.check);
+	key.length += size;
+}
+
+ProgramBinaryKey ProgramBinaryCache::GetKey(const std::vector<ProgramStage>& stages) const
+{
+	ProgramBinaryKey key = { driver, hashBytes(&driver, sizeof(driver), checkSeed), 0 };
+	for (const ProgramStage& s : stages)
+	{
+		int stage = StageToInt(s.shader->GetStage());
+		const std::vector<GLuint>& spirv = s.shader->GetSpirv();
+		uint64_t size = spirv.size();
+		hashBoth(&stage, sizeof(stage), key);
+		hashBoth(&size, sizeof(size), key);
+		hashBoth(spirv.data(), spirv.size() * sizeof(GLuint), key);
+		for (const SpecializationConstant& c : s.constants) hashBoth(&c, sizeof(c), key);
+	}
+	return key;
+}
+
+std::string ProgramBinaryCache::GetPath(uint64_t hash) const
+{
+	std::stringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+	return (fs::path(directory) / name.str()).string();
+}
+
+bool ProgramBinaryCache::Load(GLuint program, const std::vector<ProgramStage>& stages)
+{
+	if (!supported) return Build(program, stages);
+
+	ProgramBinaryKey key = GetKey(stages);
+	if (Restore(program, key))
+	{
+		hits++;
+		return true;
+	}
+
+	misses++;
+	if (!Build(program, stages)) return false;
+	Store(program, key);
+	return true;
+}
+
+bool ProgramBinaryCache::ReadEntry(const std::string& path, ProgramBinaryHeader& header, std::vector<char>& binary) const
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open() || !file.read((char*)&header, sizeof(header))) return false;
+	if (std::memcmp(header.magic, "SPVB", 4) != 0 || header.version != programBinaryVersion) return false;
+
+	// a truncated or padded file is a miss, and a damaged size must not decide how much is allocated
+	std::streamoff start = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff remaining = file.tellg() - start;
+	if (remaining != (std::streamoff)header.size) return false;
+	file.seekg(start);
+
+	binary.resize(header.size);
+	if (!file.read(binary.data(), binary.size())) return false;
+	return hashBytes(binary.data(), binary.size()) == header.checksum;
+}
+
+bool ProgramBinaryCache::Restore(GLuint program, const ProgramBinaryKey& key)
+{
+	std::string path = GetPath(key.hash);
+	std::error_code ec;
+	if (!fs::exists(path, ec)) return false;
+
+	ProgramBinaryHeader header;
+	std::vector<char> binary;
+	if (!ReadEntry(path, header, binary) || header.key.hash != key.hash || header.driver != driver)
+	{
+		errors << "Program binary cache: evicting corrupt entry " << path << std::endl;
+		Evict(path);
+		return false;
+	}
+
+	// another program with the same hash, a miss whose Store() replaces the entry
+	if (header.key.check != key.check || header.key.length != key.length) return false;
+
+	// the driver may still reject it, for example after an update that kept the version string
+	glProgramBinary(program, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE)
+	{
+		Evict(path);
+		return false;
+	}
+	return true;
+}
+
+bool ProgramBinaryCache::Build(GLuint program, const std::vector<ProgramStage>& stages)
+{
+	bool success = true;
+	std::vector<GLuint> shaders;
+	for (const ProgramStage& s : stages)
+	{
+		GLuint shader = glCreateShader(StageToGlsl(s.shader->GetStage()));
+		if (!s.shader->Compile(shader, s.constants))
+		{
+			errors << s.shader->GetErrors();
+			success = false;
+		}
+		glAttachShader(program, shader);
+		shaders.push_back(shader);
+	}
+
+	if (success)
+	{
+		if (supported) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(program);
+		success = printLog(program, LogType::Program);
+		if (!success) errors << Spirver::proc::GetErrors();
+	}
+
+	for (GLuint shader : shaders)
+	{
+		glDetachShader(program, shader);
+		glDeleteShader(shader);
+	}
+	return success;
+}
+
+void ProgramBinaryCache::Store(GLuint program, const ProgramBinaryKey& key)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &format, binary.data());
+	binary.resize(written);
+
+	ProgramBinaryHeader header = { { 'S', 'P', 'V', 'B' }, programBinaryVersion, key, driver,
+		hashBytes(binary.data(), binary.size()), (uint32_t)format, (uint32_t)binary.size() };
+
+	// written next to the entry and renamed, so a crash or a parallel reader never sees half of it
+	std::string path = GetPath(key.hash);
+	std::stringstream temp;
+	temp << path << "." << processId() << "." << std::hex << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp"; // one per writer
+	std::ofstream file(temp.str(), std::ios::binary);
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), binary.size());
+	file.close();
+
+	std::error_code ec;
+	if (file.good()) fs::rename(temp.str(), path, ec);
+	if (!file.good() || ec)
+	{
+		errors << "Program binary cache: cannot write " << path << std::endl;
+		fs::remove(temp.str(), ec);
+	}
+}
+
+void ProgramBinaryCache::Evict(const std::string& path)
+{
+	std::error_code ec;
+	if (fs::remove(path, ec)) evictions++;
+}
+
+size_t ProgramBinaryCache::Prune()
+{
+	std::vector<std::string> stale;
+	std::error_code ec;
+	for (const fs::directory_entry& entry : fs::directory_iterator(directory, ec))
+	{
+		if (entry.path().extension() != ".bin") continue;
+		ProgramBinaryHeader header;
+		std::vector<char> binary;
+		if (!ReadEntry(entry.path().string(), header, binary) || header.driver != driver) stale.push_back(entry.path().string());
+	}
+
+	size_t before = evictions;
+	for (const std::string& path : stale) Evict(path);
+	return evictions - before;
+}
+
+void ProgramBinaryCache::Clear()
+{
+	std::vector<std::string> entries;
+	std::error_code ec;
+	for (const fs::directory_entry& entry : fs::directory_iterator(directory, ec))
+		if (entry.path().extension() == ".bin") entries.push_back(entry.path().string());
+	for (const std::string& path : entries) Evict(path);
+}
+
+std::string ProgramBinaryCache::GetErrors()
+{
+	std::string ret = errors.str();
+	errors = std::stringstream();
+	return ret;
+}
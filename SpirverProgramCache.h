@@ -0,0 +1,71 @@
+#pragma once
+#include <Spirver.h>
+
+namespace Spirver {
+
+/// One stage of a program restored or built by ProgramBinaryCache
+struct ProgramStage
+{
+	SpirvShader* shader;
+	std::vector<SpecializationConstant> constants;
+};
+
+/// Identifies the stages of a program, hash names the entry and the rest tells its collisions apart
+struct ProgramBinaryKey
+{
+	uint64_t hash;
+	uint64_t check; // the same input hashed with another seed
+	uint64_t length; // bytes of SPIR-V and specialization constants
+};
+
+/// Header of a cache entry, followed by the glGetProgramBinary output
+struct ProgramBinaryHeader
+{
+	char magic[4]; // "SPVB"
+	uint32_t version;
+	ProgramBinaryKey key;
+	uint64_t driver; // hash of the vendor, renderer and version strings
+	uint64_t checksum; // of the binary
+	uint32_t format;
+	uint32_t size;
+};
+
+inline const uint32_t programBinaryVersion = 2;
+
+/// glGetProgramBinary results in a directory, keyed by the SPIR-V and specialization of every stage and by the driver.
+/// Needs a current context, drivers without program binary formats always take the full compile.
+class ProgramBinaryCache
+{
+public:
+	ProgramBinaryCache(const std::string& directory);
+
+	/// Restore the program from its cached binary, or compile and link the stages and cache the result.
+	/// program comes from glCreateProgram and has no shaders attached.
+	bool Load(GLuint program, const std::vector<ProgramStage>& stages);
+
+	/// Delete entries of other drivers and entries that cannot be read
+	size_t Prune();
+	void Clear();
+
+	size_t GetHits() const { return hits; }
+	size_t GetMisses() const { return misses; }
+	size_t GetEvictions() const { return evictions; }
+	std::string GetErrors();
+
+private:
+	std::string directory;
+	uint64_t driver = 0;
+	bool supported = false;
+	size_t hits = 0, misses = 0, evictions = 0;
+	std::stringstream errors;
+
+	ProgramBinaryKey GetKey(const std::vector<ProgramStage>& stages) const;
+	std::string GetPath(uint64_t hash) const;
+	bool Restore(GLuint program, const ProgramBinaryKey& key);
+	bool Build(GLuint program, const std::vector<ProgramStage>& stages);
+	void Store(GLuint program, const ProgramBinaryKey& key);
+	bool ReadEntry(const std::string& path, ProgramBinaryHeader& header, std::vector<char>& binary) const;
+	void Evict(const std::string& path);
+};
+
+}
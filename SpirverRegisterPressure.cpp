@@ -0,0 +1,141 @@
+#include <SpirverRegisterPressure.h>
+#include <unordered_set>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+
+std::ostream& operator<<(std::ostream& os, const RegisterPressure& p)
+{
+	os << "peakComponents: " << p.peakComponents << std::endl;
+	os << "peakFunction: " << p.peakFunctionName << std::endl;
+	os << "peakBlock: %" << p.peakBlock << std::endl;
+	os << "peakInstruction: " << p.peakInstruction << std::endl;
+	return os;
+}
+
+RegisterPressure Spirver::detail::AnalyzeRegisterPressure(const SpirvModule& module)
+{
+	RegisterPressure ret;
+
+	for (const SpirvFunction& f : module.functions)
+	{
+		size_t n = f.blocks.size();
+		if (n == 0) continue; // declaration only
+
+		// components of every value defined in this function
+		std::unordered_map<uint32_t, unsigned int> weights;
+		for (size_t i = f.begin; i < f.end; i++)
+		{
+			const SpirvInstruction& inst = module.instructions[i];
+			if (inst.resultId == 0 || inst.typeId == 0 || inst.opcode == spv::OpFunction) continue;
+
+			unsigned int w;
+			if (inst.opcode == spv::OpVariable) // the pointee lives in registers
+			{
+				const SpirvInstruction* pointer = module.GetDefinition(inst.typeId);
+				w = pointer != nullptr ? module.GetComponentCount(pointer->GetWord(2)) : 1;
+			}
+			else w = module.GetComponentCount(inst.typeId);
+			if (w > 0) weights[inst.resultId] = w;
+		}
+
+		std::unordered_map<uint32_t, size_t> blockIndex;
+		for (size_t b = 0; b < n; b++) blockIndex[f.blocks[b].labelId] = b;
+
+		// upward exposed uses and definitions, phi operands belong to the predecessor
+		std::vector<std::unordered_set<uint32_t>> uses(n), defs(n), liveIn(n), liveOut(n);
+		std::vector<std::unordered_map<uint32_t, std::vector<uint32_t>>> phiUses(n); // predecessor label -> values
+		for (size_t b = 0; b < n; b++)
+			for (size_t i = f.blocks[b].begin; i < f.blocks[b].end; i++)
+			{
+				const SpirvInstruction& inst = module.instructions[i];
+				if (inst.opcode == spv::OpPhi)
+				{
+					for (size_t o = 2; o + 1 < inst.operands.size(); o += 2)
+						if (weights.count(inst.GetWord(o))) phiUses[b][inst.GetWord(o + 1)].push_back(inst.GetWord(o));
+				}
+				else
+				{
+					for (uint32_t id : inst.GetUsedIds())
+						if (weights.count(id) && !defs[b].count(id)) uses[b].insert(id);
+				}
+				if (weights.count(inst.resultId)) defs[b].insert(inst.resultId);
+			}
+
+		// backward dataflow, the sets only grow so comparing sizes is enough
+		for (bool changed = true; changed; )
+		{
+			changed = false;
+			for (size_t b = n; b-- > 0; )
+			{
+				std::unordered_set<uint32_t> out;
+				for (uint32_t s : f.blocks[b].successors)
+				{
+					auto it = blockIndex.find(s);
+					if (it == blockIndex.end()) continue;
+					out.insert(liveIn[it->second].begin(), liveIn[it->second].end());
+					auto phi = phiUses[it->second].find(f.blocks[b].labelId);
+					if (phi != phiUses[it->second].end()) out.insert(phi->second.begin(), phi->second.end());
+				}
+
+				std::unordered_set<uint32_t> in = uses[b];
+				for (uint32_t id : out)
+					if (!defs[b].count(id)) in.insert(id);
+
+				if (in.size() != liveIn[b].size() || out.size() != liveOut[b].size()) changed = true;
+				liveIn[b] = std::move(in);
+				liveOut[b] = std::move(out);
+			}
+		}
+
+		// walk every block backwards from its live out set
+		for (size_t b = 0; b < n; b++)
+		{
+			const SpirvBlock& block = f.blocks[b];
+			std::unordered_set<uint32_t> live = liveOut[b];
+			unsigned int pressure = 0;
+			for (uint32_t id : live) pressure += weights[id];
+
+			unsigned int blockPeak = pressure;
+			size_t peakAt = block.end - 1;
+			for (size_t i = block.end; i-- > block.begin; )
+			{
+				const SpirvInstruction& inst = module.instructions[i];
+
+				// a result occupies registers where it is defined, even if it is never read
+				auto w = weights.find(inst.resultId);
+				unsigned int here = pressure;
+				if (w != weights.end() && !live.count(inst.resultId)) here += w->second;
+				if (here > blockPeak)
+				{
+					blockPeak = here;
+					peakAt = i;
+				}
+
+				if (w != weights.end() && live.erase(inst.resultId)) pressure -= w->second;
+				if (inst.opcode == spv::OpPhi) continue;
+				for (uint32_t id : inst.GetUsedIds())
+				{
+					auto u = weights.find(id);
+					if (u != weights.end() && live.insert(id).second) pressure += u->second;
+				}
+			}
+
+			unsigned int in = 0;
+			for (uint32_t id : liveIn[b]) in += weights[id];
+			ret.liveIn[block.labelId] = in;
+			ret.blockPeaks[block.labelId] = blockPeak;
+
+			if (blockPeak > ret.peakComponents)
+			{
+				ret.peakComponents = blockPeak;
+				ret.peakFunction = f.resultId;
+				ret.peakFunctionName = module.GetName(f.resultId);
+				ret.peakBlock = block.labelId;
+				ret.peakInstruction = peakAt;
+			}
+		}
+	}
+
+	return ret;
+}
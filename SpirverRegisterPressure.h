@@ -0,0 +1,30 @@
+#pragma once
+#include <SpirverModule.h>
+#include <map>
+#include <ostream>
+
+namespace Spirver {
+
+/// Most scalar components simultaneously live, and where that happens
+struct RegisterPressure
+{
+	unsigned int peakComponents = 0; // vectors and matrices count once per component
+	uint32_t peakFunction = 0; // id of the function containing the peak
+	uint32_t peakBlock = 0; // label id of the block containing the peak
+	size_t peakInstruction = 0; // index of the instruction in the module
+	std::string peakFunctionName;
+	std::map<uint32_t, unsigned int> blockPeaks; // label id -> peak inside the block
+	std::map<uint32_t, unsigned int> liveIn; // label id -> components live on entry
+};
+
+}
+
+std::ostream& operator<<(std::ostream& os, const Spirver::RegisterPressure& p);
+
+namespace Spirver::detail
+{
+
+/// Per block liveness of function local values, weighted by component count
+RegisterPressure AnalyzeRegisterPressure(const SpirvModule& module);
+
+}
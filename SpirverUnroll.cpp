@@ -0,0 +1,268 @@
+#include <SpirverUnroll.h>
+#include <algorithm>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+
+std::ostream& operator<<(std::ostream& os, const UnrollReport& r)
+{
+	os << "bytes: " << r.bytesBefore << " -> " << r.bytesAfter << std::endl;
+	for (const LoopUnroll& l : r.loops)
+	{
+		os << "  loop " << l.index << " %" << l.header << ": ";
+		if (l.tripCount > 0) os << l.tripCount << " iterations, ";
+		else os << "unknown iterations, ";
+		os << l.bodyInstructions << " instructions, x" << l.factor << std::endl;
+	}
+	return os;
+}
+
+#pragma region Loops
+
+std::vector<SpirvLoop> Spirver::detail::FindLoops(const SpirvModule& module)
+{
+	std::vector<SpirvLoop> loops;
+	for (size_t f = 0; f < module.functions.size(); f++)
+	{
+		const SpirvFunction& function = module.functions[f];
+		std::unordered_map<uint32_t, size_t> index;
+		for (size_t i = 0; i < function.blocks.size(); i++) index[function.blocks[i].labelId] = i;
+
+		for (size_t i = 0; i < function.blocks.size(); i++)
+		{
+			const SpirvBlock& block = function.blocks[i];
+			if (block.end - block.begin < 2 || module.instructions[block.end - 2].opcode != spv::OpLoopMerge) continue;
+			const SpirvInstruction& merge = module.instructions[block.end - 2];
+
+			SpirvLoop loop;
+			loop.header = block.labelId;
+			loop.merge = merge.GetWord(0);
+			loop.continueTarget = merge.GetWord(1);
+			loop.control = merge.GetWord(2);
+			loop.function = f;
+			loop.first = i;
+			auto end = index.find(loop.merge);
+			loop.last = end != index.end() && end->second > i ? end->second : i + 1;
+			loops.push_back(loop);
+		}
+	}
+	return loops;
+}
+
+unsigned int Spirver::detail::GetLoopInstructions(const SpirvModule& module, const SpirvLoop& loop)
+{
+	const SpirvFunction& function = module.functions[loop.function];
+	size_t instructions = 0;
+	for (size_t i = loop.first; i < loop.last; i++) instructions += function.blocks[i].end - function.blocks[i].begin;
+	return (unsigned int)instructions;
+}
+
+static bool getConstant(const SpirvModule& module, uint32_t id, int64_t& value)
+{
+	const SpirvInstruction* c = module.GetDefinition(id);
+	if (c == nullptr || c->opcode != spv::OpConstant) return false;
+	value = (int32_t)c->GetWord(2);
+	return true;
+}
+
+static bool compareCounter(spv::Op op, int64_t a, int64_t b, bool& result)
+{
+	uint32_t ua = (uint32_t)a, ub = (uint32_t)b;
+	switch (op)
+	{
+	case spv::OpSLessThan: result = a < b; break;
+	case spv::OpSLessThanEqual: result = a <= b; break;
+	case spv::OpSGreaterThan: result = a > b; break;
+	case spv::OpSGreaterThanEqual: result = a >= b; break;
+	case spv::OpULessThan: result = ua < ub; break;
+	case spv::OpULessThanEqual: result = ua <= ub; break;
+	case spv::OpUGreaterThan: result = ua > ub; break;
+	case spv::OpUGreaterThanEqual: result = ua >= ub; break;
+	case spv::OpIEqual: result = ua == ub; break;
+	case spv::OpINotEqual: result = ua != ub; break;
+	default: return false;
+	}
+	return true;
+}
+
+unsigned int Spirver::detail::GetTripCount(const SpirvModule& module, const SpirvLoop& loop, unsigned int limit)
+{
+	const SpirvFunction& function = module.functions[loop.function];
+
+	// the test leaves to the merge block, glslang puts it in the header or the block after it
+	const SpirvInstruction* test = nullptr;
+	bool exitOnTrue = false;
+	for (size_t i = loop.first; i < std::min(loop.first + 2, loop.last) && test == nullptr; i++)
+	{
+		const SpirvInstruction& t = module.instructions[function.blocks[i].end - 1];
+		if (t.opcode != spv::OpBranchConditional) continue;
+		if (t.GetWord(1) == loop.merge) { test = &t; exitOnTrue = true; }
+		else if (t.GetWord(2) == loop.merge) test = &t;
+	}
+	if (test == nullptr) return 0;
+	const SpirvInstruction* compare = module.GetDefinition(test->GetWord(0));
+	if (compare == nullptr || compare->words.size() < 5) return 0;
+
+	// one side is a phi of the header, the other a constant bound
+	const SpirvBlock& header = function.blocks[loop.first];
+	auto isCounter = [&](uint32_t id)
+	{
+		const SpirvInstruction* d = module.GetDefinition(id);
+		return d != nullptr && d->opcode == spv::OpPhi && d >= &module.instructions[header.begin] && d < &module.instructions[header.end];
+	};
+	uint32_t a = compare->words[3], b = compare->words[4];
+	bool counterLeft = isCounter(a);
+	int64_t bound = 0;
+	if (counterLeft ? !getConstant(module, b, bound) : !isCounter(b) || !getConstant(module, a, bound)) return 0;
+	const SpirvInstruction* phi = module.GetDefinition(counterLeft ? a : b);
+
+	// start: a constant from outside the loop, step: phi + c, c + phi or phi - c from inside
+	auto inLoop = [&](uint32_t label)
+	{
+		for (size_t i = loop.first; i < loop.last; i++) if (function.blocks[i].labelId == label) return true;
+		return false;
+	};
+	int64_t start = 0, step = 0;
+	bool hasStart = false;
+	for (size_t o = 3; o + 1 < phi->words.size(); o += 2)
+	{
+		uint32_t value = phi->words[o], parent = phi->words[o + 1];
+		if (!inLoop(parent))
+		{
+			if (hasStart || !getConstant(module, value, start)) return 0;
+			hasStart = true;
+			continue;
+		}
+
+		const SpirvInstruction* next = module.GetDefinition(value);
+		if (next == nullptr || next->words.size() < 5) return 0;
+		int64_t c = 0;
+		if (next->opcode == spv::OpIAdd && next->words[3] == phi->resultId && getConstant(module, next->words[4], c)) {}
+		else if (next->opcode == spv::OpIAdd && next->words[4] == phi->resultId && getConstant(module, next->words[3], c)) {}
+		else if (next->opcode == spv::OpISub && next->words[3] == phi->resultId && getConstant(module, next->words[4], c)) c = -c;
+		else return 0;
+		if (step != 0 && step != c) return 0;
+		step = c;
+	}
+	if (!hasStart || step == 0) return 0;
+
+	unsigned int trips = 0;
+	for (int64_t i = start;; i = (int32_t)(uint32_t)(i + step))
+	{
+		bool result;
+		if (!compareCounter(compare->opcode, counterLeft ? i : bound, counterLeft ? bound : i, result)) return 0;
+		if (result == exitOnTrue) break;
+		if (++trips > limit) return 0;
+	}
+	return trips;
+}
+
+unsigned int Spirver::detail::ChooseUnrollFactor(unsigned int tripCount, unsigned int bodyInstructions, const UnrollLimits& limits)
+{
+	if (tripCount < 2 || bodyInstructions == 0 || bodyInstructions > limits.maxBodyInstructions) return 1;
+
+	unsigned int dividing = 1, remainder = 1;
+	for (unsigned int f = 2; f <= limits.maxFactor && f <= tripCount; f++)
+	{
+		// a remainder loop keeps one more copy of the body
+		bool divides = tripCount % f == 0;
+		if (bodyInstructions * (divides ? f : f + 1) > limits.maxUnrolledInstructions) continue;
+		if (divides) dividing = f;
+		else remainder = f;
+	}
+	return dividing > 1 ? dividing : remainder;
+}
+
+#pragma endregion
+
+#pragma region Unrolling
+
+// set the unroll bits of every loop, loops missing from hints get none
+static void setUnrollHints(SpirvModule& module, const std::map<uint32_t, uint32_t>& hints)
+{
+	const uint32_t mask = spv::LoopControlUnrollMask | spv::LoopControlDontUnrollMask;
+	for (const SpirvFunction& function : module.functions)
+	{
+		for (const SpirvBlock& block : function.blocks)
+		{
+			if (block.end - block.begin < 2) continue;
+			SpirvInstruction& merge = module.instructions[block.end - 2];
+			if (merge.opcode != spv::OpLoopMerge) continue;
+
+			auto it = hints.find(block.labelId);
+			uint32_t& control = merge.words[merge.operands[2].offset];
+			control = (control & ~mask) | (it != hints.end() ? it->second & mask : 0);
+		}
+	}
+}
+
+bool Spirver::proc::unrollSpirv(std::vector<GLuint>& spirv, const UnrollPolicy& policy, UnrollReport* report)
+{
+	size_t bytesBefore = spirv.size() * sizeof(GLuint);
+	SpirvModule module;
+	if (!module.Parse((const uint32_t*)spirv.data(), spirv.size()))
+	{
+		errors << "SPIR-V parse error!" << std::endl;
+		return false;
+	}
+
+	std::vector<LoopUnroll> loops;
+	std::map<uint32_t, uint32_t> sourceHints; // header -> unroll bits written in the source
+	std::map<uint32_t, unsigned int> factors; // header -> chosen factor
+	std::vector<SpirvLoop> found = FindLoops(module);
+	for (size_t i = 0; i < found.size(); i++)
+	{
+		auto limits = policy.loops.find((unsigned int)i);
+		LoopUnroll l;
+		l.index = (unsigned int)i;
+		l.header = found[i].header;
+		l.tripCount = GetTripCount(module, found[i]);
+		l.bodyInstructions = GetLoopInstructions(module, found[i]);
+		if (!(found[i].control & spv::LoopControlDontUnrollMask))
+			l.factor = ChooseUnrollFactor(l.tripCount, l.bodyInstructions, limits != policy.loops.end() ? limits->second : policy.limits);
+
+		sourceHints[l.header] = found[i].control;
+		if (l.factor > 1) factors[l.header] = l.factor;
+		loops.push_back(l);
+	}
+
+	// the unroll pass uses one factor for all loops with the unroll hint, so every factor gets
+	// its own run with the hint on its loops only, remainder loops copying the hint lose it on the next run
+	std::set<unsigned int> runs;
+	for (const auto& f : factors) runs.insert(f.second);
+	for (unsigned int factor : runs)
+	{
+		std::map<uint32_t, uint32_t> hints;
+		for (const auto& h : sourceHints) hints[h.first] = h.second & spv::LoopControlDontUnrollMask;
+		for (const auto& f : factors) if (f.second == factor) hints[f.first] = spv::LoopControlUnrollMask;
+		setUnrollHints(module, hints);
+
+		std::vector<uint32_t> words = module.Serialize();
+		spirv.assign(words.begin(), words.end());
+		InitSpirvUnrollOpt(factor);
+		if (!spirvUnrollOpt->Run(spirv.data(), spirv.size(), &spirv)) return false;
+		if (!module.Parse((const uint32_t*)spirv.data(), spirv.size()))
+		{
+			errors << "SPIR-V parse error!" << std::endl;
+			return false;
+		}
+	}
+
+	// hand the hints of the source on to the driver
+	if (!runs.empty())
+	{
+		setUnrollHints(module, sourceHints);
+		std::vector<uint32_t> words = module.Serialize();
+		spirv.assign(words.begin(), words.end());
+	}
+
+	if (report != nullptr)
+	{
+		report->loops = std::move(loops);
+		report->bytesBefore = bytesBefore;
+		report->bytesAfter = spirv.size() * sizeof(GLuint);
+	}
+	return true;
+}
+
+#pragma endregion
@@ -0,0 +1,35 @@
+#pragma once
+#include <Spirver.h>
+#include <SpirverModule.h>
+
+std::ostream& operator<<(std::ostream& os, const Spirver::UnrollReport& r);
+
+namespace Spirver::proc {
+
+/// Unroll loops with constant trip counts by the factors the policy allows, run after optimizeSpirv()
+bool unrollSpirv(std::vector<GLuint>& spirv, const UnrollPolicy& policy = UnrollPolicy(), UnrollReport* report = nullptr);
+
+}
+
+namespace Spirver::detail
+{
+
+/// A structured loop, its blocks are laid out from the header up to the merge block
+struct SpirvLoop
+{
+	uint32_t header = 0, merge = 0, continueTarget = 0; // label ids
+	uint32_t control = 0; // spv::LoopControlMask
+	size_t function = 0; // index in SpirvModule::functions
+	size_t first = 0, last = 0; // block indices, last is exclusive
+};
+
+/// Loops of every function in module order
+std::vector<SpirvLoop> FindLoops(const SpirvModule& module);
+/// Instructions in the blocks of the loop
+unsigned int GetLoopInstructions(const SpirvModule& module, const SpirvLoop& loop);
+/// Iterations of a loop over an integer counter with constant start, step and bound, 0 if unknown or above limit
+unsigned int GetTripCount(const SpirvModule& module, const SpirvLoop& loop, unsigned int limit = 4096);
+/// Largest factor within the limits, factors dividing the trip count need no remainder loop and win
+unsigned int ChooseUnrollFactor(unsigned int tripCount, unsigned int bodyInstructions, const UnrollLimits& limits);
+
+}
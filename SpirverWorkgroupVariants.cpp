@@ -0,0 +1,161 @@
+#include <SpirverWorkgroupVariants.h>
+#include <algorithm>
+#include <cstdio>
+
+using namespace Spirver;
+using namespace Spirver::detail;
+using namespace Spirver::proc;
+
+bool Spirver::proc::setWorkgroupSize(const std::string& source, std::string& output, const WorkgroupSize& size)
+{
+	std::string layout = "layout(local_size_x = " + std::to_string(size.x) + ", local_size_y = " + std::to_string(size.y)
+		+ ", local_size_z = " + std::to_string(size.z) + ") in;";
+
+	std::istringstream s(source);
+	output = std::string();
+	output.reserve(source.size() + layout.size());
+	bool replaced = false;
+	for (std::string line; std::getline(s, line); )
+	{
+		if (std::regex_match(line, regLocalSize))
+		{
+			if (!replaced) output += layout + "\n";
+			replaced = true;
+			continue;
+		}
+		output += line + "\n";
+	}
+	if (replaced) return true;
+
+	// no local_size yet, add it after #version
+	s = std::istringstream(output);
+	std::string withLayout;
+	withLayout.reserve(output.size() + layout.size());
+	for (std::string line; std::getline(s, line); )
+	{
+		withLayout += line + "\n";
+		if (!replaced && std::regex_match(line, regVersion))
+		{
+			withLayout += layout + "\n";
+			replaced = true;
+		}
+	}
+	output = withLayout;
+	return replaced;
+}
+
+std::vector<WorkgroupVariant> Spirver::proc::GenerateWorkgroupVariants(GlslShader& shader, const std::vector<WorkgroupSize>& sizes,
+	const HardwareProfile& hw, const CostModel& model)
+{
+	std::vector<WorkgroupVariant> variants;
+	if (hw.warpSize == 0)
+	{
+		errors << "Workgroup variant error: hardware profile has a warp size of 0" << std::endl;
+		return variants;
+	}
+	if (shader.GetStage() != Stage::Compute)
+	{
+		errors << "Workgroup variant error: not a compute shader" << std::endl;
+		return variants;
+	}
+
+	for (const WorkgroupSize& size : sizes)
+	{
+		WorkgroupVariant v;
+		v.size = size;
+
+		std::string specialized;
+		if (!setWorkgroupSize(shader.GetCode(), specialized, size))
+		{
+			errors << "Workgroup variant error: no #version in compute shader" << std::endl;
+			variants.push_back(std::move(v));
+			continue;
+		}
+
+		// constant gl_WorkGroupSize lets the optimizer fold and unroll loops over it
+		v.shader = shader.WithCode(specialized).ToSpirv();
+		v.valid = !v.shader.HasErrors() && v.shader.Optimize();
+		if (v.valid)
+		{
+			v.cyclesPerInvocation = v.shader.EstimateCost(model).estimatedCycles;
+			v.registers = v.shader.AnalyzeRegisterPressure().peakComponents;
+
+			ComputeStat stat = v.shader.AnalyzeCompute(hw);
+			unsigned int invocations = stat.GetWorkgroupSize();
+			unsigned int warpSlots = (invocations + hw.warpSize - 1) / hw.warpSize * hw.warpSize;
+			v.occupancy = stat.EstimateOccupancy(hw, v.registers);
+			v.warpEfficiency = warpSlots > 0 ? (float)invocations / warpSlots : 0.0f;
+			v.valid = v.occupancy > 0.0f && v.warpEfficiency > 0.0f;
+			if (v.valid) v.score = v.cyclesPerInvocation / (v.occupancy * v.warpEfficiency);
+		}
+		variants.push_back(std::move(v));
+	}
+
+	// best first, failed variants last
+	std::stable_sort(variants.begin(), variants.end(), [](const WorkgroupVariant& a, const WorkgroupVariant& b)
+		{
+			if (a.valid != b.valid) return a.valid;
+			return a.score < b.score;
+		});
+	return variants;
+}
+
+std::vector<WorkgroupVariant> Spirver::proc::GenerateWorkgroupVariants(const std::string& glsl, const std::vector<WorkgroupSize>& sizes,
+	const HardwareProfile& hw, const CostModel& model)
+{
+	GlslShader shader = GlslShader::FromMemory(glsl, Stage::Compute);
+	return GenerateWorkgroupVariants(shader, sizes, hw, model);
+}
+
+std::vector<WorkgroupVariant> Spirver::proc::GenerateWorkgroupVariants(SpirvShader& shader, const std::vector<WorkgroupSize>& sizes,
+	const HardwareProfile& hw, const CostModel& model)
+{
+	GlslShader glsl = shader.ToGlsl();
+	return GenerateWorkgroupVariants(glsl, sizes, hw, model);
+}
+
+// quoted JSON string, control characters become \u escapes
+static std::string jsonString(const std::string& s)
+{
+	std::string quoted = "\"";
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\') quoted += '\\';
+		if ((unsigned char)c < 0x20)
+		{
+			char escape[7];
+			std::snprintf(escape, sizeof(escape), "\\u%04x", (unsigned)c);
+			quoted += escape;
+			continue;
+		}
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+bool Spirver::proc::WriteWorkgroupManifest(std::vector<WorkgroupVariant>& variants, const std::string& directory, const std::string& baseName)
+{
+	std::string manifest = "{\n\t\"shader\": " + jsonString(baseName) + ",\n\t\"variants\": [";
+	bool success = true, first = true;
+	for (WorkgroupVariant& v : variants)
+	{
+		if (!v.valid) continue;
+
+		std::string sizeStr = std::to_string(v.size.x) + "x" + std::to_string(v.size.y) + "x" + std::to_string(v.size.z);
+		std::string file = baseName + "_" + sizeStr + ".spv";
+		success &= v.shader.ToFile(directory + "/" + file);
+
+		manifest += first ? "\n" : ",\n";
+		first = false;
+		manifest += "\t\t{ \"file\": " + jsonString(file) + ", \"localSize\": [" + std::to_string(v.size.x) + ", "
+			+ std::to_string(v.size.y) + ", " + std::to_string(v.size.z) + "]"
+			+ ", \"cyclesPerInvocation\": " + std::to_string(v.cyclesPerInvocation)
+			+ ", \"registers\": " + std::to_string(v.registers)
+			+ ", \"occupancy\": " + std::to_string(v.occupancy)
+			+ ", \"warpEfficiency\": " + std::to_string(v.warpEfficiency)
+			+ ", \"score\": " + std::to_string(v.score) + " }";
+	}
+	manifest += "\n\t]\n}\n";
+
+	return stringToFile(manifest, directory + "/" + baseName + ".manifest.json") && success;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <Spirver.h>
+
+namespace Spirver {
+
+/// local_size_x, local_size_y and local_size_z of a compute shader
+struct WorkgroupSize
+{
+	unsigned int x = 1, y = 1, z = 1;
+};
+
+/// A compute shader specialized and optimized for one workgroup size
+struct WorkgroupVariant
+{
+	WorkgroupSize size;
+	SpirvShader shader;
+	bool valid = false; // false if the variant failed to compile
+	double cyclesPerInvocation = 0.0;
+	unsigned int registers = 0; // peak live scalar components
+	float occupancy = 0.0f;
+	float warpEfficiency = 0.0f; // invocations over warp slots, less than 1 for partial warps
+	double score = 0.0; // estimated time for a fixed amount of work, lower is better
+};
+
+}
+
+namespace Spirver::proc {
+
+/// Specialize, optimize and rank a compute shader for every candidate workgroup size, best first.
+/// The variants keep the path and include directories of the shader. Empty if hw has no warp size.
+std::vector<WorkgroupVariant> GenerateWorkgroupVariants(GlslShader& shader, const std::vector<WorkgroupSize>& sizes,
+	const HardwareProfile& hw = HardwareProfile(), const CostModel& model = CostModel());
+std::vector<WorkgroupVariant> GenerateWorkgroupVariants(const std::string& glsl, const std::vector<WorkgroupSize>& sizes,
+	const HardwareProfile& hw = HardwareProfile(), const CostModel& model = CostModel());
+std::vector<WorkgroupVariant> GenerateWorkgroupVariants(SpirvShader& shader, const std::vector<WorkgroupSize>& sizes,
+	const HardwareProfile& hw = HardwareProfile(), const CostModel& model = CostModel());
+
+/// Replace or add the local_size layout of a compute shader
+bool setWorkgroupSize(const std::string& source, std::string& output, const WorkgroupSize& size);
+
+/// Write <baseName>_XxYxZ.spv for every valid variant and <baseName>.manifest.json listing them in rank order
+bool WriteWorkgroupManifest(std::vector<WorkgroupVariant>& variants, const std::string& directory, const std::string& baseName);
+
+}
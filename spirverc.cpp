@@ -0,0 +1,266 @@
+#include <Spirver.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+// spirverc [options] inputs...
+// Compiles .vert, .frag, .geom and .comp shaders to SPIR-V in parallel.
+// Inputs are files, directories searched recursively, or @response files with one argument per line.
+
+namespace fs = std::filesystem;
+
+struct Options
+{
+	fs::path outputDir = ".";
+	bool optimize = false;
+	bool optimizeSize = false;
+	bool optimizeBest = false;
+	bool analyze = false;
+	bool depfiles = false;
+	std::vector<std::string> includeDirectories;
+	unsigned int jobs = 0; // 0 uses every hardware thread
+};
+
+struct Job
+{
+	fs::path input;
+	fs::path output; // relative to outputDir
+	Spirver::Stage stage;
+};
+
+static const char* usage =
+	"usage: spirverc [options] inputs...\n"
+	"  -o <dir>    output directory, default is the current one\n"
+	"  -I <dir>    search for #include files in the directory\n"
+	"  -O          optimize with SPIRV-Tools\n"
+	"  -Os         optimize, then strip and compact for size\n"
+	"  -Obest      optimize with glsl-optimizer and SPIRV-Tools, keep the cheaper and print the winner\n"
+	"  --analyze   write <output>.stat.txt next to every binary\n"
+	"  -MD         write a Make/Ninja depfile <output>.d next to every binary\n"
+	"  -j <n>      number of parallel jobs, at least 1\n"
+	"  @<file>     read further arguments from a file, one per line\n";
+
+static bool isShader(const fs::path& path)
+{
+	std::string ext = path.extension().string();
+	return ext == ".vert" || ext == ".frag" || ext == ".geom" || ext == ".comp";
+}
+
+static bool parseCount(const std::string& arg, unsigned int& count)
+{
+	char* end = nullptr;
+	unsigned long value = std::strtoul(arg.c_str(), &end, 10);
+	if (arg.empty() || arg[0] == '-' || *end != '\0' || value == 0 || value > 4096) return false;
+	count = (unsigned int)value;
+	return true;
+}
+
+static bool expandResponseFiles(const std::vector<std::string>& args, std::vector<std::string>& expanded, int depth = 0)
+{
+	for (const std::string& arg : args)
+	{
+		if (arg.empty() || arg[0] != '@')
+		{
+			expanded.push_back(arg);
+			continue;
+		}
+
+		std::ifstream file(arg.substr(1));
+		if (!file.is_open() || depth > 8)
+		{
+			std::cerr << "spirverc: cannot read response file " << arg.substr(1) << std::endl;
+			return false;
+		}
+		std::vector<std::string> lines;
+		for (std::string line; std::getline(file, line); )
+		{
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (!line.empty()) lines.push_back(line);
+		}
+		if (!expandResponseFiles(lines, expanded, depth + 1)) return false;
+	}
+	return true;
+}
+
+static bool collectInput(const fs::path& input, std::vector<Job>& jobs)
+{
+	std::error_code ec;
+	if (fs::is_directory(input, ec))
+	{
+		// keep the directory structure below the input directory
+		for (const fs::directory_entry& entry : fs::recursive_directory_iterator(input, ec))
+			if (entry.is_regular_file() && isShader(entry.path()))
+				jobs.push_back({ entry.path(), entry.path().lexically_relative(input), Spirver::Stage::Vertex });
+	}
+	else if (fs::is_regular_file(input, ec) && isShader(input)) jobs.push_back({ input, input.filename(), Spirver::Stage::Vertex });
+	else
+	{
+		std::cerr << "spirverc: " << input.string() << " is not a shader or a directory" << std::endl;
+		return false;
+	}
+	return !ec;
+}
+
+// make and ninja both read this format, spaces in paths are escaped
+static std::string depfileEscape(const std::string& path)
+{
+	std::string escaped;
+	for (char c : path)
+	{
+		if (c == ' ' || c == '#') escaped += '\\';
+		if (c == '$') escaped += '$';
+		escaped += c;
+	}
+	return escaped;
+}
+
+static bool writeDepfile(const fs::path& depfile, const fs::path& target, const std::vector<fs::path>& dependencies)
+{
+	std::string content = depfileEscape(target.generic_string()) + ":";
+	for (const fs::path& dependency : dependencies) content += " \\\n  " + depfileEscape(dependency.generic_string());
+	content += "\n";
+	return Spirver::proc::stringToFile(content, depfile.string());
+}
+
+static bool compile(const Job& job, const Options& options, std::string& log)
+{
+	fs::path output = options.outputDir / job.output;
+	output += ".spv";
+	std::error_code ec;
+	fs::create_directories(output.parent_path(), ec);
+
+	// messages of this job only, nothing is printed from the worker threads
+	std::shared_ptr<Spirver::DiagnosticList> diagnostics = std::make_shared<Spirver::DiagnosticList>();
+	Spirver::DiagnosticScope scope(diagnostics, job.stage);
+
+	Spirver::GlslShader glsl = Spirver::GlslShader::FromFile(job.input.string(), job.stage);
+	glsl.SetIncludeDirectories(options.includeDirectories);
+	Spirver::BestOfReport report;
+	Spirver::SpirvShader spirv = options.optimizeBest ? glsl.ToSpirvBestOf(&report) : glsl.ToSpirv();
+	bool success = !spirv.HasErrors();
+	if (success && !options.optimizeBest && (options.optimize || options.optimizeSize)) success = spirv.Optimize();
+	if (success && options.optimizeSize) success = spirv.OptimizeSize();
+	if (success) success = spirv.ToFile(output.string());
+
+	if (success && options.analyze)
+	{
+		std::stringstream stat;
+		Spirver::ShaderStat s = glsl.Analyze();
+		stat << s;
+		fs::path statPath = output;
+		statPath += ".stat.txt";
+		success = Spirver::proc::stringToFile(stat.str(), statPath.string());
+	}
+
+	if (success && options.depfiles)
+	{
+		fs::path depfile = output;
+		depfile += ".d";
+		std::vector<fs::path> dependencies = { job.input };
+		for (const std::string& include : glsl.GetIncludes()) dependencies.push_back(include);
+		success = writeDepfile(depfile, output, dependencies);
+	}
+
+	if (!success)
+	{
+		// the first source string is the input file
+		std::stringstream messages;
+		for (Spirver::Diagnostic d : diagnostics->diagnostics)
+		{
+			if (d.file == "0") d.file = job.input.string();
+			messages << d << std::endl;
+		}
+		log = job.input.string() + ":\n" + messages.str() + glsl.GetErrors() + spirv.GetErrors();
+	}
+	else if (options.optimizeBest)
+	{
+		std::stringstream summary;
+		summary << job.input.string() << ":\n" << report;
+		log = summary.str();
+	}
+	return success;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> args;
+	if (!expandResponseFiles(std::vector<std::string>(argv + 1, argv + argc), args)) return 1;
+
+	Options options;
+	std::vector<Job> jobs;
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& arg = args[i];
+		if (arg == "-o" && i + 1 < args.size()) options.outputDir = args[++i];
+		else if (arg == "-I" && i + 1 < args.size()) options.includeDirectories.push_back(args[++i]);
+		else if (arg.size() > 2 && arg.compare(0, 2, "-I") == 0) options.includeDirectories.push_back(arg.substr(2));
+		else if (arg == "-O") options.optimize = true;
+		else if (arg == "-Os") options.optimizeSize = true;
+		else if (arg == "-Obest") options.optimizeBest = true;
+		else if (arg == "--analyze") options.analyze = true;
+		else if (arg == "-MD") options.depfiles = true;
+		else if (arg == "-j" && i + 1 < args.size() && parseCount(args[i + 1], options.jobs)) i++;
+		else if (arg.size() > 1 && arg[0] == '-')
+		{
+			std::cerr << usage;
+			return 1;
+		}
+		else if (!collectInput(arg, jobs)) return 1;
+	}
+	if (jobs.empty())
+	{
+		std::cerr << usage;
+		return 1;
+	}
+	for (Job& job : jobs) job.stage = Spirver::StageToSpirver(job.input.extension().string());
+
+	// files given one by one land in the output directory by name, so a.vert and b/a.vert collide,
+	// while the same file named twice is compiled once
+	std::map<fs::path, Job> outputs;
+	for (const Job& job : jobs)
+	{
+		auto inserted = outputs.emplace(job.output.lexically_normal(), job);
+		std::error_code ec;
+		if (inserted.second || fs::equivalent(inserted.first->second.input, job.input, ec)) continue;
+		std::cerr << "spirverc: " << inserted.first->second.input.string() << " and " << job.input.string() << " both write "
+			<< (options.outputDir / job.output).string() << ".spv" << std::endl;
+		return 1;
+	}
+	jobs.clear();
+	for (auto& o : outputs) jobs.push_back(std::move(o.second));
+
+	unsigned int threadCount = options.jobs != 0 ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, (unsigned int)jobs.size());
+
+	Spirver::Init();
+
+	std::atomic<size_t> next{ 0 };
+	std::atomic<size_t> failed{ 0 };
+	std::mutex logMutex;
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < jobs.size(); i = next++)
+		{
+			std::string log;
+			bool success = compile(jobs[i], options, log);
+			if (!success) failed++;
+			if (log.empty()) continue;
+			std::lock_guard<std::mutex> lock(logMutex);
+			(success ? std::cout : std::cerr) << log << std::endl;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < threadCount; i++) threads.emplace_back(worker);
+	worker();
+	for (std::thread& t : threads) t.join();
+
+	Spirver::Clean();
+
+	if (failed > 0) std::cerr << "spirverc: " << failed << " of " << jobs.size() << " shaders failed" << std::endl;
+	return failed > 0 ? 1 : 0;
+}
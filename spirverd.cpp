@@ -0,0 +1,46 @@
+#include <SpirverDaemon.h>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+
+// spirverd [--socket path] [--cache-mb size] [--threads count]
+// Keeps Spirver initialized and answers compile, optimize and analyze requests of DaemonClient.
+
+static Spirver::ShaderDaemon* daemonInstance = nullptr;
+
+static void onSignal(int)
+{
+	if (daemonInstance != nullptr) daemonInstance->Stop();
+}
+
+int main(int argc, char** argv)
+{
+	std::string socketPath = Spirver::DefaultDaemonSocket();
+	size_t cacheMb = 256;
+	unsigned int threads = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--socket" && i + 1 < argc) socketPath = argv[++i];
+		else if (arg == "--cache-mb" && i + 1 < argc) cacheMb = (size_t)std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--threads" && i + 1 < argc) threads = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+		else
+		{
+			std::cerr << "usage: spirverd [--socket path] [--cache-mb size] [--threads count]" << std::endl;
+			return 1;
+		}
+	}
+
+	Spirver::ShaderDaemon daemon(cacheMb << 20, threads);
+	daemonInstance = &daemon;
+	std::signal(SIGINT, onSignal);
+	std::signal(SIGTERM, onSignal);
+
+	bool success = daemon.Run(socketPath);
+	std::cerr << daemon.GetErrors();
+	std::cerr << "spirverd: " << daemon.GetCacheHits() << " cache hits, " << daemon.GetCacheMisses() << " misses" << std::endl;
+
+	daemonInstance = nullptr;
+	Spirver::Clean();
+	return success ? 0 : 1;
+}